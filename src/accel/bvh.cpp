@@ -0,0 +1,318 @@
+#include <accel/bvh.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <future>
+#include <optional>
+#include <thread>
+
+namespace rt::accel {
+
+namespace {
+
+constexpr std::uint32_t kMaxLeafSize = 4;
+constexpr std::size_t kBinCount = 16;
+// Past this depth nodes are split at the median, which bounds the rest of the tree by log2 of the primitive count
+// and keeps it within the traversal stack.
+constexpr std::size_t kMaxSahDepth = 64;
+// Relative costs of visiting a node and intersecting a primitive.
+constexpr double kTraversalCost = 1;
+constexpr double kIntersectionCost = 1;
+
+struct Bin {
+  geom::Bounds bounds;
+  geom::Bounds centroid_bounds;
+  std::uint32_t count = 0;
+
+  void Extend(const Bin& other) noexcept {
+    bounds.Extend(other.bounds);
+    centroid_bounds.Extend(other.centroid_bounds);
+    count += other.count;
+  }
+};
+
+using Bins = std::array<Bin, kBinCount>;
+
+// Bounds of a range of primitives and of their centroids.
+struct RangeInfo {
+  geom::Bounds bounds;
+  geom::Bounds centroid_bounds;
+};
+
+struct BuildContext {
+  const std::vector<geom::Bounds>& bounds;
+  std::vector<geom::Vector> centroids;
+  std::vector<std::uint32_t>& indices;
+  std::size_t threads;
+  std::size_t parallel_threshold;
+  std::size_t task_depth;  // subtrees above this depth are built as separate tasks
+};
+
+// Maps centroids to bins along the widest axis of the centroid bounds, which must not be flat.
+class Binning {
+ public:
+  explicit Binning(const RangeInfo& info) noexcept
+    : axis_(info.centroid_bounds.LongestAxis()),
+      min_(info.centroid_bounds.Min()[axis_]),
+      scale_(kBinCount / (info.centroid_bounds.Max()[axis_] - min_)) {
+  }
+
+  [[nodiscard]] std::size_t operator()(const geom::Vector& centroid) const noexcept {
+    auto bin = static_cast<std::size_t>((centroid[axis_] - min_) * scale_);
+    return bin < kBinCount ? bin : kBinCount - 1;
+  }
+
+ private:
+  std::size_t axis_;
+  double min_;
+  double scale_;
+};
+
+void FillBins(const BuildContext& context, const Binning& binning, std::uint32_t begin, std::uint32_t end,
+              Bins& bins) noexcept {
+  for (std::uint32_t i = begin; i < end; ++i) {
+    std::uint32_t primitive = context.indices[i];
+    const geom::Vector& centroid = context.centroids[primitive];
+    Bin& bin = bins[binning(centroid)];
+    bin.bounds.Extend(context.bounds[primitive]);
+    bin.centroid_bounds.Extend(centroid);
+    ++bin.count;
+  }
+}
+
+// Large ranges are binned by several threads, each into its own bins; the merge only takes minima, maxima and sums
+// of counts, so the result does not depend on the split.
+[[nodiscard]] Bins BinRange(const BuildContext& context, const Binning& binning, std::uint32_t begin,
+                            std::uint32_t end) {
+  Bins bins{};
+  std::size_t parts = std::min<std::size_t>(context.threads, (end - begin) / context.parallel_threshold);
+  if (parts <= 1) {
+    FillBins(context, binning, begin, end, bins);
+    return bins;
+  }
+  std::vector<Bins> partial(parts, Bins{});
+  std::vector<std::future<void>> tasks;
+  std::uint32_t part_size = (end - begin + parts - 1) / parts;
+  for (std::size_t part = 1; part < parts; ++part) {
+    std::uint32_t part_begin = begin + part * part_size;
+    std::uint32_t part_end = std::min(end, part_begin + part_size);
+    tasks.push_back(std::async(std::launch::async, [&, part, part_begin, part_end] {
+      FillBins(context, binning, part_begin, part_end, partial[part]);
+    }));
+  }
+  FillBins(context, binning, begin, std::min(end, begin + part_size), partial[0]);
+  for (auto& task : tasks) {
+    task.get();
+  }
+  for (const auto& part : partial) {
+    for (std::size_t bin = 0; bin < kBinCount; ++bin) {
+      bins[bin].Extend(part[bin]);
+    }
+  }
+  return bins;
+}
+
+struct Split {
+  std::size_t bin;  // first bin of the right side
+  double cost;
+  RangeInfo left;
+  RangeInfo right;
+};
+
+[[nodiscard]] std::optional<Split> FindSahSplit(const Bins& bins, const RangeInfo& info) noexcept {
+  // Sweep from the right to know the cost of every right side, then from the left.
+  std::array<Bin, kBinCount> right;
+  Bin accumulated;
+  for (std::size_t bin = kBinCount - 1; bin > 0; --bin) {
+    accumulated.Extend(bins[bin]);
+    right[bin] = accumulated;
+  }
+  std::optional<Split> best;
+  double inv_area = 1 / info.bounds.SurfaceArea();
+  Bin left;
+  for (std::size_t bin = 1; bin < kBinCount; ++bin) {
+    left.Extend(bins[bin - 1]);
+    if (left.count == 0 || right[bin].count == 0) {
+      continue;
+    }
+    double cost = kTraversalCost + kIntersectionCost * inv_area *
+                                     (left.bounds.SurfaceArea() * left.count +
+                                      right[bin].bounds.SurfaceArea() * right[bin].count);
+    if (!best || cost < best->cost) {
+      best = Split{bin, cost, {left.bounds, left.centroid_bounds}, {right[bin].bounds, right[bin].centroid_bounds}};
+    }
+  }
+  return best;
+}
+
+[[nodiscard]] RangeInfo GetRangeInfo(const BuildContext& context, std::uint32_t begin, std::uint32_t end) noexcept {
+  RangeInfo info;
+  for (std::uint32_t i = begin; i < end; ++i) {
+    info.bounds.Extend(context.bounds[context.indices[i]]);
+    info.centroid_bounds.Extend(context.centroids[context.indices[i]]);
+  }
+  return info;
+}
+
+// Builds the subtree of the node at node_index, whose bounds are already set, appending its descendants to nodes.
+void BuildNode(BuildContext& context, std::vector<BvhNode>& nodes, std::uint32_t node_index, std::uint32_t begin,
+               std::uint32_t end, const RangeInfo& info, std::size_t depth) {
+  auto make_leaf = [&] {
+    nodes[node_index].first = begin;
+    nodes[node_index].count = end - begin;
+  };
+  std::size_t axis = info.centroid_bounds.LongestAxis();
+  if (end - begin == 1 || info.centroid_bounds.Max()[axis] <= info.centroid_bounds.Min()[axis]) {
+    make_leaf();
+    return;
+  }
+
+  std::uint32_t middle;
+  RangeInfo left_info;
+  RangeInfo right_info;
+  std::optional<Split> split;
+  Binning binning(info);
+  if (depth < kMaxSahDepth) {
+    split = FindSahSplit(BinRange(context, binning, begin, end), info);
+  }
+  if (split) {
+    if (end - begin <= kMaxLeafSize && split->cost >= kIntersectionCost * (end - begin)) {
+      make_leaf();
+      return;
+    }
+    auto it = std::partition(context.indices.begin() + begin, context.indices.begin() + end,
+                             [&](std::uint32_t primitive) {
+                               return binning(context.centroids[primitive]) < split->bin;
+                             });
+    middle = static_cast<std::uint32_t>(it - context.indices.begin());
+    left_info = split->left;
+    right_info = split->right;
+  } else {
+    if (end - begin <= kMaxLeafSize) {
+      make_leaf();
+      return;
+    }
+    middle = begin + (end - begin) / 2;
+    std::nth_element(context.indices.begin() + begin, context.indices.begin() + middle,
+                     context.indices.begin() + end, [&](std::uint32_t lhs, std::uint32_t rhs) {
+                       return context.centroids[lhs][axis] < context.centroids[rhs][axis];
+                     });
+    left_info = GetRangeInfo(context, begin, middle);
+    right_info = GetRangeInfo(context, middle, end);
+  }
+
+  auto left = static_cast<std::uint32_t>(nodes.size());
+  nodes.resize(nodes.size() + 2);
+  nodes[node_index].first = left;
+  nodes[node_index].count = 0;
+  nodes[left].bounds = left_info.bounds;
+  nodes[left + 1].bounds = right_info.bounds;
+
+  if (depth >= context.task_depth || end - middle < context.parallel_threshold) {
+    BuildNode(context, nodes, left, begin, middle, left_info, depth + 1);
+    BuildNode(context, nodes, left + 1, middle, end, right_info, depth + 1);
+    return;
+  }
+  // The right subtree is built by another thread into its own array, with its root copied to the front, and
+  // appended after the left one. Node order is the same as in a serial build.
+  auto right_task = std::async(std::launch::async, [&context, &nodes, left, middle, end, &right_info, depth] {
+    std::vector<BvhNode> subtree{nodes[left + 1]};
+    BuildNode(context, subtree, 0, middle, end, right_info, depth + 1);
+    return subtree;
+  });
+  BuildNode(context, nodes, left, begin, middle, left_info, depth + 1);
+  std::vector<BvhNode> subtree = right_task.get();
+  auto offset = static_cast<std::uint32_t>(nodes.size() - 1);
+  for (auto& node : subtree) {
+    if (node.count == 0) {
+      node.first += offset;
+    }
+  }
+  nodes[left + 1] = subtree[0];
+  nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+}
+
+[[nodiscard]] BvhStats ComputeStats(const std::vector<BvhNode>& nodes, std::size_t primitives) {
+  BvhStats stats;
+  stats.primitives = primitives;
+  stats.nodes = nodes.size();
+  double root_area = nodes[0].bounds.SurfaceArea();
+  std::vector<std::pair<std::uint32_t, std::size_t>> stack{{0, 1}};
+  while (!stack.empty()) {
+    auto [index, depth] = stack.back();
+    stack.pop_back();
+    const BvhNode& node = nodes[index];
+    double area = root_area > 0 ? node.bounds.SurfaceArea() / root_area : 1;
+    stats.max_depth = std::max(stats.max_depth, depth);
+    if (node.count > 0) {
+      ++stats.leaves;
+      stats.sah_cost += kIntersectionCost * area * node.count;
+    } else {
+      stats.sah_cost += kTraversalCost * area;
+      stack.emplace_back(node.first, depth + 1);
+      stack.emplace_back(node.first + 1, depth + 1);
+    }
+  }
+  return stats;
+}
+
+}  // namespace
+
+Bvh::Bvh(const std::vector<geom::Bounds>& primitive_bounds, const BvhBuildOptions& options) {
+  if (primitive_bounds.empty()) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  assert(primitive_bounds.size() < UINT32_MAX);
+  auto count = static_cast<std::uint32_t>(primitive_bounds.size());
+  std::vector<std::uint32_t> indices(count);
+  for (std::uint32_t i = 0; i < count; ++i) {
+    indices[i] = i;
+  }
+  std::size_t threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  // A few levels of tasks give every thread a subtree; deeper ones would only add overhead.
+  std::size_t task_depth = threads > 1 ? std::bit_width(threads) + 1 : 0;
+  BuildContext context{primitive_bounds, {}, indices, threads, std::max<std::size_t>(options.parallel_threshold, 1),
+                       task_depth};
+  context.centroids.reserve(count);
+  for (const auto& bounds : primitive_bounds) {
+    context.centroids.push_back(bounds.Centroid());
+  }
+
+  std::vector<BvhNode> nodes;
+  nodes.reserve(2 * count);
+  RangeInfo info = GetRangeInfo(context, 0, count);
+  nodes.push_back({info.bounds, 0, 0});
+  BuildNode(context, nodes, 0, 0, count, info, 1);
+  nodes.shrink_to_fit();
+
+  stats_ = ComputeStats(nodes, count);
+  stats_.threads = threads;
+  stats_.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  nodes_ = std::move(nodes);
+  indices_ = std::move(indices);
+}
+
+void Bvh::PrepareRefit() {
+  if (!parents_.empty() || nodes_.empty()) {
+    return;
+  }
+  parents_.resize(nodes_.size(), 0);
+  leaf_of_.resize(indices_.size(), 0);
+  for (std::uint32_t i = 0; i < nodes_.size(); ++i) {
+    const BvhNode& node = nodes_[i];
+    if (node.count > 0) {
+      for (std::uint32_t j = node.first; j < node.first + node.count; ++j) {
+        leaf_of_[indices_[j]] = i;
+      }
+    } else {
+      parents_[node.first] = i;
+      parents_[node.first + 1] = i;
+    }
+  }
+}
+
+}  // namespace rt::accel
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <geometry/bounds.hpp>
+#include <geometry/ray.hpp>
+#include <geometry/vector.hpp>
+#include <util/mapped_vector.hpp>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace rt::accel {
+
+struct BvhNode {
+  geom::Bounds bounds;
+  std::uint32_t first;  // left child of an inner node (the right one is first + 1), first index of a leaf
+  std::uint32_t count;  // number of primitives in a leaf, 0 for inner nodes
+};
+
+// Distance at which the ray enters the box, or infinity if it misses it before t_max. The far plane is widened by
+// a few ulps so that rounding never rejects a primitive lying exactly on a face of a flat box.
+[[nodiscard]] inline double EntryDistance(const geom::Bounds& bounds, const geom::Vector& origin,
+                                          const geom::Vector& inv_direction, double t_max) noexcept {
+  constexpr double kWiden = 1 + 6 * std::numeric_limits<double>::epsilon();
+  double t_min = 0;
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    double t_near = (bounds.Min()[axis] - origin[axis]) * inv_direction[axis];
+    double t_far = (bounds.Max()[axis] - origin[axis]) * inv_direction[axis];
+    if (t_near > t_far) {
+      std::swap(t_near, t_far);
+    }
+    t_far *= kWiden;
+    // NaN (origin on the plane of an axis the ray is parallel to) leaves the interval unchanged.
+    t_min = t_near > t_min ? t_near : t_min;
+    t_max = t_far < t_max ? t_far : t_max;
+    if (t_min > t_max) {
+      return std::numeric_limits<double>::infinity();
+    }
+  }
+  return t_min;
+}
+
+struct BvhBuildOptions {
+  // Threads used for the build, 0 for one per hardware thread. The tree does not depend on the number.
+  std::size_t threads = 0;
+  // Ranges of at least this many primitives are binned in parallel and their subtrees built as separate tasks.
+  std::size_t parallel_threshold = std::size_t{1} << 14;
+};
+
+// Build quality and time. The SAH cost is the expected cost of a ray through the root, in primitive intersections,
+// with node visits costing as much as one: sum over nodes of area(node) / area(root) times 1 for inner nodes and
+// the primitive count for leaves. Lower is better; a single leaf costs the primitive count.
+struct BvhStats {
+  std::size_t primitives = 0;
+  std::size_t nodes = 0;
+  std::size_t leaves = 0;
+  std::size_t max_depth = 0;
+  double sah_cost = 0;
+  double build_seconds = 0;
+  std::size_t threads = 0;
+};
+
+class Bvh {
+ public:
+  Bvh() = default;
+
+  // Builds the hierarchy over the given primitive bounds with binned SAH splits; leaves refer to positions in this
+  // vector.
+  explicit Bvh(const std::vector<geom::Bounds>& primitive_bounds, const BvhBuildOptions& options = {});
+
+  // Wraps a hierarchy built earlier, e.g. one stored in a mapped file.
+  Bvh(util::MappedVector<BvhNode> nodes, util::MappedVector<std::uint32_t> indices) noexcept
+    : nodes_(std::move(nodes)), indices_(std::move(indices)) {
+  }
+
+  [[nodiscard]] bool Empty() const noexcept {
+    return nodes_.empty();
+  }
+
+  [[nodiscard]] geom::Bounds GetBounds() const noexcept {
+    return Empty() ? geom::Bounds{} : nodes_[0].bounds;
+  }
+
+  [[nodiscard]] const util::MappedVector<BvhNode>& GetNodes() const noexcept {
+    return nodes_;
+  }
+
+  [[nodiscard]] const util::MappedVector<std::uint32_t>& GetIndices() const noexcept {
+    return indices_;
+  }
+
+  // Recomputes the bounds of every node bottom-up from bounds_of(primitive), keeping the tree. Much cheaper than a
+  // rebuild, but the tree gets worse as primitives move away from where it was built. Only for built hierarchies.
+  template <typename BoundsOf>
+  void Refit(BoundsOf&& bounds_of) {
+    for (std::size_t i = nodes_.size(); i-- > 0;) {
+      RefitNode(i, bounds_of);
+    }
+  }
+
+  // Same after only `primitive` has moved: updates its leaf and the leaf's ancestors.
+  template <typename BoundsOf>
+  void Refit(std::uint32_t primitive, BoundsOf&& bounds_of) {
+    PrepareRefit();
+    for (std::uint32_t node = leaf_of_[primitive];; node = parents_[node]) {
+      RefitNode(node, bounds_of);
+      if (node == 0) {
+        break;
+      }
+    }
+  }
+
+  // Calls visit(buffer) for the node and index buffers, e.g. to move them into an arena. A hierarchy whose buffers
+  // became views can no longer be refitted.
+  template <typename Visitor>
+  void ForEachBuffer(Visitor&& visit) {
+    visit(nodes_);
+    visit(indices_);
+  }
+
+  // Filled by the building constructor; wrapped hierarchies report zeros. Not updated by Refit().
+  [[nodiscard]] const BvhStats& GetStats() const noexcept {
+    return stats_;
+  }
+
+  // Calls visit(primitive) for every primitive in the leaves the ray enters before t_max, nearer subtree first.
+  // The visitor returns true to stop the traversal. t_max is re-read after each visit, so the visitor may shrink it.
+  template <typename Visitor>
+  void Traverse(const geom::Ray& ray, const double& t_max, Visitor&& visit) const {
+    if (nodes_.empty()) {
+      return;
+    }
+    const geom::Vector& origin = ray.GetOrigin();
+    geom::Vector inv_direction{1 / ray.GetDirection()[0], 1 / ray.GetDirection()[1], 1 / ray.GetDirection()[2]};
+
+    // A missed box reports infinity, which must not pass for an entry before an infinite t_max.
+    auto enters = [&t_max](double entry) {
+      return entry <= t_max && entry != std::numeric_limits<double>::infinity();
+    };
+
+    std::array<std::pair<std::uint32_t, double>, kMaxDepth> stack;
+    std::size_t size = 0;
+    double entry = EntryDistance(nodes_[0].bounds, origin, inv_direction, t_max);
+    if (enters(entry)) {
+      stack[size++] = {0, entry};
+    }
+    while (size > 0) {
+      auto [index, node_entry] = stack[--size];
+      if (!enters(node_entry)) {
+        continue;
+      }
+      const BvhNode& node = nodes_[index];
+      if (node.count > 0) {
+        for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+          if (visit(indices_[i])) {
+            return;
+          }
+        }
+        continue;
+      }
+      double left = EntryDistance(nodes_[node.first].bounds, origin, inv_direction, t_max);
+      double right = EntryDistance(nodes_[node.first + 1].bounds, origin, inv_direction, t_max);
+      // Push the farther child first so that the nearer one is popped next.
+      if (left <= right) {
+        if (enters(right)) {
+          stack[size++] = {node.first + 1, right};
+        }
+        if (enters(left)) {
+          stack[size++] = {node.first, left};
+        }
+      } else {
+        if (enters(left)) {
+          stack[size++] = {node.first, left};
+        }
+        if (enters(right)) {
+          stack[size++] = {node.first + 1, right};
+        }
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kMaxDepth = 128;
+
+  // Children always follow their parent in nodes_, so walking the array backwards visits them first.
+  template <typename BoundsOf>
+  void RefitNode(std::size_t index, BoundsOf& bounds_of) {
+    BvhNode& node = nodes_[index];
+    geom::Bounds bounds;
+    if (node.count > 0) {
+      for (std::uint32_t i = node.first; i < node.first + node.count; ++i) {
+        bounds.Extend(bounds_of(indices_[i]));
+      }
+    } else {
+      bounds.Extend(nodes_[node.first].bounds);
+      bounds.Extend(nodes_[node.first + 1].bounds);
+    }
+    node.bounds = bounds;
+  }
+
+  // Fills parents_ and leaf_of_ on first use.
+  void PrepareRefit();
+
+  util::MappedVector<BvhNode> nodes_;
+  util::MappedVector<std::uint32_t> indices_;
+  BvhStats stats_;
+  std::vector<std::uint32_t> parents_;
+  std::vector<std::uint32_t> leaf_of_;
+};
+
+}  // namespace rt::accel
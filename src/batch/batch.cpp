@@ -0,0 +1,168 @@
+#include <batch/batch.hpp>
+#include <raytracer/raytracer.hpp>
+#include <util/thread_pool.hpp>
+#include <util/trace.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace rt::batch {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]] double SecondsSince(Clock::time_point start) noexcept {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct SceneGroup {
+  std::string scene;
+  std::vector<std::size_t> jobs;
+};
+
+[[nodiscard]] std::vector<SceneGroup> GroupByScene(const std::vector<RenderJob>& jobs) {
+  std::vector<SceneGroup> groups;
+  std::unordered_map<std::string, std::size_t> group_of;
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    auto [it, inserted] = group_of.emplace(jobs[i].scene, groups.size());
+    if (inserted) {
+      groups.push_back({jobs[i].scene, {}});
+    }
+    groups[it->second].jobs.push_back(i);
+  }
+  return groups;
+}
+
+}  // namespace
+
+std::vector<RenderJob> ReadManifest(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file) {
+    throw std::runtime_error("can't open manifest " + filename);
+  }
+  std::filesystem::path base = std::filesystem::path(filename).parent_path();
+  std::vector<RenderJob> jobs;
+  std::string line;
+  for (std::size_t number = 1; std::getline(file, line); ++number) {
+    std::size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    try {
+      RenderJob job = ParseRenderJob(line);
+      job.scene = (base / job.scene).string();
+      job.output = (base / job.output).string();
+      jobs.push_back(std::move(job));
+    } catch (const std::exception& error) {
+      throw std::runtime_error(filename + ":" + std::to_string(number) + ": " + error.what());
+    }
+  }
+  return jobs;
+}
+
+BatchStats RenderBatch(const std::vector<RenderJob>& jobs, const BatchOptions& options,
+                       const std::function<void(const JobResult&)>& report) {
+  auto start = Clock::now();
+  std::vector<SceneGroup> groups = GroupByScene(jobs);
+  BatchStats stats;
+  stats.scenes = groups.size();
+  std::mutex mutex;  // guards stats and calls to report
+
+  auto finish = [&](const JobResult& result) {
+    std::lock_guard lock(mutex);
+    ++(result.error.empty() ? stats.completed : stats.failed);
+    stats.render_seconds += result.render_seconds;
+    if (report) {
+      report(result);
+    }
+  };
+  auto load = [&](std::size_t group) {
+    return std::async(std::launch::async, [&, group] {
+      auto load_start = Clock::now();
+      auto scene = std::make_shared<const Scene>(ReadScene(groups[group].scene, options.reader));
+      std::lock_guard lock(mutex);
+      stats.load_seconds += SecondsSince(load_start);
+      return scene;
+    });
+  };
+
+  std::vector<std::unique_ptr<std::latch>> done;
+  {
+    util::ThreadPool pool(options.threads);
+    std::future<std::shared_ptr<const Scene>> next;
+    if (!groups.empty()) {
+      next = load(0);
+    }
+    for (std::size_t group = 0; group < groups.size(); ++group) {
+      done.push_back(std::make_unique<std::latch>(static_cast<std::ptrdiff_t>(groups[group].jobs.size())));
+      std::latch& group_done = *done.back();
+
+      auto wait_start = Clock::now();
+      std::shared_ptr<const Scene> scene;
+      std::string load_error;
+      try {
+        scene = next.get();
+      } catch (const std::exception& error) {
+        load_error = error.what();
+      }
+      stats.load_wait_seconds += SecondsSince(wait_start);
+
+      for (std::size_t job : groups[group].jobs) {
+        if (!scene) {
+          finish({job, load_error});
+          group_done.count_down();
+          continue;
+        }
+        pool.Submit([&, job, scene] {
+          JobResult result{job, {}};
+          result.scene_memory = scene->GetMemory();
+          RT_TRACE_SPAN("job", jobs[job].output);
+          try {
+            auto render_start = Clock::now();
+            const RenderJob& render_job = jobs[job];
+            image::Image image(0, 0);
+            if (render_job.time_limit > 0) {
+              DeadlineOptions deadline;
+              deadline.deadline = render_start + std::chrono::duration_cast<Clock::duration>(
+                                                   std::chrono::duration<double>(render_job.time_limit));
+              DeadlineRender render = RenderWithDeadline(*scene, render_job.camera, render_job.render, deadline);
+              image = std::move(render.image);
+              result.quality = render.quality;
+            } else {
+              image = Render(*scene, render_job.camera, render_job.render);
+            }
+            auto write_start = Clock::now();
+            result.render_seconds = std::chrono::duration<double>(write_start - render_start).count();
+            image.Write(render_job.output);
+            result.write_seconds = SecondsSince(write_start);
+          } catch (const std::exception& error) {
+            result.error = error.what();
+          }
+          finish(result);
+          group_done.count_down();
+        });
+      }
+
+      // Read the next scene while this one renders, once the previous one is done with.
+      if (group + 1 < groups.size()) {
+        if (group > 0) {
+          done[group - 1]->wait();
+        }
+        next = load(group + 1);
+      }
+    }
+  }
+  stats.wall_seconds = SecondsSince(start);
+  return stats;
+}
+
+}  // namespace rt::batch
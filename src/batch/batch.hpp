@@ -0,0 +1,50 @@
+#pragma once
+
+#include <raytracer/deadline.hpp>
+#include <raytracer/render_job.hpp>
+#include <scene/memory.hpp>
+#include <scene/reader.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rt::batch {
+
+// One job per line in the format of ParseRenderJob. Blank lines and lines starting with # are skipped, and relative
+// scene and output paths are taken relative to the manifest. Errors name the offending line.
+[[nodiscard]] std::vector<RenderJob> ReadManifest(const std::string& filename);
+
+struct BatchOptions {
+  std::size_t threads = 0;  // render threads, 0 for one per hardware thread
+  ReaderOptions reader;
+};
+
+struct JobResult {
+  std::size_t job;     // index in the job list
+  std::string error;   // empty on success
+  double render_seconds = 0;
+  double write_seconds = 0;
+  RenderQuality quality = RenderQuality::kFull;  // below kFull only for jobs with a time limit
+  SceneMemory scene_memory{};                    // of the job's scene, zeros if it failed to load
+};
+
+struct BatchStats {
+  std::size_t completed = 0;
+  std::size_t failed = 0;
+  std::size_t scenes = 0;
+  double load_seconds = 0;       // spent reading scenes, mostly hidden behind rendering
+  double load_wait_seconds = 0;  // scheduling waited for a scene to finish loading
+  double render_seconds = 0;     // summed over jobs, so up to threads times the wall time
+  double wall_seconds = 0;
+};
+
+// Renders the jobs, loading every scene once: jobs are grouped by scene in order of first appearance, the next
+// scene is read while the current one renders, and the jobs of one group are queued behind those of the previous
+// one so that no thread idles at a group boundary. At most two scenes are held in memory plus the one being read.
+// report, if given, is called as each job finishes, never concurrently. A failed job does not stop the others.
+BatchStats RenderBatch(const std::vector<RenderJob>& jobs, const BatchOptions& options = {},
+                       const std::function<void(const JobResult&)>& report = {});
+
+}  // namespace rt::batch
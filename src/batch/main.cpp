@@ -0,0 +1,93 @@
+#include <batch/batch.hpp>
+#include <raytracer/tile.hpp>
+#include <scene/memory.hpp>
+#include <util/profile.hpp>
+#include <util/trace.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace {
+
+void PrintUsage(const char* program) {
+  std::cerr << "usage: " << program
+            << " MANIFEST [--threads N] [--profile] [--trace FILE] [--memory] [--memory-budget MIB]\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  try {
+    rt::batch::BatchOptions options;
+    bool profile = false;
+    std::string trace;
+    bool memory = false;
+    for (int i = 2; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      if (arg == "--threads" && i + 1 < argc) {
+        options.threads = std::stoul(argv[++i]);
+      } else if (arg == "--profile") {
+        profile = true;
+      } else if (arg == "--trace" && i + 1 < argc) {
+        trace = argv[++i];
+      } else if (arg == "--memory") {
+        memory = true;
+      } else if (arg == "--memory-budget" && i + 1 < argc) {
+        options.reader.memory_budget = static_cast<std::size_t>(std::stod(argv[++i]) * (1 << 20));
+      } else {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+    rt::util::EnableProfiling(profile);
+    if (!trace.empty()) {
+      if (!rt::util::kTracingBuilt) {
+        std::cerr << "--trace needs a build configured with -DRT_TRACING=ON\n";
+        return EXIT_FAILURE;
+      }
+      rt::util::StartTracing();
+    }
+    auto jobs = rt::batch::ReadManifest(argv[1]);
+    std::cout << std::fixed << std::setprecision(3);
+    std::size_t finished = 0;
+    std::unordered_set<std::string> reported_scenes;
+    auto stats = rt::batch::RenderBatch(jobs, options, [&](const rt::batch::JobResult& result) {
+      const rt::RenderJob& job = jobs[result.job];
+      std::cout << '[' << ++finished << '/' << jobs.size() << "] " << job.scene << " -> " << job.output << ": ";
+      if (result.error.empty()) {
+        std::cout << "render " << result.render_seconds << " s, write " << result.write_seconds << " s";
+        if (result.quality != rt::RenderQuality::kFull) {
+          std::cout << ", " << rt::GetQualityName(result.quality);
+        }
+        std::cout << '\n';
+        if (memory && reported_scenes.insert(job.scene).second) {
+          rt::PrintSceneMemory(result.scene_memory, rt::GetFramebufferBytes(job.camera), std::cout);
+        }
+      } else {
+        std::cout << "failed: " << result.error << '\n';
+      }
+    });
+    std::cout << stats.completed << " jobs done, " << stats.failed << " failed, " << stats.scenes
+              << " scenes loaded in " << stats.load_seconds << " s (waited " << stats.load_wait_seconds
+              << " s), wall " << stats.wall_seconds << " s\n";
+    if (profile) {
+      rt::util::PrintProfile(rt::util::GetProfile(), std::cout);
+    }
+    if (!trace.empty()) {
+      rt::util::WriteTrace(trace);
+    }
+    return stats.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
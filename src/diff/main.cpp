@@ -0,0 +1,58 @@
+#include <raytracer/image.hpp>
+#include <raytracer/image_diff.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void PrintUsage(const char* program) {
+  std::cerr << "usage: " << program << " ACTUAL EXPECTED [--tolerance T] [--max-over FRACTION] [--heatmap PNG]\n"
+            << "Fails when more than FRACTION (default 0.01) of the pixels are at least T (default 2) apart; the\n"
+            << "heatmap is written only then.\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3 || argc % 2 == 0) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  try {
+    rt::image::ImageDiffOptions options;
+    double max_over = 0.01;
+    std::string heatmap;
+    for (int i = 3; i < argc; i += 2) {
+      std::string_view flag = argv[i];
+      if (flag == "--tolerance") {
+        options.tolerance = std::stod(argv[i + 1]);
+      } else if (flag == "--max-over") {
+        max_over = std::stod(argv[i + 1]);
+      } else if (flag == "--heatmap") {
+        heatmap = argv[i + 1];
+      } else {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+    rt::image::Image actual(std::string{argv[1]});
+    rt::image::Image expected(std::string{argv[2]});
+    auto diff = rt::image::CompareImages(actual, expected, options);
+    bool passed = diff.over_tolerance <= max_over;
+    std::cout << "max error " << diff.max_error << ", PSNR " << diff.psnr << " dB, " << diff.pixels_over
+              << " pixels (" << 100 * diff.over_tolerance << "%) over tolerance: " << (passed ? "pass" : "FAIL")
+              << '\n';
+    if (!passed && !heatmap.empty()) {
+      rt::image::MakeDiffHeatmap(actual, expected, options.tolerance).Write(heatmap);
+      std::cout << "heatmap written to " << heatmap << '\n';
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,246 @@
+#include <generator/generator.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace rt::generator {
+
+namespace {
+
+constexpr double kExtent = 100;  // side of the terrain, whatever the triangle count
+constexpr std::size_t kGroundMaterials = 4;
+constexpr std::array<std::array<double, 3>, kGroundMaterials> kGroundColors = {
+  {{0.55, 0.5, 0.4}, {0.35, 0.5, 0.3}, {0.5, 0.45, 0.35}, {0.45, 0.45, 0.5}}};
+
+// Uniform in [0, 1) from the top 24 bits of the engine. std::mt19937 is specified exactly, but the distributions are
+// not, and the files must not depend on the standard library.
+[[nodiscard]] double Uniform(std::mt19937& gen) noexcept {
+  return static_cast<double>(gen() >> 8) * 0x1p-24;
+}
+
+// Buffered text output through std::to_chars, which keeps up with the disk at hundreds of millions of numbers where
+// streams don't.
+class Writer {
+ public:
+  explicit Writer(const std::string& filename) : filename_(filename), file_(filename, std::ios::binary) {
+    if (!file_) {
+      throw std::runtime_error("can't open " + filename);
+    }
+  }
+
+  Writer& Text(std::string_view text) {
+    Reserve(text.size());
+    used_ = std::copy(text.begin(), text.end(), buffer_.begin() + used_) - buffer_.begin();
+    return *this;
+  }
+
+  Writer& Number(double value) {
+    Reserve(kMaxNumber);
+    auto [end, error] = std::to_chars(&buffer_[used_], buffer_.data() + buffer_.size(), value,
+                                      std::chars_format::fixed, 6);
+    used_ = end - buffer_.data();
+    return *this;
+  }
+
+  Writer& Index(std::size_t value) {
+    Reserve(kMaxNumber);
+    auto [end, error] = std::to_chars(&buffer_[used_], buffer_.data() + buffer_.size(), value);
+    used_ = end - buffer_.data();
+    return *this;
+  }
+
+  // Numbers separated by spaces, e.g. the three of a vector.
+  Writer& Numbers(const std::array<double, 3>& values) {
+    return Number(values[0]).Text(" ").Number(values[1]).Text(" ").Number(values[2]);
+  }
+
+  void Close() {
+    Flush();
+    file_.close();
+    if (!file_) {
+      throw std::runtime_error("can't write " + filename_);
+    }
+  }
+
+ private:
+  static constexpr std::size_t kMaxNumber = 32;
+
+  void Reserve(std::size_t bytes) {
+    if (used_ + bytes > buffer_.size()) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    file_.write(buffer_.data(), static_cast<std::streamsize>(used_));
+    used_ = 0;
+  }
+
+  std::string filename_;
+  std::ofstream file_;
+  std::array<char, std::size_t{1} << 16> buffer_;
+  std::size_t used_ = 0;
+};
+
+// Sum of a few plane waves across the terrain, coarse and high first.
+class Terrain {
+ public:
+  explicit Terrain(std::mt19937& gen) {
+    for (std::size_t i = 0; i < waves_.size(); ++i) {
+      double angle = 2 * std::numbers::pi * Uniform(gen);
+      double frequency = 2 * std::numbers::pi * (static_cast<double>(i) + 1 + Uniform(gen)) / kExtent;
+      waves_[i] = {frequency * std::cos(angle), frequency * std::sin(angle), 2 * std::numbers::pi * Uniform(gen),
+                   4 / (static_cast<double>(i) + 1)};
+    }
+  }
+
+  [[nodiscard]] double GetHeight(double x, double z) const noexcept {
+    double height = 0;
+    for (const Wave& wave : waves_) {
+      height += wave.amplitude * std::sin(wave.x * x + wave.z * z + wave.phase);
+    }
+    return height;
+  }
+
+ private:
+  struct Wave {
+    double x;
+    double z;
+    double phase;
+    double amplitude;
+  };
+
+  std::array<Wave, 4> waves_;
+};
+
+[[nodiscard]] std::string_view PickMaterial(const GeneratorOptions& options, std::mt19937& gen) {
+  static constexpr std::array<std::string_view, kGroundMaterials> kGround = {"ground0", "ground1", "ground2",
+                                                                            "ground3"};
+  double share = Uniform(gen);
+  std::size_t ground = gen() % kGroundMaterials;
+  if (share < options.refractive) {
+    return "glass";
+  }
+  return share < options.refractive + options.reflective ? "mirror" : kGround[ground];
+}
+
+void WriteMaterials(const std::string& filename) {
+  Writer mtl(filename);
+  for (std::size_t i = 0; i < kGroundMaterials; ++i) {
+    mtl.Text("newmtl ground").Index(i).Text("\nKa 0.02 0.02 0.02\nKd ").Numbers(kGroundColors[i]);
+    mtl.Text("\nKs 0 0 0\nal 1 0 0\n\n");
+  }
+  mtl.Text("newmtl mirror\nKd 0.05 0.05 0.05\nKs 0.9 0.9 0.9\nNs 512\nal 0.2 0.8 0\n\n");
+  mtl.Text("newmtl glass\nKs 0.5 0.5 0.5\nNs 1024\nNi 1.5\nal 0 0.1 0.9\n");
+  mtl.Close();
+}
+
+}  // namespace
+
+GeneratedScene GenerateScene(const GeneratorOptions& options, const std::string& filename) {
+  if (options.triangles == 0 || options.tile_size == 0) {
+    throw std::runtime_error("a scene needs at least one triangle and one cell per tile");
+  }
+  if (options.reflective < 0 || options.refractive < 0 || options.reflective + options.refractive > 1) {
+    throw std::runtime_error("material shares must not be negative or add up to more than 1");
+  }
+  // A square grid of cells, two triangles each; the last row may be partial and the last cell a single triangle.
+  std::size_t cells = options.triangles / 2 + options.triangles % 2;
+  auto columns = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(cells))));
+  std::size_t rows = (cells + columns - 1) / columns;
+  GeneratedScene scene;
+  scene.triangles = options.triangles;
+  scene.vertices = (rows + 1) * (columns + 1);
+  if (scene.vertices > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+    throw std::runtime_error("too many triangles for the indices of an OBJ file");
+  }
+  double cell = kExtent / static_cast<double>(columns);
+  double x_begin = -kExtent / 2;
+  double z_begin = -cell * static_cast<double>(rows) / 2;
+
+  std::filesystem::path path(filename);
+  std::filesystem::path mtl_path = std::filesystem::path(path).replace_extension(".mtl");
+  WriteMaterials(mtl_path.string());
+
+  std::mt19937 gen(options.seed);
+  Terrain terrain(gen);
+  Writer obj(filename);
+  obj.Text("# synthetic scene: ").Index(options.triangles).Text(" triangles, ").Index(options.spheres);
+  obj.Text(" spheres, ").Index(options.lights).Text(" lights, seed ").Index(options.seed).Text("\n");
+  obj.Text("mtllib ").Text(mtl_path.filename().string()).Text("\n");
+  for (std::size_t row = 0; row <= rows; ++row) {
+    double z = z_begin + cell * static_cast<double>(row);
+    for (std::size_t column = 0; column <= columns; ++column) {
+      double x = x_begin + cell * static_cast<double>(column);
+      obj.Text("v ").Numbers({x, terrain.GetHeight(x, z), z}).Text("\n");
+    }
+  }
+  auto vertex = [columns](std::size_t row, std::size_t column) {
+    return row * (columns + 1) + column + 1;
+  };
+  for (std::size_t tile_row = 0; tile_row * options.tile_size < rows; ++tile_row) {
+    for (std::size_t tile_column = 0; tile_column * options.tile_size < columns; ++tile_column) {
+      std::size_t row_begin = tile_row * options.tile_size;
+      std::size_t column_begin = tile_column * options.tile_size;
+      if (row_begin * columns + column_begin >= cells) {
+        continue;  // past the end of a partial last row
+      }
+      ++scene.groups;
+      obj.Text("o tile_").Index(tile_row).Text("_").Index(tile_column).Text("\n");
+      obj.Text("usemtl ").Text(PickMaterial(options, gen)).Text("\n");
+      for (std::size_t row = row_begin; row < std::min(row_begin + options.tile_size, rows); ++row) {
+        for (std::size_t column = column_begin; column < std::min(column_begin + options.tile_size, columns);
+             ++column) {
+          std::size_t index = row * columns + column;
+          if (index >= cells) {
+            break;
+          }
+          // Counterclockwise seen from above, so the normals point up.
+          std::size_t a = vertex(row, column);
+          std::size_t b = vertex(row, column + 1);
+          std::size_t c = vertex(row + 1, column + 1);
+          std::size_t d = vertex(row + 1, column);
+          obj.Text("f ").Index(a).Text(" ").Index(d).Text(" ").Index(c).Text("\n");
+          if (2 * index + 1 < options.triangles) {
+            obj.Text("f ").Index(a).Text(" ").Index(c).Text(" ").Index(b).Text("\n");
+          }
+        }
+      }
+    }
+  }
+  for (std::size_t i = 0; i < options.spheres; ++i) {
+    double x = x_begin + kExtent * Uniform(gen);
+    double z = z_begin + cell * static_cast<double>(rows) * Uniform(gen);
+    double radius = 0.5 + 2 * Uniform(gen);
+    // Clear of the coarsest grid's cells, whose flat triangles may stand above the smooth surface.
+    double y = terrain.GetHeight(x, z) + radius + 1 + 4 * Uniform(gen);
+    obj.Text("usemtl ").Text(PickMaterial(options, gen)).Text("\n");
+    obj.Text("S ").Numbers({x, y, z}).Text(" ").Number(radius).Text("\n");
+  }
+  double intensity = 1 / static_cast<double>(std::max<std::size_t>(options.lights, 1));
+  for (std::size_t i = 0; i < options.lights; ++i) {
+    double x = x_begin + kExtent * Uniform(gen);
+    double z = z_begin + cell * static_cast<double>(rows) * Uniform(gen);
+    obj.Text("P ").Numbers({x, 0.4 * kExtent + 0.2 * kExtent * Uniform(gen), z}).Text(" ");
+    obj.Numbers({intensity, intensity, intensity}).Text("\n");
+  }
+  obj.Close();
+
+  scene.spheres = options.spheres;
+  scene.lights = options.lights;
+  scene.bytes = std::filesystem::file_size(path);
+  scene.look_from = {0, 0.3 * kExtent, 0.45 * kExtent};
+  scene.look_to = {0, 0, 0};
+  return scene;
+}
+
+}  // namespace rt::generator
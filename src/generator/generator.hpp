@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rt::generator {
+
+struct GeneratorOptions {
+  std::size_t triangles = 1000;  // exactly this many
+  std::size_t spheres = 0;
+  std::size_t lights = 1;
+  // Shares of the tiles and spheres that get a reflective and a refractive material; the rest are diffuse.
+  double reflective = 0;
+  double refractive = 0;
+  std::uint32_t seed = 1;
+  // Cells on a side of a tile. Every tile is a group of its own, with up to 2 * tile_size^2 triangles.
+  std::size_t tile_size = 64;
+};
+
+struct GeneratedScene {
+  std::size_t triangles = 0;
+  std::size_t vertices = 0;
+  std::size_t groups = 0;
+  std::size_t spheres = 0;
+  std::size_t lights = 0;
+  std::uintmax_t bytes = 0;  // of the OBJ file
+  // A view of the whole terrain for the default field of view.
+  std::array<double, 3> look_from{};
+  std::array<double, 3> look_to{};
+};
+
+// Writes a synthetic scene to filename and its materials next to it, with the extension replaced by .mtl. The scene is
+// a square heightfield terrain of a fixed size, finer the more triangles there are, split into tiles of
+// tile_size x tile_size cells, with spheres resting above it and point lights high over it; the lights share a total
+// intensity of 1. Materials use the al extension for reflection and refraction. The files depend on the options only,
+// and any triangle count frames the same way, so renders of different sizes compare. Throws std::runtime_error for
+// options out of range and files that can't be written.
+GeneratedScene GenerateScene(const GeneratorOptions& options, const std::string& filename);
+
+}  // namespace rt::generator
@@ -0,0 +1,108 @@
+#include <generator/generator.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void PrintUsage(const char* program) {
+  std::cerr << "usage: " << program << " OUTPUT.obj [--triangles N] [--spheres N] [--lights N] [--reflective SHARE]\n"
+            << "       [--refractive SHARE] [--seed S] [--tile CELLS]\n"
+            << "Counts take a K, M or G suffix, e.g. --triangles 100M. Materials go to OUTPUT.mtl.\n";
+}
+
+// A count with an optional decimal suffix.
+std::size_t ParseCount(std::string_view text) {
+  std::size_t scale = 1;
+  if (!text.empty()) {
+    switch (text.back()) {
+      case 'K':
+      case 'k':
+        scale = 1000;
+        break;
+      case 'M':
+      case 'm':
+        scale = 1000 * 1000;
+        break;
+      case 'G':
+      case 'g':
+        scale = 1000 * 1000 * 1000;
+        break;
+    }
+  }
+  if (scale != 1) {
+    text.remove_suffix(1);
+  }
+  // std::stoul would skip spaces and take a minus sign, wrapping around; a count starts with a digit.
+  if (text.empty() || text.front() < '0' || text.front() > '9') {
+    throw std::invalid_argument("bad count " + std::string(text));
+  }
+  std::size_t parsed = 0;
+  std::size_t count = std::stoul(std::string(text), &parsed);
+  if (parsed != text.size()) {
+    throw std::invalid_argument("bad count " + std::string(text));
+  }
+  if (count > std::numeric_limits<std::size_t>::max() / scale) {
+    throw std::out_of_range("count " + std::string(text) + " is too large");
+  }
+  return count * scale;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc % 2 != 0) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  try {
+    rt::generator::GeneratorOptions options;
+    for (int i = 2; i < argc; i += 2) {
+      std::string_view flag = argv[i];
+      if (flag == "--triangles") {
+        options.triangles = ParseCount(argv[i + 1]);
+      } else if (flag == "--spheres") {
+        options.spheres = ParseCount(argv[i + 1]);
+      } else if (flag == "--lights") {
+        options.lights = ParseCount(argv[i + 1]);
+      } else if (flag == "--reflective") {
+        options.reflective = std::stod(argv[i + 1]);
+      } else if (flag == "--refractive") {
+        options.refractive = std::stod(argv[i + 1]);
+      } else if (flag == "--seed") {
+        options.seed = static_cast<std::uint32_t>(std::stoul(argv[i + 1]));
+      } else if (flag == "--tile") {
+        options.tile_size = ParseCount(argv[i + 1]);
+      } else {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+    std::string output = argv[1];
+    auto scene = rt::generator::GenerateScene(options, output);
+    std::cout << scene.triangles << " triangles, " << scene.vertices << " vertices in " << scene.groups
+              << " groups, " << scene.spheres << " spheres, " << scene.lights << " lights, " << scene.bytes
+              << " bytes\n";
+    // A batch_render manifest line for the scene.
+    auto vector = [](const std::array<double, 3>& value) {
+      std::ostringstream text;
+      text << value[0] << ',' << value[1] << ',' << value[2];
+      return text.str();
+    };
+    std::cout << "scene=" << output << " output=" << std::filesystem::path(output).replace_extension(".png").string()
+              << " width=640 height=480 from=" << vector(scene.look_from) << " to=" << vector(scene.look_to) << '\n';
+    return EXIT_SUCCESS;
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
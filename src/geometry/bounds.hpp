@@ -0,0 +1,73 @@
+#pragma once
+
+#include <geometry/vector.hpp>
+
+#include <cstddef>
+#include <limits>
+
+namespace rt::geom {
+
+class Bounds {
+ public:
+  Bounds() noexcept
+    : min_{std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+           std::numeric_limits<double>::infinity()},
+      max_{-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+           -std::numeric_limits<double>::infinity()} {
+  }
+
+  Bounds(const Vector& min, const Vector& max) noexcept : min_(min), max_(max) {
+  }
+
+  void Extend(const Vector& point) noexcept {
+    for (std::size_t i = 0; i < 3; ++i) {
+      min_[i] = point[i] < min_[i] ? point[i] : min_[i];
+      max_[i] = point[i] > max_[i] ? point[i] : max_[i];
+    }
+  }
+
+  void Extend(const Bounds& other) noexcept {
+    if (!other.Empty()) {
+      Extend(other.min_);
+      Extend(other.max_);
+    }
+  }
+
+  [[nodiscard]] bool Empty() const noexcept {
+    return min_[0] > max_[0];
+  }
+
+  [[nodiscard]] const Vector& Min() const noexcept {
+    return min_;
+  }
+
+  [[nodiscard]] const Vector& Max() const noexcept {
+    return max_;
+  }
+
+  [[nodiscard]] Vector Centroid() const noexcept {
+    return (min_ + max_) / 2;
+  }
+
+  [[nodiscard]] double SurfaceArea() const noexcept {
+    if (Empty()) {
+      return 0;
+    }
+    Vector extent = max_ - min_;
+    return 2 * (extent[0] * extent[1] + extent[1] * extent[2] + extent[0] * extent[2]);
+  }
+
+  [[nodiscard]] std::size_t LongestAxis() const noexcept {
+    Vector extent = max_ - min_;
+    if (extent[0] >= extent[1] && extent[0] >= extent[2]) {
+      return 0;
+    }
+    return extent[1] >= extent[2] ? 1 : 2;
+  }
+
+ private:
+  Vector min_;
+  Vector max_;
+};
+
+}  // namespace rt::geom
@@ -5,18 +5,21 @@ namespace rt::geom {
 std::optional<Intersection> GetIntersection(const Ray& ray, const Sphere& sphere) noexcept {
   Vector l = sphere.GetCenter() - ray.GetOrigin();
   double tc = DotProduct(ray.GetDirection(), l);
-  if (tc < 0) {
+  double radius_sq = sphere.GetRadius() * sphere.GetRadius();
+  double disc = radius_sq - (DotProduct(l, l) - tc * tc);
+  if (tc < 0 || disc < 0) {
     return {};
   }
-  double d = sqrt(-tc * tc + Length(l) * Length(l));
-  if (d > sphere.GetRadius()) {
-    return {};
-  }
-  double tc1 = sqrt(pow(sphere.GetRadius(), 2) - pow(d, 2));
-  double distance = tc >= tc1 ? (tc - tc1) : (tc + tc1);
+  double tc1 = sqrt(disc);
+  return MakeSphereIntersection(ray, sphere, tc >= tc1 ? (tc - tc1) : (tc + tc1));
+}
+
+Intersection MakeSphereIntersection(const Ray& ray, const Sphere& sphere, double distance) noexcept {
+  // Past the point closest to the center the ray is leaving the sphere, so it started inside.
+  double tc = DotProduct(ray.GetDirection(), sphere.GetCenter() - ray.GetOrigin());
   Vector point = ray.GetOrigin() + distance * ray.GetDirection();
   Vector normal = point - sphere.GetCenter();
-  if (tc < tc1) {
+  if (distance > tc) {
     normal = -normal;
   }
   normal.Normalize();
@@ -79,6 +82,19 @@ Vector Reflect(const Vector& ray, const Vector& normal) noexcept {
   return reflected;
 }
 
+Bounds GetBounds(const Sphere& sphere) noexcept {
+  Vector radius{sphere.GetRadius(), sphere.GetRadius(), sphere.GetRadius()};
+  return Bounds{sphere.GetCenter() - radius, sphere.GetCenter() + radius};
+}
+
+Bounds GetBounds(const Triangle& triangle) noexcept {
+  Bounds bounds;
+  for (std::size_t i = 0; i < 3; ++i) {
+    bounds.Extend(triangle.GetVertex(i));
+  }
+  return bounds;
+}
+
 Vector GetBarycentricCoords(const Triangle& triangle, const Vector& point) noexcept {
   double u = Triangle{triangle.GetVertex(2), triangle.GetVertex(0), point}.Area() / triangle.Area();
   double v = Triangle{triangle.GetVertex(0), triangle.GetVertex(1), point}.Area() / triangle.Area();
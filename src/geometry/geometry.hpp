@@ -1,5 +1,6 @@
 #pragma once
 
+#include <geometry/bounds.hpp>
 #include <geometry/intersection.hpp>
 #include <geometry/ray.hpp>
 #include <geometry/sphere.hpp>
@@ -12,6 +13,11 @@ namespace rt::geom {
 
 [[nodiscard]] std::optional<Intersection> GetIntersection(const Ray& ray, const Sphere& sphere) noexcept;
 [[nodiscard]] std::optional<Intersection> GetIntersection(const Ray& ray, const Triangle& triangle) noexcept;
+// The hit at distance along the ray, which must be one GetIntersection(ray, sphere) or SphereBatch::FindNearest()
+// reported. The normal points inwards when the ray starts inside the sphere.
+[[nodiscard]] Intersection MakeSphereIntersection(const Ray& ray, const Sphere& sphere, double distance) noexcept;
+[[nodiscard]] Bounds GetBounds(const Sphere& sphere) noexcept;
+[[nodiscard]] Bounds GetBounds(const Triangle& triangle) noexcept;
 [[nodiscard]] Vector GetBarycentricCoords(const Triangle& triangle, const Vector& point) noexcept;
 
 [[nodiscard]] std::optional<Vector> Refract(const Vector& ray, const Vector& normal, double eta) noexcept;
@@ -0,0 +1,55 @@
+#include <geometry/octahedral.hpp>
+
+#include <cmath>
+
+namespace rt::geom {
+
+namespace {
+
+constexpr double kScale = 32767;
+
+[[nodiscard]] double SignNotZero(double value) noexcept {
+  return value >= 0 ? 1 : -1;
+}
+
+[[nodiscard]] std::uint32_t Quantize(double value) noexcept {
+  value = value < -1 ? -1 : (value > 1 ? 1 : value);
+  auto snorm = static_cast<std::int16_t>(std::lround(value * kScale));
+  return static_cast<std::uint16_t>(snorm);
+}
+
+[[nodiscard]] double Dequantize(std::uint32_t bits) noexcept {
+  auto snorm = static_cast<std::int16_t>(static_cast<std::uint16_t>(bits));
+  double value = snorm / kScale;
+  return value < -1 ? -1 : value;
+}
+
+}  // namespace
+
+std::uint32_t EncodeOctahedral(const Vector& normal) noexcept {
+  double l1 = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+  double u = normal[0] / l1;
+  double v = normal[1] / l1;
+  if (normal[2] < 0) {
+    double folded_u = (1 - std::fabs(v)) * SignNotZero(u);
+    v = (1 - std::fabs(u)) * SignNotZero(v);
+    u = folded_u;
+  }
+  return Quantize(u) | (Quantize(v) << 16);
+}
+
+Vector DecodeOctahedral(std::uint32_t code) noexcept {
+  double u = Dequantize(code);
+  double v = Dequantize(code >> 16);
+  double z = 1 - std::fabs(u) - std::fabs(v);
+  if (z < 0) {
+    double unfolded_u = (1 - std::fabs(v)) * SignNotZero(u);
+    v = (1 - std::fabs(u)) * SignNotZero(v);
+    u = unfolded_u;
+  }
+  Vector normal{u, v, z};
+  normal.Normalize();
+  return normal;
+}
+
+}  // namespace rt::geom
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <geometry/vector.hpp>
+
+#include <cstdint>
+
+namespace rt::geom {
+
+// Unit vectors packed into 32 bits: the direction is projected onto the octahedron |x| + |y| + |z| = 1, the lower
+// hemisphere is folded over the upper one, and the two remaining coordinates are stored as 16-bit snorm values.
+// The angular error is below 1e-4 radians.
+[[nodiscard]] std::uint32_t EncodeOctahedral(const Vector& normal) noexcept;
+[[nodiscard]] Vector DecodeOctahedral(std::uint32_t code) noexcept;
+
+}  // namespace rt::geom
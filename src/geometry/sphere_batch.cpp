@@ -0,0 +1,91 @@
+#include <geometry/sphere_batch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace rt::geom {
+
+namespace {
+
+constexpr double kMiss = std::numeric_limits<double>::infinity();
+
+}  // namespace
+
+void SphereBatch::Reserve(std::size_t count) {
+  std::size_t padded = (count + kLanes - 1) / kLanes * kLanes;
+  center_x_.reserve(padded);
+  center_y_.reserve(padded);
+  center_z_.reserve(padded);
+  radius_sq_.reserve(padded);
+}
+
+std::size_t SphereBatch::MemoryUsage() const noexcept {
+  return (center_x_.capacity() + center_y_.capacity() + center_z_.capacity() + radius_sq_.capacity()) * sizeof(double);
+}
+
+void SphereBatch::Add(const Sphere& sphere) {
+  if (size_ % kLanes == 0) {
+    // Padding lanes have a negative squared radius, so the discriminant test always rejects them.
+    center_x_.resize(size_ + kLanes, 0);
+    center_y_.resize(size_ + kLanes, 0);
+    center_z_.resize(size_ + kLanes, 0);
+    radius_sq_.resize(size_ + kLanes, -1);
+  }
+  ++size_;
+  Set(size_ - 1, sphere);
+}
+
+void SphereBatch::Set(std::size_t index, const Sphere& sphere) noexcept {
+  center_x_[index] = sphere.GetCenter()[0];
+  center_y_[index] = sphere.GetCenter()[1];
+  center_z_[index] = sphere.GetCenter()[2];
+  radius_sq_[index] = sphere.GetRadius() * sphere.GetRadius();
+}
+
+std::optional<SphereHit> SphereBatch::FindNearest(const Ray& ray) const noexcept {
+  const double ox = ray.GetOrigin()[0];
+  const double oy = ray.GetOrigin()[1];
+  const double oz = ray.GetOrigin()[2];
+  const double dx = ray.GetDirection()[0];
+  const double dy = ray.GetDirection()[1];
+  const double dz = ray.GetDirection()[2];
+
+  const double* cx = center_x_.data();
+  const double* cy = center_y_.data();
+  const double* cz = center_z_.data();
+  const double* r2 = radius_sq_.data();
+
+  double best = kMiss;
+  std::size_t best_index = 0;
+  for (std::size_t base = 0; base < center_x_.size(); base += kLanes) {
+    // Branch-free body over a fixed number of lanes, so the compiler can keep the whole block in vector registers.
+    std::array<double, kLanes> t;
+#pragma omp simd
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+      double lx = cx[base + lane] - ox;
+      double ly = cy[base + lane] - oy;
+      double lz = cz[base + lane] - oz;
+      double tc = lx * dx + ly * dy + lz * dz;
+      double d2 = lx * lx + ly * ly + lz * lz - tc * tc;
+      double disc = r2[base + lane] - d2;
+      double tc1 = std::sqrt(disc < 0 ? 0.0 : disc);
+      double distance = tc >= tc1 ? tc - tc1 : tc + tc1;
+      bool miss = (tc < 0) | (disc < 0);
+      t[lane] = miss ? kMiss : distance;
+    }
+    for (std::size_t lane = 0; lane < kLanes; ++lane) {
+      if (t[lane] < best) {
+        best = t[lane];
+        best_index = base + lane;
+      }
+    }
+  }
+  if (best == kMiss) {
+    return {};
+  }
+  return SphereHit{best, best_index};
+}
+
+}  // namespace rt::geom
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <geometry/ray.hpp>
+#include <geometry/sphere.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace rt::geom {
+
+struct SphereHit {
+  double distance;
+  std::size_t index;
+};
+
+// Structure-of-arrays copy of a sphere set. The arrays are padded to a multiple of kLanes with spheres that can
+// never be hit, so the kernel runs over whole blocks without a scalar tail.
+class SphereBatch {
+ public:
+  static constexpr std::size_t kLanes = 8;
+
+  SphereBatch() = default;
+
+  void Reserve(std::size_t count);
+  void Add(const Sphere& sphere);
+  // Replaces the sphere at index, which must be below Size().
+  void Set(std::size_t index, const Sphere& sphere) noexcept;
+
+  [[nodiscard]] std::size_t Size() const noexcept {
+    return size_;
+  }
+
+  [[nodiscard]] bool Empty() const noexcept {
+    return size_ == 0;
+  }
+
+  // Nearest hit of the ray among all spheres. Uses the same hit rules as GetIntersection(Ray, Sphere), ties go to
+  // the lowest index.
+  [[nodiscard]] std::optional<SphereHit> FindNearest(const Ray& ray) const noexcept;
+
+  // Heap bytes held by the arrays, counting reserved capacity.
+  [[nodiscard]] std::size_t MemoryUsage() const noexcept;
+
+ private:
+  std::vector<double> center_x_;
+  std::vector<double> center_y_;
+  std::vector<double> center_z_;
+  std::vector<double> radius_sq_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace rt::geom
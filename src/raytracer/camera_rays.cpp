@@ -0,0 +1,64 @@
+#include <raytracer/camera_rays.hpp>
+
+#include <raytracer/matrix.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace rt {
+
+namespace {
+
+// Even bits of a Morton index packed together, i.e. one coordinate of the pixel it names.
+[[nodiscard]] int CompactBits(std::uint32_t bits) noexcept {
+  bits &= 0x55555555;
+  bits = (bits | (bits >> 1)) & 0x33333333;
+  bits = (bits | (bits >> 2)) & 0x0f0f0f0f;
+  bits = (bits | (bits >> 4)) & 0x00ff00ff;
+  bits = (bits | (bits >> 8)) & 0x0000ffff;
+  return static_cast<int>(bits);
+}
+
+}  // namespace
+
+CameraRays::CameraRays(const CameraOptions& camera_options) : origin_(camera_options.look_from) {
+  double aspect_ratio = static_cast<double>(camera_options.screen_width) / camera_options.screen_height;
+  double scale = tan(camera_options.fov / 2);
+  // A pixel spans 2 * scale / height on the image plane at distance 1, and an angle smaller by cos^2 of how far off
+  // the axis it is.
+  pixel_angle_ = 2 * scale / camera_options.screen_height / (1 + scale * scale * (1 + aspect_ratio * aspect_ratio));
+  Matrix camera_to_world = MakeCameraToWorld(camera_options.look_from, camera_options.look_to);
+  geom::Vector right = camera_to_world.multiply_direction({1, 0, 0});
+  geom::Vector up = camera_to_world.multiply_direction({0, 1, 0});
+  geom::Vector forward = camera_to_world.multiply_direction({0, 0, -1});
+  columns_.reserve(camera_options.screen_width);
+  for (int x = 0; x < camera_options.screen_width; ++x) {
+    double px = (2 * ((x + 0.5) / camera_options.screen_width) - 1) * scale * aspect_ratio;
+    columns_.push_back(px * right);
+  }
+  rows_.reserve(camera_options.screen_height);
+  for (int y = 0; y < camera_options.screen_height; ++y) {
+    double py = (1 - 2 * (y + 0.5) / camera_options.screen_height) * scale;
+    rows_.push_back(py * up + forward);
+  }
+}
+
+void CameraRays::Fill(const Region& block, std::vector<PixelRay>* packet) const {
+  assert(block.Width() <= kMaxBlockSize && block.Height() <= kMaxBlockSize);
+  packet->clear();
+  int side = 1;
+  while (side < block.Width() || side < block.Height()) {
+    side *= 2;
+  }
+  auto count = static_cast<std::uint32_t>(side) * static_cast<std::uint32_t>(side);
+  for (std::uint32_t index = 0; index < count; ++index) {
+    int x = block.x_begin + CompactBits(index);
+    int y = block.y_begin + CompactBits(index >> 1);
+    if (x < block.x_end && y < block.y_end) {
+      packet->push_back({x, y, Get(x, y)});
+    }
+  }
+}
+
+}  // namespace rt
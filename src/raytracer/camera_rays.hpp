@@ -0,0 +1,52 @@
+#pragma once
+
+#include <geometry/ray.hpp>
+#include <geometry/vector.hpp>
+#include <raytracer/camera_options.hpp>
+#include <raytracer/tile.hpp>
+
+#include <vector>
+
+namespace rt {
+
+struct PixelRay {
+  int x;
+  int y;
+  geom::Ray ray;
+};
+
+// Primary rays of a camera. The direction through a pixel is the sum of a per-column and a per-row vector computed
+// once per frame, so a ray costs three additions and the normalization instead of a matrix product with a
+// homogeneous divide. Each direction depends only on its pixel, whatever block it is generated in.
+class CameraRays {
+ public:
+  explicit CameraRays(const CameraOptions& camera_options);
+
+  [[nodiscard]] geom::Ray Get(int x, int y) const noexcept {
+    return {origin_, columns_[x] + rows_[y]};
+  }
+
+  [[nodiscard]] const geom::Vector& GetOrigin() const noexcept {
+    return origin_;
+  }
+
+  // Smallest angle between the rays of neighbouring pixels, found at the corners of the frame.
+  [[nodiscard]] double GetPixelAngle() const noexcept {
+    return pixel_angle_;
+  }
+
+  // Replaces the contents of packet with the rays of block, a region of the frame, in Morton order: pixels close in
+  // the packet are close on screen in both directions, so consecutive rays mostly touch the same geometry. Blocks
+  // up to kMaxBlockSize on a side are covered in full.
+  void Fill(const Region& block, std::vector<PixelRay>* packet) const;
+
+  static constexpr int kMaxBlockSize = 256;
+
+ private:
+  geom::Vector origin_;
+  double pixel_angle_;
+  std::vector<geom::Vector> columns_;
+  std::vector<geom::Vector> rows_;
+};
+
+}  // namespace rt
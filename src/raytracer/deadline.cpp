@@ -0,0 +1,165 @@
+#include <raytracer/deadline.hpp>
+
+#include <raytracer/tile.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace rt {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]] double SecondsBetween(Clock::time_point from, Clock::time_point to) noexcept {
+  return std::chrono::duration<double>(to - from).count();
+}
+
+// Squares of size pixels in rows, top to bottom; the last row and column are cut to the frame.
+[[nodiscard]] std::vector<Region> SplitIntoTiles(int width, int height, int size) {
+  std::vector<Region> regions;
+  for (int y = 0; y < height; y += size) {
+    for (int x = 0; x < width; x += size) {
+      regions.push_back({x, y, std::min(x + size, width), std::min(y + size, height)});
+    }
+  }
+  return regions;
+}
+
+// The pixels of a smaller frame of the same view that a region of the full frame falls on.
+[[nodiscard]] Region ScaleDown(const Region& region, int frame_width, int frame_height, int width, int height) {
+  auto scale = [](int value, int from, int to) {
+    return static_cast<int>(static_cast<std::int64_t>(value) * to / from);
+  };
+  return {scale(region.x_begin, frame_width, width), scale(region.y_begin, frame_height, height),
+          scale(region.x_end - 1, frame_width, width) + 1, scale(region.y_end - 1, frame_height, height) + 1};
+}
+
+// A region of the full frame filled from a tile traced at a lower resolution, each pixel with the one it falls on,
+// and with the maxima over the pixels used, so the result merges with traced tiles like any other.
+[[nodiscard]] Tile ScaleUp(const Tile& coarse, int frame_width, int frame_height, const Region& region) {
+  Tile tile;
+  tile.frame_width = frame_width;
+  tile.frame_height = frame_height;
+  tile.mode = coarse.mode;
+  tile.region = region;
+  tile.values.reserve(static_cast<std::size_t>(region.Width()) * region.Height());
+  tile.hits.reserve(tile.values.capacity());
+  auto coarse_width = static_cast<std::int64_t>(coarse.frame_width);
+  auto coarse_height = static_cast<std::int64_t>(coarse.frame_height);
+  for (int y = region.y_begin; y < region.y_end; ++y) {
+    std::size_t row = static_cast<std::size_t>(y * coarse_height / frame_height - coarse.region.y_begin) *
+                      coarse.region.Width();
+    for (int x = region.x_begin; x < region.x_end; ++x) {
+      std::size_t index = row + static_cast<std::size_t>(x * coarse_width / frame_width - coarse.region.x_begin);
+      const geom::Vector& value = coarse.values[index];
+      tile.values.push_back(value);
+      tile.hits.push_back(coarse.hits[index]);
+      if (!coarse.hits[index]) {
+        continue;
+      }
+      if (tile.mode == RenderMode::kDepth) {
+        tile.max_distance = std::max(tile.max_distance, value[0]);
+      } else if (tile.mode == RenderMode::kFull) {
+        tile.max_rgb = std::max({tile.max_rgb, value[0], value[1], value[2]});
+      }
+    }
+  }
+  return tile;
+}
+
+// The camera of the same view at 1/scale of the resolution, rounded up.
+[[nodiscard]] CameraOptions ScaleCamera(CameraOptions camera_options, int scale) noexcept {
+  camera_options.screen_width = (camera_options.screen_width + scale - 1) / scale;
+  camera_options.screen_height = (camera_options.screen_height + scale - 1) / scale;
+  return camera_options;
+}
+
+}  // namespace
+
+std::string_view GetQualityName(RenderQuality quality) noexcept {
+  switch (quality) {
+    case RenderQuality::kPreview:
+      return "preview";
+    case RenderQuality::kHalf:
+      return "half";
+    case RenderQuality::kFull:
+      return "full";
+  }
+  return "unknown";
+}
+
+DeadlineRender RenderWithDeadline(const Scene& scene, const CameraOptions& camera_options,
+                                  const RenderOptions& render_options, const DeadlineOptions& deadline_options) {
+  if (deadline_options.tile_size <= 0) {
+    throw std::runtime_error("tile size must be positive");
+  }
+  auto start = Clock::now();
+  int width = camera_options.screen_width;
+  int height = camera_options.screen_height;
+  RenderOptions preview_options = render_options;
+  preview_options.depth = 0;
+  CameraOptions preview_camera = ScaleCamera(camera_options, kPreviewScale);
+  Tile preview = RenderTile(scene, preview_camera, preview_options,
+                            {0, 0, preview_camera.screen_width, preview_camera.screen_height});
+  CameraOptions half_camera = ScaleCamera(camera_options, 2);
+
+  DeadlineRender result{image::Image(0, 0), RenderQuality::kFull};
+  std::vector<Region> regions = SplitIntoTiles(width, height, deadline_options.tile_size);
+  std::vector<Tile> tiles;
+  tiles.reserve(regions.size());
+  // Seconds per pixel of the full frame so far.
+  double full_seconds = 0;
+  double full_pixels = 0;
+  double half_seconds = 0;
+  double half_pixels = 0;
+  double pixels_left = static_cast<double>(width) * height;
+  for (const Region& region : regions) {
+    if (deadline_options.stop_token.stop_requested()) {
+      result.stopped = true;
+      break;
+    }
+    auto now = Clock::now();
+    if (now >= deadline_options.deadline) {
+      break;
+    }
+    // The first tile is traced in full to time it; until a half tile is timed too, it is taken to cost a quarter.
+    bool full = full_pixels == 0;
+    if (!full) {
+      double full_rate = full_seconds / full_pixels;
+      double half_rate = half_pixels > 0 ? half_seconds / half_pixels : full_rate / 4;
+      full = full_rate * pixels_left <= SecondsBetween(now, deadline_options.deadline) || full_rate <= half_rate;
+    }
+    double pixels = static_cast<double>(region.Width()) * region.Height();
+    if (full) {
+      tiles.push_back(RenderTile(scene, camera_options, render_options, region));
+      full_seconds += SecondsBetween(now, Clock::now());
+      full_pixels += pixels;
+      ++result.full_tiles;
+    } else {
+      Region half_region = ScaleDown(region, width, height, half_camera.screen_width, half_camera.screen_height);
+      tiles.push_back(ScaleUp(RenderTile(scene, half_camera, render_options, half_region), width, height, region));
+      half_seconds += SecondsBetween(now, Clock::now());
+      half_pixels += pixels;
+      ++result.half_tiles;
+    }
+    pixels_left -= pixels;
+  }
+  for (std::size_t i = tiles.size(); i < regions.size(); ++i) {
+    tiles.push_back(ScaleUp(preview, width, height, regions[i]));
+    ++result.preview_tiles;
+  }
+
+  result.image = MergeTiles(tiles);
+  if (result.preview_tiles > 0) {
+    result.quality = RenderQuality::kPreview;
+  } else if (result.half_tiles > 0) {
+    result.quality = RenderQuality::kHalf;
+  }
+  result.seconds = SecondsBetween(start, Clock::now());
+  return result;
+}
+
+}  // namespace rt
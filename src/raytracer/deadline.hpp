@@ -0,0 +1,53 @@
+#pragma once
+
+#include <raytracer/camera_options.hpp>
+#include <raytracer/image.hpp>
+#include <raytracer/render_options.hpp>
+#include <scene/scene.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <stop_token>
+#include <string_view>
+
+namespace rt {
+
+// How far a tile of a deadline render got, worst first.
+enum class RenderQuality {
+  kPreview,  // only the preview: the frame traced at 1/kPreviewScale of the resolution without secondary rays
+  kHalf,     // traced at half the resolution, one ray per 2x2 pixels
+  kFull,     // as rt::Render() traces it
+};
+
+[[nodiscard]] std::string_view GetQualityName(RenderQuality quality) noexcept;
+
+struct DeadlineOptions {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  // A stop requested through the matching std::stop_source ends the render as soon as the current tile is done.
+  std::stop_token stop_token;
+  int tile_size = 32;
+};
+
+struct DeadlineRender {
+  image::Image image;
+  RenderQuality quality;  // of the worst tile
+  std::size_t full_tiles = 0;
+  std::size_t half_tiles = 0;
+  std::size_t preview_tiles = 0;
+  bool stopped = false;  // a stop was requested before every tile was done
+  double seconds = 0;
+};
+
+constexpr int kPreviewScale = 8;
+
+// Renders as much of the frame as fits before the deadline or a stop request, checking both between tiles. A preview
+// of the whole frame comes first and is always finished, so there is an image however early the render ends; it
+// costs about 1/64 of a render without secondary rays. Tiles then go in rows, in full while the time left, at the rate
+// measured so far, covers the rest of the frame in full, and at half the resolution, for about a quarter of the cost,
+// while it does not. Tiles not reached keep the preview. With no deadline and no stop, the image is the one
+// rt::Render() gives.
+[[nodiscard]] DeadlineRender RenderWithDeadline(const Scene& scene, const CameraOptions& camera_options,
+                                                const RenderOptions& render_options,
+                                                const DeadlineOptions& deadline_options);
+
+}  // namespace rt
@@ -1,8 +1,12 @@
 #include <raytracer/image.hpp>
+#include <util/profile.hpp>
+#include <util/trace.hpp>
 
 namespace rt::image {
 
 void Image::Write(const std::string& filename) {
+  util::PhaseScope phase(util::Phase::kEncoding);
+  RT_TRACE_SPAN("write image", filename);
   FILE* fp = fopen(filename.c_str(), "wb");
   if (!fp) {
     throw std::runtime_error("Can't open file " + filename);
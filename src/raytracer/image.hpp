@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <utility>
 
 #include <jpeglib.h>
 #include <png.h>
@@ -22,6 +23,23 @@ class Image {
 
   void PrepareImage(int width, int height);
 
+  // Owns its rows, so it moves (e.g. to a writer thread) but does not copy.
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+
+  Image(Image&& other) noexcept
+    : width_(std::exchange(other.width_, 0)),
+      height_(std::exchange(other.height_, 0)),
+      bytes_(std::exchange(other.bytes_, nullptr)) {
+  }
+
+  Image& operator=(Image&& other) noexcept {
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    std::swap(bytes_, other.bytes_);
+    return *this;
+  }
+
   explicit Image(const std::string& filename) {
     if (filename.find(".png") != std::string::npos) {
       ReadPng(filename);
@@ -48,6 +66,11 @@ class Image {
     px[2] = pixel.b;
   }
 
+  // Pixels of a row as R, G, B, A bytes, for passes over whole rows.
+  [[nodiscard]] const unsigned char* Row(int y) const noexcept {
+    return bytes_[y];
+  }
+
   [[nodiscard]] int Height() const noexcept {
     return height_;
   }
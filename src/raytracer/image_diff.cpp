@@ -0,0 +1,120 @@
+#include <raytracer/image_diff.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rt::image {
+
+namespace {
+
+// Below this many pixels per thread, starting threads costs more than the comparison itself.
+constexpr std::size_t kMinPixelsPerTask = std::size_t{1} << 16;
+
+struct DiffSums {
+  std::uint64_t squared_error = 0;  // over all channels
+  std::uint64_t pixels_over = 0;
+  int max_squared_distance = 0;
+};
+
+// Integer arithmetic on the raw RGBA rows with the reductions declared, so the loop runs in vector registers; the
+// distance is compared squared, and the only square root is taken once at the end.
+DiffSums CompareRows(const Image& actual, const Image& expected, int min_squared_distance, int y_begin, int y_end) {
+  DiffSums sums;
+  int width = actual.Width();
+  for (int y = y_begin; y < y_end; ++y) {
+    const unsigned char* lhs = actual.Row(y);
+    const unsigned char* rhs = expected.Row(y);
+    std::uint64_t squared_error = 0;
+    std::uint64_t pixels_over = 0;
+    int max_squared_distance = 0;
+#pragma omp simd reduction(+ : squared_error, pixels_over) reduction(max : max_squared_distance)
+    for (int x = 0; x < width; ++x) {
+      int r = lhs[4 * x] - rhs[4 * x];
+      int g = lhs[4 * x + 1] - rhs[4 * x + 1];
+      int b = lhs[4 * x + 2] - rhs[4 * x + 2];
+      int squared_distance = r * r + g * g + b * b;
+      squared_error += static_cast<std::uint64_t>(squared_distance);
+      pixels_over += squared_distance >= min_squared_distance;
+      max_squared_distance = std::max(max_squared_distance, squared_distance);
+    }
+    sums.squared_error += squared_error;
+    sums.pixels_over += pixels_over;
+    sums.max_squared_distance = std::max(sums.max_squared_distance, max_squared_distance);
+  }
+  return sums;
+}
+
+void CheckSameSize(const Image& actual, const Image& expected) {
+  if (actual.Width() != expected.Width() || actual.Height() != expected.Height()) {
+    throw std::runtime_error("images differ in size: " + std::to_string(actual.Width()) + "x" +
+                             std::to_string(actual.Height()) + " and " + std::to_string(expected.Width()) + "x" +
+                             std::to_string(expected.Height()));
+  }
+}
+
+}  // namespace
+
+ImageDiff CompareImages(const Image& actual, const Image& expected, const ImageDiffOptions& options) {
+  CheckSameSize(actual, expected);
+  // Distances are square roots of integers, so comparing against the smallest integer square at or above the
+  // tolerance squared is exact.
+  double tolerance = std::max(options.tolerance, 0.0);
+  auto min_squared_distance = static_cast<int>(std::ceil(tolerance * tolerance));
+  std::size_t threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  std::size_t pixels = static_cast<std::size_t>(actual.Width()) * actual.Height();
+  int height = actual.Height();
+  auto tasks = static_cast<int>(
+      std::clamp<std::size_t>(std::min(threads, pixels / kMinPixelsPerTask), 1, std::max(height, 1)));
+  std::vector<std::future<DiffSums>> bands;
+  for (int task = 1; task < tasks; ++task) {
+    bands.push_back(std::async(std::launch::async, CompareRows, std::cref(actual), std::cref(expected),
+                               min_squared_distance, height * task / tasks, height * (task + 1) / tasks));
+  }
+  DiffSums sums = CompareRows(actual, expected, min_squared_distance, 0, height / tasks);
+  for (auto& band : bands) {
+    DiffSums band_sums = band.get();
+    sums.squared_error += band_sums.squared_error;
+    sums.pixels_over += band_sums.pixels_over;
+    sums.max_squared_distance = std::max(sums.max_squared_distance, band_sums.max_squared_distance);
+  }
+
+  ImageDiff diff;
+  diff.max_error = std::sqrt(static_cast<double>(sums.max_squared_distance));
+  diff.pixels_over = sums.pixels_over;
+  diff.over_tolerance = pixels != 0 ? static_cast<double>(sums.pixels_over) / pixels : 0;
+  double mse = pixels != 0 ? static_cast<double>(sums.squared_error) / (3.0 * pixels) : 0;
+  diff.psnr = mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+  return diff;
+}
+
+Image MakeDiffHeatmap(const Image& actual, const Image& expected, double tolerance) {
+  CheckSameSize(actual, expected);
+  double max_error = CompareImages(actual, expected, {tolerance, 0}).max_error;
+  Image heatmap(actual.Width(), actual.Height());
+  for (int y = 0; y < actual.Height(); ++y) {
+    for (int x = 0; x < actual.Width(); ++x) {
+      RGB lhs = actual.GetPixel(y, x);
+      RGB rhs = expected.GetPixel(y, x);
+      int r = lhs.r - rhs.r;
+      int g = lhs.g - rhs.g;
+      int b = lhs.b - rhs.b;
+      double error = std::sqrt(r * r + g * g + b * b);
+      if (error < tolerance) {
+        int gray = (rhs.r + rhs.g + rhs.b) / 12;
+        heatmap.SetPixel({gray, gray, gray}, y, x);
+      } else {
+        heatmap.SetPixel({255, max_error > 0 ? static_cast<int>(255 * (error / max_error)) : 0, 0}, y, x);
+      }
+    }
+  }
+  return heatmap;
+}
+
+}  // namespace rt::image
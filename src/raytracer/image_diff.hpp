@@ -0,0 +1,30 @@
+#pragma once
+
+#include <raytracer/image.hpp>
+
+#include <cstddef>
+
+namespace rt::image {
+
+struct ImageDiffOptions {
+  // Pixels at least this far apart (Euclidean distance of the RGB values) count as different.
+  double tolerance = 2;
+  // 0 means one per hardware thread; small images are compared on the calling thread.
+  std::size_t threads = 0;
+};
+
+struct ImageDiff {
+  double max_error = 0;        // largest RGB distance of a pixel
+  double psnr = 0;             // over all channels, in dB; infinite for identical images
+  double over_tolerance = 0;   // fraction of pixels at least tolerance apart
+  std::size_t pixels_over = 0;
+};
+
+// Compares two images of the same size, row bands in parallel. Throws std::runtime_error if the sizes differ.
+[[nodiscard]] ImageDiff CompareImages(const Image& actual, const Image& expected, const ImageDiffOptions& options = {});
+
+// Heatmap of where two images of the same size differ: the expected image dimmed to gray where pixels match within
+// tolerance, and red through yellow by error elsewhere, yellow being the largest error.
+[[nodiscard]] Image MakeDiffHeatmap(const Image& actual, const Image& expected, double tolerance = 2);
+
+}  // namespace rt::image
@@ -52,4 +52,58 @@ namespace rt {
   return {x, y, z};
 }
 
+[[nodiscard]] geom::Vector Matrix::multiply_direction(const geom::Vector& v) const noexcept {
+  double x = v[0] * matrix_[0][0] + v[1] * matrix_[1][0] + v[2] * matrix_[2][0];
+  double y = v[0] * matrix_[0][1] + v[1] * matrix_[1][1] + v[2] * matrix_[2][1];
+  double z = v[0] * matrix_[0][2] + v[1] * matrix_[1][2] + v[2] * matrix_[2][2];
+  return {x, y, z};
+}
+
+[[nodiscard]] Matrix MakeIdentity() noexcept {
+  Matrix identity;
+  for (std::size_t i = 0; i < 4; ++i) {
+    identity[i][i] = 1;
+  }
+  return identity;
+}
+
+namespace {
+
+[[nodiscard]] double LinearDeterminant(const Matrix& m) noexcept {
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+         m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+}  // namespace
+
+[[nodiscard]] bool IsInvertible(const Matrix& m) noexcept {
+  return fabs(LinearDeterminant(m)) > m.epsilon;
+}
+
+[[nodiscard]] Matrix Inverse(const Matrix& m) noexcept {
+  // Rows 0-2 hold the linear part L and row 3 the translation t, so the inverse is L^-1 and -t * L^-1.
+  double det = LinearDeterminant(m);
+  assert(fabs(det) > m.epsilon);
+  Matrix inverse;
+  inverse[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+  inverse[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+  inverse[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+  inverse[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+  inverse[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+  inverse[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+  inverse[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+  inverse[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+  inverse[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+  geom::Vector translation = -inverse.multiply_direction({m[3][0], m[3][1], m[3][2]});
+  inverse[3][0] = translation[0];
+  inverse[3][1] = translation[1];
+  inverse[3][2] = translation[2];
+  inverse[3][3] = 1;
+  return inverse;
+}
+
+[[nodiscard]] bool IsIdentity(const Matrix& m) noexcept {
+  return m.matrix_ == MakeIdentity().matrix_;
+}
+
 }  // namespace rt
@@ -11,12 +11,20 @@ struct Matrix {
     return matrix_[ind];
   }
   [[nodiscard]] geom::Vector multiply_vector(const geom::Vector& v) const noexcept;
+  // Linear part only: directions are not affected by the translation row.
+  [[nodiscard]] geom::Vector multiply_direction(const geom::Vector& v) const noexcept;
   [[nodiscard]] const std::array<double, 4>& operator[](std::size_t ind) const noexcept {
     return matrix_[ind];
   }
-  std::array<std::array<double, 4>, 4> matrix_;
+  std::array<std::array<double, 4>, 4> matrix_{};
 };
 
+[[nodiscard]] Matrix MakeIdentity() noexcept;
+// Inverse of an affine transform (the last column is expected to be 0 0 0 1).
+[[nodiscard]] Matrix Inverse(const Matrix& m) noexcept;
+// Whether the linear part (rows and columns 0-2) has a determinant above epsilon, i.e. Inverse() may be called.
+[[nodiscard]] bool IsInvertible(const Matrix& m) noexcept;
+[[nodiscard]] bool IsIdentity(const Matrix& m) noexcept;
 [[nodiscard]] Matrix MakeCameraToWorld(const geom::Vector& from, const geom::Vector& to) noexcept;
 
 }  // namespace rt
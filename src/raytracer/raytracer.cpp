@@ -3,13 +3,24 @@
 #include <geometry/ray.hpp>
 #include <geometry/vector.hpp>
 #include <raytracer/camera_options.hpp>
+#include <raytracer/camera_rays.hpp>
 #include <raytracer/image.hpp>
-#include <raytracer/matrix.hpp>
+#include <raytracer/raytracer.hpp>
+#include <raytracer/relight.hpp>
 #include <raytracer/render_options.hpp>
+#include <raytracer/tile.hpp>
+#include <raytracer/tonemap.hpp>
 #include <scene/reader.hpp>
+#include <util/profile.hpp>
+#include <util/trace.hpp>
 
 #include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace rt {
 
@@ -22,62 +33,26 @@ struct Value {
   bool intersect;
 };
 
-class Picture {
+// Stores pixel values into a tile, addressed by frame coordinates.
+class TilePixels {
  public:
-  Picture(int width, int height) : width_(width), height_(height) {
-    picture_ = new Value*[height_];
-    for (int y = 0; y < height_; y++) {
-      picture_[y] = new Value[width_];
-    }
-  }
-  [[nodiscard]] Value GetValue(int y, int x) const noexcept {
-    return picture_[y][x];
+  explicit TilePixels(Tile* tile) noexcept : tile_(tile) {
   }
   void SetValue(const Value& value, int y, int x) noexcept {
-    picture_[y][x] = value;
-  }
-  ~Picture() {
-    for (int i = 0; i < height_; ++i) {
-      delete[] picture_[i];
-    }
-    delete[] picture_;
+    std::size_t index = static_cast<std::size_t>(y - tile_->region.y_begin) * tile_->region.Width() +
+                        (x - tile_->region.x_begin);
+    tile_->values[index] = value.value;
+    tile_->hits[index] = value.intersect;
   }
 
  private:
-  int width_, height_;
-  Value** picture_;
+  Tile* tile_;
 };
 
 }  // namespace details
 
 namespace {
 
-template <typename T>
-[[nodiscard]] auto GetFigure(const T& obj) noexcept {
-  if constexpr (std::is_same_v<T, Object>) {
-    return obj.polygon;
-  } else if constexpr (std::is_same_v<T, SphereObject>) {
-    return obj.sphere;
-  } else {
-    static_assert(details::always_false_v<T>);
-  }
-}
-
-template <typename T>
-[[nodiscard]] bool CheckCover(const std::vector<T>& objects, const geom::Ray& ray, double distance) noexcept {
-  bool covered = false;
-  for (const auto& obj_to_compare : objects) {
-    auto intersection_to_compare = GetIntersection(ray, GetFigure(obj_to_compare));
-    if (intersection_to_compare) {
-      if (intersection_to_compare->GetDistance() < distance) {
-        covered = true;
-        break;
-      }
-    }
-  }
-  return covered;
-}
-
 template <typename T>
 [[nodiscard]] geom::Vector GetNormal(const T& obj, const geom::Intersection& intersection) noexcept {
   if constexpr (std::is_same_v<T, Object>) {
@@ -95,52 +70,44 @@ template <typename T>
   }
 }
 
-template <typename T>
-std::optional<T> FindClosest(const std::vector<T>& objects, const geom::Ray& ray, double& min_distance, bool& intersect,
-                             const RenderOptions& render_options, const Scene& scene, double* max_distance = nullptr) {
-  std::optional<T> closest;
-  for (const auto& obj : objects) {
-    auto intersection = GetIntersection(ray, GetFigure(obj));
-    if (intersection) {
-      if (!intersect) {
-        min_distance = intersection->GetDistance();
-        intersect = true;
-        closest = obj;
-      } else {
-        if (intersection->GetDistance() < min_distance) {
-          min_distance = intersection->GetDistance();
-          closest = obj;
-        }
-      }
-      if (render_options.mode == RenderMode::kDepth && intersection->GetDistance() > *max_distance) {
-        bool covered = CheckCover(scene.GetObjects(), ray, intersection->GetDistance());
-        if (!covered) {
-          covered = CheckCover(scene.GetSphereObjects(), ray, intersection->GetDistance());
-        }
-        if (!covered) {
-          *max_distance = intersection->GetDistance();
-        }
-      }
-    }
+// Nearest triangle and nearest sphere along a ray; the sphere is kept only if it is strictly closer.
+struct ClosestHit {
+  std::optional<ObjectHit> object;
+  std::optional<geom::SphereHit> sphere;
+
+  [[nodiscard]] bool Any() const noexcept {
+    return object || sphere;
   }
-  return closest;
+
+  [[nodiscard]] double Distance() const noexcept {
+    return sphere ? sphere->distance : object->distance;
+  }
+};
+
+// Render options with the levels of detail RenderTile() picked for the camera.
+struct TraceOptions : RenderOptions {
+  std::span<const std::uint8_t> lod_levels;
+};
+
+[[nodiscard]] ClosestHit FindClosest(const Scene& scene, const geom::Ray& ray,
+                                     std::span<const std::uint8_t> lod_levels) noexcept {
+  ClosestHit hit{scene.FindClosestObject(ray, lod_levels), scene.GetSphereBatch().FindNearest(ray)};
+  if (hit.object && hit.sphere && !(hit.sphere->distance < hit.object->distance)) {
+    hit.sphere.reset();
+  }
+  return hit;
 }
 
-template <typename T>
-[[nodiscard]] bool LightVisible(const std::vector<T>& objects, const geom::Vector& point, const Light& light) noexcept {
-  bool visible = true;
+[[nodiscard]] bool LightVisible(const Scene& scene, const geom::Vector& point, const Light& light,
+                                std::span<const std::uint8_t> lod_levels) noexcept {
   geom::Vector direction = light.position - point;
   geom::Ray ray{point, direction};
-  for (const auto& obj : objects) {
-    auto intersection = GetIntersection(ray, GetFigure(obj));
-    if (intersection.has_value()) {
-      if (intersection->GetDistance() < Length(direction)) {
-        visible = false;
-        break;
-      }
-    }
+  double distance = Length(direction);
+  if (scene.ObjectCovers(ray, distance, lod_levels)) {
+    return false;
   }
-  return visible;
+  auto sphere = scene.GetSphereBatch().FindNearest(ray);
+  return !(sphere && sphere->distance < distance);
 }
 
 [[nodiscard]] geom::Vector Ld(const geom::Vector& point, const Light& light, const geom::Vector& n) noexcept {
@@ -160,123 +127,211 @@ template <typename T>
   return light.intensity * pow(((DotProduct(v_e, v_r) > 0 ? DotProduct(v_e, v_r) : 0)), ns);
 }
 
-template <typename T>
-[[nodiscard]] geom::Vector ComputeFull(const Scene& scene, const geom::Ray& ray, const RenderOptions& render_options,
-                                       const T& object, bool inside = false);
+// Uniform in [0, 1) and a function of the ray alone, so that roulette decisions don't depend on the order pixels are
+// traced in or on how a frame is split into tiles.
+[[nodiscard]] double RayRandom(const geom::Ray& ray) noexcept {
+  std::uint64_t state = 0;
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (double value : {ray.GetOrigin()[i], ray.GetDirection()[i]}) {
+      state = (state ^ std::bit_cast<std::uint64_t>(value)) + 0x9e3779b97f4a7c15;
+      state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9;
+      state = (state ^ (state >> 27)) * 0x94d049bb133111eb;
+      state ^= state >> 31;
+    }
+  }
+  return static_cast<double>(state >> 11) * 0x1.0p-53;
+}
+
+// Factor a secondary ray with the given path weight is traced with: 1 above the cutoff, below it 0 or, with Russian
+// roulette, the inverse of the survival probability.
+[[nodiscard]] double PathSurvival(const RenderOptions& render_options, double weight, const geom::Ray& ray) noexcept {
+  if (weight >= render_options.min_path_weight) {
+    return 1;
+  }
+  if (!render_options.russian_roulette) {
+    return 0;
+  }
+  double survival = weight / render_options.min_path_weight;
+  return RayRandom(ray) < survival ? 1 / survival : 0;
+}
+
+// What a material can send rays on to, in increasing order of the machinery shading it needs. Shading kernels are
+// instantiated per class and handle materials up to their class, so a kernel for opaque materials has no
+// secondary-ray code at all.
+enum class MaterialClass { kOpaque, kReflective, kRefractive };
+
+[[nodiscard]] MaterialClass Classify(const Material& material) noexcept {
+  if (fabs(material.albedo[2]) > 1e-9) {
+    return MaterialClass::kRefractive;
+  }
+  return fabs(material.albedo[1]) > 1e-9 ? MaterialClass::kReflective : MaterialClass::kOpaque;
+}
+
+// The most general class a render has to handle: without depth no secondary ray is traced whatever the materials.
+[[nodiscard]] MaterialClass Classify(const Scene& scene, const RenderOptions& render_options) noexcept {
+  MaterialClass result = MaterialClass::kOpaque;
+  if (render_options.depth > 0) {
+    for (const auto& material : scene.GetMaterials()) {
+      result = std::max(result, Classify(material));
+    }
+  }
+  return result;
+}
+
+template <MaterialClass kClass, typename T>
+[[nodiscard]] geom::Vector ComputeFull(const Scene& scene, const geom::Ray& ray, const TraceOptions& render_options,
+                                       const T& object, const geom::Intersection& intersection, double weight = 1,
+                                       bool inside = false);
 
-[[nodiscard]] geom::Vector TraceNewRay(double coeff, const std::optional<Object>& closest_object,
-                                       const std::optional<SphereObject>& closest_sphere, const Scene& scene,
-                                       const geom::Ray& new_ray, const RenderOptions& render_options,
+template <MaterialClass kClass>
+[[nodiscard]] geom::Vector TraceNewRay(double coeff, double weight, const ClosestHit& hit, const Scene& scene,
+                                       const geom::Ray& new_ray, const TraceOptions& render_options,
                                        bool inside = false) {
-  if (closest_sphere) {
-    return coeff * ComputeFull(scene, new_ray, render_options, *closest_sphere, !inside);
+  if (hit.sphere) {
+    const SphereObject& sphere = scene.GetSphereObjects()[hit.sphere->index];
+    geom::Intersection intersection = MakeSphereIntersection(new_ray, sphere.sphere, hit.sphere->distance);
+    return coeff * ComputeFull<kClass>(scene, new_ray, render_options, sphere, intersection, weight, !inside);
   } else {
-    return coeff * ComputeFull(scene, new_ray, render_options, *closest_object);
+    return coeff * ComputeFull<kClass>(scene, new_ray, render_options, scene.GetWorldObject(*hit.object),
+                                       scene.GetWorldIntersection(*hit.object, new_ray), weight);
   }
 }
 
+template <MaterialClass kClass>
+void TraceSecondaryRays(const Scene& scene, const geom::Ray& ray, const TraceOptions& render_options,
+                        const Material& material, const geom::Vector& position, const geom::Vector& normal,
+                        double weight, bool inside, geom::Vector* intensivity);
+
+// Shading normal of a hit, turned to face the ray.
 template <typename T>
-[[nodiscard]] geom::Vector ComputeFull(const Scene& scene, const geom::Ray& ray, const RenderOptions& render_options,
-                                       const T& object, bool inside) {
-  geom::Vector intensivity = object.material->ambient_color + object.material->intensity;
-  auto figure = GetFigure(object);
-  geom::Intersection intersection = GetIntersection(ray, figure).value();
+[[nodiscard]] geom::Vector GetFacingNormal(const T& object, const geom::Intersection& intersection,
+                                           const geom::Ray& ray) noexcept {
   geom::Vector normal = GetNormal(object, intersection);
   if (DotProduct(normal, ray.GetDirection()) > 0) {
     normal = -normal;
   }
-  for (const auto& light : scene.GetLights()) {
-    geom::Vector point = intersection.GetPosition() + 1e-9 * normal;
-    if (LightVisible(scene.GetObjects(), point, light) && LightVisible(scene.GetSphereObjects(), point, light)) {
+  return normal;
+}
+
+// Shadow rays leave the surface a little towards the side the ray came from.
+[[nodiscard]] geom::Vector GetShadowOrigin(const geom::Vector& position, const geom::Vector& normal) noexcept {
+  return position + 1e-9 * normal;
+}
+
+// Light leaving a surface point towards the ray's origin. is_visible(index, light) tells whether the point sees a
+// light, so callers that already know can skip the shadow ray.
+template <MaterialClass kClass, typename IsVisible>
+[[nodiscard]] geom::Vector ShadeSurface(const Scene& scene, const geom::Ray& ray, const TraceOptions& render_options,
+                                        const Material& material, const geom::Vector& position,
+                                        const geom::Vector& normal, double weight, bool inside,
+                                        IsVisible&& is_visible) {
+  geom::Vector intensivity = material.ambient_color + material.intensity;
+  const auto& lights = scene.GetLights();
+  for (std::size_t i = 0; i < lights.size(); ++i) {
+    const Light& light = lights[i];
+    if (is_visible(i, light)) {
+      intensivity += material.diffuse_color * Ld(position, light, normal) * material.albedo[0];
       intensivity +=
-        object.material->diffuse_color * Ld(intersection.GetPosition(), light, normal) * object.material->albedo[0];
-      intensivity += object.material->specular_color *
-                     Ls(ray, intersection.GetPosition(), light, normal, object.material->specular_exponent) *
-                     object.material->albedo[0];
+        material.specular_color * Ls(ray, position, light, normal, material.specular_exponent) * material.albedo[0];
     }
   }
-  if (fabs(object.material->albedo[1]) > 1e-9) {  // reflect
+  if constexpr (kClass != MaterialClass::kOpaque) {
+    TraceSecondaryRays<kClass>(scene, ray, render_options, material, position, normal, weight, inside, &intensivity);
+  }
+  return intensivity;
+}
+
+template <MaterialClass kClass, typename T>
+[[nodiscard]] geom::Vector ComputeFull(const Scene& scene, const geom::Ray& ray, const TraceOptions& render_options,
+                                       const T& object, const geom::Intersection& intersection, double weight,
+                                       bool inside) {
+  geom::Vector normal = GetFacingNormal(object, intersection, ray);
+  geom::Vector shadow_origin = GetShadowOrigin(intersection.GetPosition(), normal);
+  return ShadeSurface<kClass>(scene, ray, render_options, scene.GetMaterials()[object.material],
+                              intersection.GetPosition(), normal, weight, inside,
+                              [&](std::size_t, const Light& light) {
+                                return LightVisible(scene, shadow_origin, light, render_options.lod_levels);
+                              });
+}
+
+// Adds reflected and refracted light at a shading point; refraction only exists in the kernel for refractive
+// materials.
+template <MaterialClass kClass>
+void TraceSecondaryRays(const Scene& scene, const geom::Ray& ray, const TraceOptions& render_options,
+                        const Material& material, const geom::Vector& position, const geom::Vector& normal,
+                        double weight, bool inside, geom::Vector* intensivity) {
+  TraceOptions secondary_options = render_options;
+  secondary_options.depth = render_options.depth - 1;
+  secondary_options.mode = RenderMode::kFull;
+  if (fabs(material.albedo[1]) > 1e-9) {  // reflect
     if (render_options.depth > 0 && !inside) {
-      geom::Vector point = intersection.GetPosition() + 1e-9 * normal;
+      geom::Vector point = position + 1e-9 * normal;
       geom::Vector reflect_direction = Reflect(ray.GetDirection(), normal);
       reflect_direction.Normalize();
       geom::Ray reflect_ray{point, reflect_direction};
-      double min_distance;
-      bool intersect = false;
-      std::optional<Object> closest_object =
-        FindClosest(scene.GetObjects(), reflect_ray, min_distance, intersect, render_options, scene);
-      std::optional<SphereObject> closest_sphere =
-        FindClosest(scene.GetSphereObjects(), reflect_ray, min_distance, intersect, render_options, scene);
-
-      if (intersect) {
-        intensivity += TraceNewRay(object.material->albedo[1], closest_object, closest_sphere, scene, reflect_ray,
-                                   {render_options.depth - 1, RenderMode::kFull});
+      double reflect_weight = weight * fabs(material.albedo[1]);
+      double survival = PathSurvival(render_options, reflect_weight, reflect_ray);
+      ClosestHit hit = survival > 0 ? FindClosest(scene, reflect_ray, render_options.lod_levels) : ClosestHit{};
+      if (hit.Any()) {
+        *intensivity += survival * TraceNewRay<kClass>(material.albedo[1], reflect_weight * survival, hit, scene,
+                                                       reflect_ray, secondary_options);
       }
     }
   }
-  if (fabs(object.material->albedo[2]) > 1e-9 && render_options.depth > 0) {  // refract
-    double refraction_index = !inside ? 1 / object.material->refraction_index : object.material->refraction_index;
+  bool refracts = kClass == MaterialClass::kRefractive && fabs(material.albedo[2]) > 1e-9;
+  if (refracts && render_options.depth > 0) {  // refract
+    double refraction_index = !inside ? 1 / material.refraction_index : material.refraction_index;
     std::optional<geom::Vector> refract_direction = Refract(ray.GetDirection(), normal, refraction_index);
     if (refract_direction.has_value()) {
-      geom::Vector point = intersection.GetPosition() - 1e-9 * normal;
+      geom::Vector point = position - 1e-9 * normal;
       refract_direction.value().Normalize();
       geom::Ray refract_ray{point, refract_direction.value()};
-      double min_distance;
-      bool intersect = false;
-      std::optional<Object> closest_object =
-        FindClosest(scene.GetObjects(), refract_ray, min_distance, intersect, render_options, scene);
-      std::optional<SphereObject> closest_sphere =
-        FindClosest(scene.GetSphereObjects(), refract_ray, min_distance, intersect, render_options, scene);
-
-      if (intersect) {
-        double coeff = !inside ? object.material->albedo[2] : 1;
-        intensivity += TraceNewRay(coeff, closest_object, closest_sphere, scene, refract_ray,
-                                   {render_options.depth - 1, RenderMode::kFull}, inside);
+      double coeff = !inside ? material.albedo[2] : 1;
+      double refract_weight = weight * fabs(coeff);
+      double survival = PathSurvival(render_options, refract_weight, refract_ray);
+      ClosestHit hit = survival > 0 ? FindClosest(scene, refract_ray, render_options.lod_levels) : ClosestHit{};
+      if (hit.Any()) {
+        *intensivity += survival * TraceNewRay<kClass>(coeff, refract_weight * survival, hit, scene, refract_ray,
+                                                       secondary_options, inside);
       }
     }
   }
-  return intensivity;
 }
 
-[[nodiscard]] details::Value GetPixelValue(const Scene& scene, const geom::Ray& ray,
-                                           const RenderOptions& render_options, double* max_distance, double* max_rgb) {
-  double min_distance;
-  bool intersect = false;
-  std::optional<Object> closest_object =
-    FindClosest(scene.GetObjects(), ray, min_distance, intersect, render_options, scene, max_distance);
-  std::optional<SphereObject> closest_sphere =
-    FindClosest(scene.GetSphereObjects(), ray, min_distance, intersect, render_options, scene, max_distance);
-
-  if (intersect) {
-    if (render_options.mode == RenderMode::kFull) {
-      geom::Vector intensivity;
-      if (closest_sphere) {
-        intensivity = ComputeFull(scene, ray, render_options, *closest_sphere);
-      } else {
-        intensivity = ComputeFull(scene, ray, render_options, *closest_object);
-      }
-      double to_compare = std::max({intensivity[0], intensivity[1], intensivity[2]});
-      *max_rgb = *max_rgb > to_compare ? *max_rgb : to_compare;
-      return {intensivity, true};
-
-    } else if (render_options.mode == RenderMode::kDepth) {
-      double distance;
-      if (closest_sphere) {
-        distance = GetIntersection(ray, closest_sphere->sphere)->GetDistance();
-      } else {
-        distance = GetIntersection(ray, closest_object->polygon)->GetDistance();
-      }
-
-      return details::Value{geom::Vector{distance, distance, distance}, true};
+template <RenderMode kMode, MaterialClass kClass>
+[[nodiscard]] details::Value ShadeHit(const Scene& scene, const geom::Ray& ray, const ClosestHit& hit,
+                                      const TraceOptions& render_options, double* max_distance, double* max_rgb) {
+  if (!hit.Any()) {
+    if constexpr (kMode == RenderMode::kDepth) {
+      return details::Value{geom::Vector{1, 1, 1}, false};
     }
+    return details::Value{geom::Vector{0, 0, 0}, false};
+  }
+  if constexpr (kMode == RenderMode::kFull) {
+    geom::Vector intensivity;
+    if (hit.sphere) {
+      const SphereObject& sphere = scene.GetSphereObjects()[hit.sphere->index];
+      geom::Intersection intersection = MakeSphereIntersection(ray, sphere.sphere, hit.sphere->distance);
+      intensivity = ComputeFull<kClass>(scene, ray, render_options, sphere, intersection);
+    } else {
+      intensivity = ComputeFull<kClass>(scene, ray, render_options, scene.GetWorldObject(*hit.object),
+                                        scene.GetWorldIntersection(*hit.object, ray));
+    }
+    double to_compare = std::max({intensivity[0], intensivity[1], intensivity[2]});
+    *max_rgb = *max_rgb > to_compare ? *max_rgb : to_compare;
+    return {intensivity, true};
+  } else if constexpr (kMode == RenderMode::kDepth) {
+    // The nearest hit is the only one not covered by another primitive, so it alone can raise the maximum.
+    double distance = hit.Distance();
+    *max_distance = *max_distance > distance ? *max_distance : distance;
+    return details::Value{geom::Vector{distance, distance, distance}, true};
+  } else {
     geom::Vector normal;
-    auto sphere_intersection = GetIntersection(ray, closest_sphere->sphere);
-    auto object_intersection = GetIntersection(ray, closest_object->polygon);
-
-    if (closest_sphere) {
-      normal = GetNormal(*closest_sphere, *sphere_intersection);
+    if (hit.sphere) {
+      const SphereObject& sphere = scene.GetSphereObjects()[hit.sphere->index];
+      normal = GetNormal(sphere, MakeSphereIntersection(ray, sphere.sphere, hit.sphere->distance));
     } else {
-      normal = GetNormal(*closest_object, *object_intersection);
+      normal = GetNormal(scene.GetWorldObject(*hit.object), scene.GetWorldIntersection(*hit.object, ray));
     }
     if (DotProduct(normal, ray.GetDirection()) > 0) {
       normal = -normal;
@@ -284,49 +339,318 @@ template <typename T>
     auto res = (1.0 / 2) * normal + geom::Vector{1.0 / 2, 1.0 / 2, 1.0 / 2};
     return details::Value{res, true};
   }
+}
+
+[[nodiscard]] MaterialId GetMaterialId(const Scene& scene, const ClosestHit& hit) noexcept {
+  if (hit.sphere) {
+    return scene.GetSphereObjects()[hit.sphere->index].material;
+  }
+  return scene.GetObjects().GetMaterial(hit.object->object);
+}
 
-  if (render_options.mode == RenderMode::kDepth) {
-    return details::Value{geom::Vector{1, 1, 1}, false};
+struct PendingHit {
+  MaterialId material;
+  const PixelRay* pixel;
+  ClosestHit hit;
+};
+
+// Traces the primary rays of a packet first and shades the hits grouped by material, so consecutive ComputeFull
+// calls read the same material, and each group goes through the kernel for its material's class. Every pixel gets the
+// value tracing pixels one by one would give.
+template <MaterialClass kClass>
+void ShadeByMaterial(const Scene& scene, const TraceOptions& render_options, const std::vector<PixelRay>& packet,
+                     details::TilePixels* picture, double* max_distance, double* max_rgb,
+                     std::vector<PendingHit>* pending) {
+  pending->clear();
+  {
+    util::PhaseScope phase(util::Phase::kPrimaryTracing);
+    for (const PixelRay& pixel : packet) {
+      ClosestHit hit = FindClosest(scene, pixel.ray, render_options.lod_levels);
+      if (hit.Any()) {
+        pending->push_back({GetMaterialId(scene, hit), &pixel, hit});
+      } else {
+        picture->SetValue(
+          ShadeHit<RenderMode::kFull, kClass>(scene, pixel.ray, hit, render_options, max_distance, max_rgb), pixel.y,
+          pixel.x);
+      }
+    }
+  }
+  util::PhaseScope phase(util::Phase::kShading);
+  std::stable_sort(pending->begin(), pending->end(), [](const PendingHit& lhs, const PendingHit& rhs) {
+    return lhs.material < rhs.material;
+  });
+  auto shade = [&]<MaterialClass kGroupClass>(auto begin, auto end) {
+    for (auto it = begin; it != end; ++it) {
+      picture->SetValue(ShadeHit<RenderMode::kFull, kGroupClass>(scene, it->pixel->ray, it->hit, render_options,
+                                                                 max_distance, max_rgb),
+                        it->pixel->y, it->pixel->x);
+    }
+  };
+  for (auto begin = pending->begin(); begin != pending->end();) {
+    auto end = std::find_if(begin, pending->end(), [&](const PendingHit& pending_hit) {
+      return pending_hit.material != begin->material;
+    });
+    MaterialClass group_class = std::min(kClass, Classify(scene.GetMaterials()[begin->material]));
+    if (group_class == MaterialClass::kOpaque) {
+      shade.template operator()<MaterialClass::kOpaque>(begin, end);
+    } else {
+      shade.template operator()<kClass>(begin, end);
+    }
+    begin = end;
+  }
+}
+
+// Traces a region with the kernel for one mode and material class, so the pixel loops carry no mode checks. Pixels
+// go in packets of kBlockSize x kBlockSize blocks, each in Morton order.
+template <RenderMode kMode, MaterialClass kClass>
+void TraceRegion(const Scene& scene, const TraceOptions& render_options, const CameraRays& camera, Tile* tile) {
+  constexpr int kBlockSize = 16;
+  const Region& region = tile->region;
+  details::TilePixels picture(tile);
+  std::vector<PixelRay> packet;
+  packet.reserve(kBlockSize * kBlockSize);
+  std::vector<PendingHit> pending;
+  std::vector<ClosestHit> hits;
+  if (kMode == RenderMode::kFull && render_options.sort_by_material) {
+    pending.reserve(kBlockSize * kBlockSize);
+  } else {
+    hits.reserve(kBlockSize * kBlockSize);
+  }
+  for (int y = region.y_begin; y < region.y_end; y += kBlockSize) {
+    scene.TrimGeometry();
+    for (int x = region.x_begin; x < region.x_end; x += kBlockSize) {
+      camera.Fill({x, y, std::min(x + kBlockSize, region.x_end), std::min(y + kBlockSize, region.y_end)}, &packet);
+      if constexpr (kMode == RenderMode::kFull) {
+        if (render_options.sort_by_material) {
+          ShadeByMaterial<kClass>(scene, render_options, packet, &picture, &tile->max_distance, &tile->max_rgb,
+                                  &pending);
+          continue;
+        }
+      }
+      // All primary rays of the packet first, so a profile tells their cost from that of shading.
+      hits.clear();
+      {
+        util::PhaseScope phase(util::Phase::kPrimaryTracing);
+        for (const PixelRay& pixel : packet) {
+          hits.push_back(FindClosest(scene, pixel.ray, render_options.lod_levels));
+        }
+      }
+      util::PhaseScope phase(util::Phase::kShading);
+      for (std::size_t i = 0; i < packet.size(); ++i) {
+        const PixelRay& pixel = packet[i];
+        picture.SetValue(
+          ShadeHit<kMode, kClass>(scene, pixel.ray, hits[i], render_options, &tile->max_distance, &tile->max_rgb),
+          pixel.y, pixel.x);
+      }
+    }
+  }
+}
+
+// Shades the cached primary hits of a relighting session with the kernel for one material class; visible[light][hit]
+// says whether the hit-th hit pixel sees the light.
+template <MaterialClass kClass>
+void ShadeSamples(const Scene& scene, const TraceOptions& render_options, const CameraRays& camera,
+                  const std::vector<SurfaceSample>& samples, const std::vector<std::size_t>& hit_pixels,
+                  const std::vector<std::vector<std::uint8_t>>& visible, Tile* tile) {
+  auto width = static_cast<std::size_t>(tile->frame_width);
+  for (std::size_t hit = 0; hit < hit_pixels.size(); ++hit) {
+    std::size_t pixel = hit_pixels[hit];
+    const SurfaceSample& sample = samples[pixel];
+    geom::Ray ray = camera.Get(static_cast<int>(pixel % width), static_cast<int>(pixel / width));
+    geom::Vector intensivity =
+      ShadeSurface<kClass>(scene, ray, render_options, scene.GetMaterials()[sample.material], sample.position,
+                           sample.normal, 1, false, [&](std::size_t light, const Light&) {
+                             return visible[light][hit] != 0;
+                           });
+    double to_compare = std::max({intensivity[0], intensivity[1], intensivity[2]});
+    tile->max_rgb = tile->max_rgb > to_compare ? tile->max_rgb : to_compare;
+    tile->values[pixel] = intensivity;
+    tile->hits[pixel] = 1;
   }
-  return details::Value{geom::Vector{0, 0, 0}, false};
 }
 
 }  // namespace
 
 [[nodiscard]] image::Image Render(const std::string& filename, const CameraOptions& camera_options,
                                   const RenderOptions& render_options) {
-  Scene scene = ReadScene(filename);
-  image::Image image(camera_options.screen_width, camera_options.screen_height);
-  details::Picture picture(camera_options.screen_width, camera_options.screen_height);
-  double image_aspect_ratio = static_cast<double>(camera_options.screen_width) / camera_options.screen_height;
-  double scale = tan(camera_options.fov / 2);
-  Matrix camera_to_world = MakeCameraToWorld(camera_options.look_from, camera_options.look_to);
-  geom::Vector origin = camera_to_world.multiply_vector({0, 0, 0});
-  double max_distance = 0;
+  return Render(ReadScene(filename), camera_options, render_options);
+}
+
+[[nodiscard]] image::Image Render(const Scene& scene, const CameraOptions& camera_options,
+                                  const RenderOptions& render_options) {
+  Region frame{0, 0, camera_options.screen_width, camera_options.screen_height};
+  return MergeTiles({RenderTile(scene, camera_options, render_options, frame)});
+}
+
+[[nodiscard]] Tile RenderTile(const Scene& scene, const CameraOptions& camera_options,
+                              const RenderOptions& render_options, const Region& region) {
+  if (region.Width() <= 0 || region.Height() <= 0 || region.x_begin < 0 || region.y_begin < 0 ||
+      region.x_end > camera_options.screen_width || region.y_end > camera_options.screen_height) {
+    throw std::runtime_error("region is empty or outside the frame");
+  }
+  RT_TRACE_SPAN("tile", std::to_string(region.x_begin) + "," + std::to_string(region.y_begin) + " " +
+                          std::to_string(region.Width()) + "x" + std::to_string(region.Height()));
+  Tile tile;
+  tile.frame_width = camera_options.screen_width;
+  tile.frame_height = camera_options.screen_height;
+  tile.mode = render_options.mode;
+  tile.region = region;
+  tile.values.resize(static_cast<std::size_t>(region.Width()) * region.Height());
+  tile.hits.resize(tile.values.size());
+  CameraRays camera(camera_options);
+  std::vector<std::uint8_t> lod_levels =
+    scene.SelectLods(camera.GetOrigin(), render_options.lod_pixel_error * camera.GetPixelAngle());
+  TraceOptions trace_options{render_options, lod_levels};
+  // Kernels are picked once per tile; depth and normal renders shade no materials.
+  switch (render_options.mode) {
+    case RenderMode::kDepth:
+      TraceRegion<RenderMode::kDepth, MaterialClass::kOpaque>(scene, trace_options, camera, &tile);
+      break;
+    case RenderMode::kNormal:
+      TraceRegion<RenderMode::kNormal, MaterialClass::kOpaque>(scene, trace_options, camera, &tile);
+      break;
+    case RenderMode::kFull:
+      switch (Classify(scene, render_options)) {
+        case MaterialClass::kOpaque:
+          TraceRegion<RenderMode::kFull, MaterialClass::kOpaque>(scene, trace_options, camera, &tile);
+          break;
+        case MaterialClass::kReflective:
+          TraceRegion<RenderMode::kFull, MaterialClass::kReflective>(scene, trace_options, camera, &tile);
+          break;
+        case MaterialClass::kRefractive:
+          TraceRegion<RenderMode::kFull, MaterialClass::kRefractive>(scene, trace_options, camera, &tile);
+          break;
+      }
+      break;
+  }
+  return tile;
+}
+
+[[nodiscard]] image::Image MergeTiles(const std::vector<Tile>& tiles) {
+  if (tiles.empty()) {
+    throw std::runtime_error("no tiles to merge");
+  }
+  const Tile& first = tiles.front();
   double max_rgb = 0;
-  for (int y = 0; y < camera_options.screen_height; ++y) {
-    for (int x = 0; x < camera_options.screen_width; ++x) {
-      double px = (2 * ((x + 0.5) / camera_options.screen_width) - 1) * scale * image_aspect_ratio;
-      double py = (1 - 2 * (y + 0.5) / camera_options.screen_height) * scale;
-      geom::Vector P = camera_to_world.multiply_vector({px, py, -1});
-      geom::Ray ray(camera_options.look_from, P - origin);
-      picture.SetValue(GetPixelValue(scene, ray, render_options, &max_distance, &max_rgb), y, x);
+  double max_distance = 0;
+  std::vector<std::uint8_t> covered(static_cast<std::size_t>(first.frame_width) * first.frame_height, 0);
+  for (const Tile& tile : tiles) {
+    const Region& region = tile.region;
+    if (tile.frame_width != first.frame_width || tile.frame_height != first.frame_height || tile.mode != first.mode) {
+      throw std::runtime_error("tiles belong to different frames");
     }
+    if (region.Width() <= 0 || region.Height() <= 0 || region.x_begin < 0 || region.y_begin < 0 ||
+        region.x_end > tile.frame_width || region.y_end > tile.frame_height ||
+        tile.values.size() != static_cast<std::size_t>(region.Width()) * region.Height() ||
+        tile.hits.size() != tile.values.size()) {
+      throw std::runtime_error("malformed tile");
+    }
+    for (int y = region.y_begin; y < region.y_end; ++y) {
+      for (int x = region.x_begin; x < region.x_end; ++x) {
+        if (covered[static_cast<std::size_t>(y) * first.frame_width + x]++) {
+          throw std::runtime_error("tiles overlap");
+        }
+      }
+    }
+    max_rgb = std::max(max_rgb, tile.max_rgb);
+    max_distance = std::max(max_distance, tile.max_distance);
   }
+  if (std::find(covered.begin(), covered.end(), 0) != covered.end()) {
+    throw std::runtime_error("tiles leave pixels uncovered");
+  }
+
+  util::PhaseScope phase(util::Phase::kTonemapping);
+  RT_TRACE_SPAN("tonemap");
+  image::Image image(first.frame_width, first.frame_height);
+  for (const Tile& tile : tiles) {
+    TonemapTile(tile, {max_rgb, max_distance}, &image);
+  }
+  return image;
+}
+
+RelightSession::RelightSession(const Scene& scene, const CameraOptions& camera_options,
+                               const RenderOptions& render_options)
+  : scene_(scene), camera_options_(camera_options), render_options_(render_options) {
+  if (render_options.mode != RenderMode::kFull) {
+    throw std::runtime_error("relighting needs RenderMode::kFull");
+  }
+  CameraRays camera(camera_options);
+  lod_levels_ = scene.SelectLods(camera.GetOrigin(), render_options.lod_pixel_error * camera.GetPixelAngle());
+  util::PhaseScope phase(util::Phase::kPrimaryTracing);
+  samples_.resize(static_cast<std::size_t>(camera_options.screen_width) * camera_options.screen_height);
   for (int y = 0; y < camera_options.screen_height; ++y) {
     for (int x = 0; x < camera_options.screen_width; ++x) {
-      geom::Vector intense = picture.GetValue(y, x).value;
-      if (render_options.mode == RenderMode::kFull && picture.GetValue(y, x).intersect) {
-        auto out = intense * (geom::Vector{1, 1, 1} + intense / pow(max_rgb, 2)) / (geom::Vector{1, 1, 1} + intense);
-        intense = {pow(out[0], 1 / 2.2), pow(out[1], 1 / 2.2), pow(out[2], 1 / 2.2)};
-      } else if (render_options.mode == RenderMode::kDepth && picture.GetValue(y, x).intersect) {
-        intense /= max_distance;
+      geom::Ray ray = camera.Get(x, y);
+      ClosestHit hit = FindClosest(scene, ray, lod_levels_);
+      if (!hit.Any()) {
+        continue;
       }
-      image::RGB value = {static_cast<int>(intense[0] * 255), static_cast<int>(intense[1] * 255),
-                          static_cast<int>(intense[2] * 255)};
-      image.SetPixel(value, y, x);
+      std::size_t pixel = static_cast<std::size_t>(y) * camera_options.screen_width + x;
+      SurfaceSample& sample = samples_[pixel];
+      if (hit.sphere) {
+        const SphereObject& sphere = scene.GetSphereObjects()[hit.sphere->index];
+        geom::Intersection intersection = MakeSphereIntersection(ray, sphere.sphere, hit.sphere->distance);
+        sample = {intersection.GetPosition(), GetFacingNormal(sphere, intersection, ray), sphere.material, true};
+      } else {
+        Object object = scene.GetWorldObject(*hit.object);
+        geom::Intersection intersection = scene.GetWorldIntersection(*hit.object, ray);
+        sample = {intersection.GetPosition(), GetFacingNormal(object, intersection, ray), object.material, true};
+      }
+      hit_pixels_.push_back(pixel);
     }
   }
-  return image;
 }
+
+void RelightSession::UpdateVisibility() {
+  const auto& lights = scene_.GetLights();
+  traced_positions_.resize(lights.size());
+  visible_.resize(lights.size());
+  for (std::size_t i = 0; i < lights.size(); ++i) {
+    const geom::Vector& position = lights[i].position;
+    const auto& traced = traced_positions_[i];
+    if (traced && (*traced)[0] == position[0] && (*traced)[1] == position[1] && (*traced)[2] == position[2]) {
+      ++stats_.lights_reused;
+      continue;
+    }
+    visible_[i].resize(hit_pixels_.size());
+    for (std::size_t hit = 0; hit < hit_pixels_.size(); ++hit) {
+      const SurfaceSample& sample = samples_[hit_pixels_[hit]];
+      visible_[i][hit] =
+        LightVisible(scene_, GetShadowOrigin(sample.position, sample.normal), lights[i], lod_levels_) ? 1 : 0;
+    }
+    stats_.shadow_rays += hit_pixels_.size();
+    traced_positions_[i] = position;
+  }
+}
+
+image::Image RelightSession::Render() {
+  Tile tile;
+  tile.frame_width = camera_options_.screen_width;
+  tile.frame_height = camera_options_.screen_height;
+  tile.mode = RenderMode::kFull;
+  tile.region = {0, 0, camera_options_.screen_width, camera_options_.screen_height};
+  tile.values.resize(samples_.size());
+  tile.hits.resize(samples_.size());
+  CameraRays camera(camera_options_);
+  TraceOptions trace_options{render_options_, lod_levels_};
+  // Tonemapping in MergeTiles() counts as a phase of its own.
+  util::PhaseScope phase(util::Phase::kShading);
+  RT_TRACE_SPAN("relight");
+  UpdateVisibility();
+  // Materials may have changed class since the last frame.
+  switch (Classify(scene_, render_options_)) {
+    case MaterialClass::kOpaque:
+      ShadeSamples<MaterialClass::kOpaque>(scene_, trace_options, camera, samples_, hit_pixels_, visible_, &tile);
+      break;
+    case MaterialClass::kReflective:
+      ShadeSamples<MaterialClass::kReflective>(scene_, trace_options, camera, samples_, hit_pixels_, visible_, &tile);
+      break;
+    case MaterialClass::kRefractive:
+      ShadeSamples<MaterialClass::kRefractive>(scene_, trace_options, camera, samples_, hit_pixels_, visible_, &tile);
+      break;
+  }
+  ++stats_.renders;
+  return MergeTiles({tile});
+}
+
 }  // namespace rt
@@ -3,6 +3,7 @@
 #include <raytracer/camera_options.hpp>
 #include <raytracer/image.hpp>
 #include <raytracer/render_options.hpp>
+#include <scene/scene.hpp>
 
 #include <string>
 
@@ -11,4 +12,7 @@ namespace rt {
 image::Image Render(const std::string& filename, const CameraOptions& camera_options,
                     const RenderOptions& render_options);
 
+// Renders a scene that is already loaded, e.g. one changed in place with the Scene setters between frames.
+image::Image Render(const Scene& scene, const CameraOptions& camera_options, const RenderOptions& render_options);
+
 }  // namespace rt
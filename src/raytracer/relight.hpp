@@ -0,0 +1,64 @@
+#pragma once
+
+#include <geometry/vector.hpp>
+#include <raytracer/camera_options.hpp>
+#include <raytracer/image.hpp>
+#include <raytracer/render_options.hpp>
+#include <scene/material.hpp>
+#include <scene/scene.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace rt {
+
+// What the primary ray of a pixel hit, as far as shading it needs.
+struct SurfaceSample {
+  geom::Vector position;
+  geom::Vector normal;  // shading normal, turned to face the ray
+  MaterialId material = 0;
+  bool hit = false;
+};
+
+struct RelightStats {
+  std::size_t renders = 0;
+  std::size_t shadow_rays = 0;     // traced from cached hits towards lights
+  std::size_t lights_reused = 0;   // lights whose shadow rays a render did not have to trace again
+};
+
+// Renders of one camera over a scene whose lights and materials change between frames, e.g. through
+// Scene::SetLight() and Scene::SetMaterial(). The primary hits are traced once, when the session starts, and kept
+// per pixel; every Render() only shades them again. Which cached hits see a light is kept too and traced again only
+// for lights that moved, so a light that only changed colour or brightness costs no rays. Reflected and refracted
+// light depends on everything and is traced in full.
+//
+// Each Render() gives exactly the image rt::Render() would for the scene as it is then. Geometry, spheres and
+// instances must not change during the session, and the scene must outlive it. Only RenderMode::kFull is supported.
+class RelightSession {
+ public:
+  RelightSession(const Scene& scene, const CameraOptions& camera_options, const RenderOptions& render_options);
+
+  [[nodiscard]] image::Image Render();
+
+  [[nodiscard]] const RelightStats& GetStats() const noexcept {
+    return stats_;
+  }
+
+ private:
+  void UpdateVisibility();
+
+  const Scene& scene_;
+  CameraOptions camera_options_;
+  RenderOptions render_options_;
+  std::vector<std::uint8_t> lod_levels_;
+  std::vector<SurfaceSample> samples_;  // row-major
+  std::vector<std::size_t> hit_pixels_;
+  // Per light, the position its shadow rays were traced towards and whether each hit pixel sees it.
+  std::vector<std::optional<geom::Vector>> traced_positions_;
+  std::vector<std::vector<std::uint8_t>> visible_;
+  RelightStats stats_;
+};
+
+}  // namespace rt
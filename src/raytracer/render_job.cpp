@@ -0,0 +1,133 @@
+#include <raytracer/render_job.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace rt {
+
+namespace {
+
+template <typename T>
+[[nodiscard]] T ParseNumber(std::string_view key, std::string_view value) {
+  T result{};
+  auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+  if (error != std::errc{} || end != value.data() + value.size()) {
+    throw std::runtime_error("bad value for " + std::string(key) + ": " + std::string(value));
+  }
+  return result;
+}
+
+[[nodiscard]] std::array<double, 3> ParsePoint(std::string_view key, std::string_view value) {
+  std::array<double, 3> point{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    std::size_t comma = i < 2 ? value.find(',') : value.size();
+    if (comma == std::string_view::npos) {
+      throw std::runtime_error("bad value for " + std::string(key) + ": " + std::string(value));
+    }
+    point[i] = ParseNumber<double>(key, value.substr(0, comma));
+    value.remove_prefix(std::min(comma + 1, value.size()));
+  }
+  return point;
+}
+
+[[nodiscard]] RenderMode ParseMode(std::string_view value) {
+  if (value == "full") {
+    return RenderMode::kFull;
+  }
+  if (value == "depth") {
+    return RenderMode::kDepth;
+  }
+  if (value == "normal") {
+    return RenderMode::kNormal;
+  }
+  throw std::runtime_error("unknown mode " + std::string(value));
+}
+
+[[nodiscard]] const char* FormatMode(RenderMode mode) noexcept {
+  switch (mode) {
+    case RenderMode::kDepth:
+      return "depth";
+    case RenderMode::kNormal:
+      return "normal";
+    case RenderMode::kFull:
+      break;
+  }
+  return "full";
+}
+
+}  // namespace
+
+RenderJob ParseRenderJob(std::string_view line) {
+  std::istringstream words{std::string(line)};
+  std::string word;
+  RenderJob job;
+  while (words >> word) {
+    std::size_t equals = word.find('=');
+    if (equals == std::string::npos) {
+      throw std::runtime_error("expected key=value, got " + word);
+    }
+    std::string_view key = std::string_view(word).substr(0, equals);
+    std::string_view value = std::string_view(word).substr(equals + 1);
+    if (key == "scene") {
+      job.scene = value;
+    } else if (key == "output") {
+      job.output = value;
+    } else if (key == "width") {
+      job.camera.screen_width = ParseNumber<int>(key, value);
+    } else if (key == "height") {
+      job.camera.screen_height = ParseNumber<int>(key, value);
+    } else if (key == "fov") {
+      job.camera.fov = ParseNumber<double>(key, value);
+    } else if (key == "from") {
+      job.camera.look_from = ParsePoint(key, value);
+    } else if (key == "to") {
+      job.camera.look_to = ParsePoint(key, value);
+    } else if (key == "depth") {
+      job.render.depth = ParseNumber<int>(key, value);
+    } else if (key == "mode") {
+      job.render.mode = ParseMode(value);
+    } else if (key == "sort") {
+      job.render.sort_by_material = ParseNumber<int>(key, value) != 0;
+    } else if (key == "min_weight") {
+      job.render.min_path_weight = ParseNumber<double>(key, value);
+    } else if (key == "roulette") {
+      job.render.russian_roulette = ParseNumber<int>(key, value) != 0;
+    } else if (key == "lod_error") {
+      job.render.lod_pixel_error = ParseNumber<double>(key, value);
+    } else if (key == "time_limit") {
+      job.time_limit = ParseNumber<double>(key, value);
+    } else {
+      throw std::runtime_error("unknown key " + std::string(key));
+    }
+  }
+  if (job.scene.empty() || job.output.empty()) {
+    throw std::runtime_error("render job needs scene and output");
+  }
+  if (job.camera.screen_width <= 0 || job.camera.screen_height <= 0) {
+    throw std::runtime_error("render job needs a positive resolution");
+  }
+  return job;
+}
+
+std::string FormatRenderJob(const RenderJob& job) {
+  std::ostringstream line;
+  line << std::setprecision(std::numeric_limits<double>::max_digits10);
+  line << "scene=" << job.scene << " output=" << job.output << " width=" << job.camera.screen_width
+       << " height=" << job.camera.screen_height << " fov=" << job.camera.fov;
+  for (auto [key, point] : {std::pair{"from", job.camera.look_from}, std::pair{"to", job.camera.look_to}}) {
+    line << ' ' << key << '=' << point[0] << ',' << point[1] << ',' << point[2];
+  }
+  line << " depth=" << job.render.depth << " mode=" << FormatMode(job.render.mode)
+       << " sort=" << job.render.sort_by_material << " min_weight=" << job.render.min_path_weight
+       << " roulette=" << job.render.russian_roulette << " lod_error=" << job.render.lod_pixel_error
+       << " time_limit=" << job.time_limit;
+  return line.str();
+}
+
+}  // namespace rt
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <raytracer/camera_options.hpp>
+#include <raytracer/render_options.hpp>
+
+#include <string>
+#include <string_view>
+
+namespace rt {
+
+struct RenderJob {
+  std::string scene;
+  std::string output;
+  CameraOptions camera{640, 480};
+  RenderOptions render{1};
+  // Seconds the job may take, from when a server accepts it or a batch starts it; past them the rest of the frame is
+  // finished at a lower quality, see RenderWithDeadline(). 0 renders in full however long it takes.
+  double time_limit = 0;
+};
+
+// A job is written as one line of space-separated key=value pairs, as in batch manifests and server requests:
+//   scene=PATH output=PATH width=W height=H fov=RADIANS from=X,Y,Z to=X,Y,Z depth=D mode=full|depth|normal sort=0|1
+//   min_weight=W roulette=0|1 lod_error=PIXELS time_limit=SECONDS
+// scene and output are required, the rest default as in RenderJob. Paths cannot contain spaces. Unknown keys and
+// malformed values throw std::runtime_error.
+[[nodiscard]] RenderJob ParseRenderJob(std::string_view line);
+[[nodiscard]] std::string FormatRenderJob(const RenderJob& job);
+
+}  // namespace rt
@@ -5,4 +5,16 @@ enum class RenderMode { kDepth, kNormal, kFull };
 struct RenderOptions {
   int depth;
   RenderMode mode = RenderMode::kFull;
+  // In kFull mode, trace the primary rays of each tile first and shade the hits grouped by material.
+  bool sort_by_material = false;
+  // In kFull mode, reflected and refracted rays whose path weight (the product of the albedos along the path) is
+  // below this are not traced; 0 traces every bounce up to depth. The weight ignores how bright the bounce is and gamma
+  // stretches dark values, so keep it well under 1/255, e.g. 1e-3.
+  double min_path_weight = 0;
+  // Instead of dropping such rays, trace each with probability weight / min_path_weight and scale up the survivors
+  // (Russian roulette). Unbiased, but adds noise; the choice depends only on the ray, so renders stay repeatable.
+  bool russian_roulette = false;
+  // Scenes read with levels of detail (ReaderOptions::build_lods) trace each instance at the coarsest level whose
+  // error, seen from the camera, stays under this many pixels; 0 always traces full detail.
+  double lod_pixel_error = 0.5;
 };
@@ -0,0 +1,183 @@
+#include <raytracer/image.hpp>
+#include <raytracer/raytracer.hpp>
+#include <raytracer/sequence.hpp>
+#include <scene/reader.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace rt {
+
+namespace {
+
+struct Frame {
+  std::size_t index;
+  image::Image image;
+};
+
+// Traced frames on their way to the writer thread. Push blocks while the queue is full; Pop blocks while it is
+// empty and returns nothing once it is closed and drained.
+class FrameQueue {
+ public:
+  explicit FrameQueue(std::size_t capacity) noexcept : capacity_(capacity) {
+  }
+
+  // False if the writer has given up, in which case the frame is dropped.
+  bool Push(Frame frame) {
+    std::unique_lock lock(mutex_);
+    not_full_.wait(lock, [this] {
+      return frames_.size() < capacity_ || aborted_;
+    });
+    if (aborted_) {
+      return false;
+    }
+    frames_.push_back(std::move(frame));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  std::optional<Frame> Pop() {
+    std::unique_lock lock(mutex_);
+    not_empty_.wait(lock, [this] {
+      return !frames_.empty() || closed_;
+    });
+    if (frames_.empty()) {
+      return std::nullopt;
+    }
+    Frame frame = std::move(frames_.front());
+    frames_.pop_front();
+    not_full_.notify_one();
+    return frame;
+  }
+
+  // No more frames will be pushed.
+  void Close() {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+  // No more frames will be popped.
+  void Abort() {
+    std::lock_guard lock(mutex_);
+    aborted_ = true;
+    not_full_.notify_all();
+  }
+
+ private:
+  std::size_t capacity_;
+  std::deque<Frame> frames_;
+  bool closed_ = false;
+  bool aborted_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+[[nodiscard]] double SecondsSince(std::chrono::steady_clock::time_point start) noexcept {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+[[nodiscard]] std::array<double, 3> Lerp(const std::array<double, 3>& lhs, const std::array<double, 3>& rhs,
+                                         double t) noexcept {
+  return {lhs[0] + (rhs[0] - lhs[0]) * t, lhs[1] + (rhs[1] - lhs[1]) * t, lhs[2] + (rhs[2] - lhs[2]) * t};
+}
+
+// Writes frames until the queue is closed and returns the time spent doing so.
+double WriteFrames(FrameQueue& queue, const SequenceOptions& options) {
+  double seconds = 0;
+  try {
+    while (auto frame = queue.Pop()) {
+      auto start = std::chrono::steady_clock::now();
+      frame->image.Write(GetFramePath(options, frame->index).string());
+      seconds += SecondsSince(start);
+    }
+  } catch (...) {
+    queue.Abort();
+    throw;
+  }
+  return seconds;
+}
+
+}  // namespace
+
+std::vector<CameraOptions> InterpolateCameraPath(const std::vector<CameraKeyframe>& keyframes) {
+  if (keyframes.empty()) {
+    throw std::runtime_error("camera path has no keyframes");
+  }
+  for (std::size_t i = 1; i < keyframes.size(); ++i) {
+    if (keyframes[i].frame <= keyframes[i - 1].frame) {
+      throw std::runtime_error("camera keyframes are not sorted by frame");
+    }
+    if (keyframes[i].camera.screen_width != keyframes[0].camera.screen_width ||
+        keyframes[i].camera.screen_height != keyframes[0].camera.screen_height) {
+      throw std::runtime_error("camera keyframes differ in resolution");
+    }
+  }
+  std::vector<CameraOptions> frames(keyframes[0].frame + 1, keyframes[0].camera);
+  frames.reserve(keyframes.back().frame + 1);
+  for (std::size_t i = 1; i < keyframes.size(); ++i) {
+    const CameraKeyframe& from = keyframes[i - 1];
+    const CameraKeyframe& to = keyframes[i];
+    for (std::size_t frame = from.frame + 1; frame <= to.frame; ++frame) {
+      double t = static_cast<double>(frame - from.frame) / static_cast<double>(to.frame - from.frame);
+      frames.emplace_back(from.camera.screen_width, from.camera.screen_height,
+                          from.camera.fov + (to.camera.fov - from.camera.fov) * t,
+                          Lerp(from.camera.look_from, to.camera.look_from, t),
+                          Lerp(from.camera.look_to, to.camera.look_to, t));
+    }
+  }
+  return frames;
+}
+
+std::filesystem::path GetFramePath(const SequenceOptions& options, std::size_t frame) {
+  std::ostringstream name;
+  name << options.prefix << std::setw(4) << std::setfill('0') << frame << ".png";
+  return options.directory / name.str();
+}
+
+SequenceStats RenderSequence(const Scene& scene, const std::vector<CameraOptions>& frames,
+                             const RenderOptions& render_options, const SequenceOptions& sequence_options) {
+  auto start = std::chrono::steady_clock::now();
+  SequenceStats stats;
+  FrameQueue queue(std::max<std::size_t>(sequence_options.max_pending_frames, 1));
+  auto writer = std::async(std::launch::async, WriteFrames, std::ref(queue), std::cref(sequence_options));
+  try {
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+      auto trace_start = std::chrono::steady_clock::now();
+      image::Image image = Render(scene, frames[i], render_options);
+      auto push_start = std::chrono::steady_clock::now();
+      stats.trace_seconds += std::chrono::duration<double>(push_start - trace_start).count();
+      bool accepted = queue.Push({i, std::move(image)});
+      stats.stall_seconds += SecondsSince(push_start);
+      if (!accepted) {
+        break;
+      }
+      ++stats.frames;
+    }
+  } catch (...) {
+    queue.Close();
+    throw;
+  }
+  queue.Close();
+  stats.write_seconds = writer.get();
+  stats.wall_seconds = SecondsSince(start);
+  return stats;
+}
+
+SequenceStats RenderSequence(const std::string& filename, const std::vector<CameraOptions>& frames,
+                             const RenderOptions& render_options, const SequenceOptions& sequence_options) {
+  return RenderSequence(ReadScene(filename), frames, render_options, sequence_options);
+}
+
+}  // namespace rt
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <raytracer/camera_options.hpp>
+#include <raytracer/render_options.hpp>
+#include <scene/scene.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+// Camera at one frame of a flythrough.
+struct CameraKeyframe {
+  std::size_t frame;
+  CameraOptions camera;
+};
+
+// One camera per frame, from frame 0 to the last keyframe. look_from, look_to and fov are interpolated linearly
+// between keyframes; frames before the first one hold it. Keyframes must be sorted by frame, without repeats, and
+// share one resolution.
+[[nodiscard]] std::vector<CameraOptions> InterpolateCameraPath(const std::vector<CameraKeyframe>& keyframes);
+
+struct SequenceOptions {
+  // Frame i is written to directory / (prefix + i padded to 4 digits + ".png").
+  std::filesystem::path directory = ".";
+  std::string prefix = "frame_";
+  // Traced frames waiting for the writer. Tracing blocks while this many are queued.
+  std::size_t max_pending_frames = 2;
+};
+
+struct SequenceStats {
+  std::size_t frames = 0;
+  double trace_seconds = 0;
+  double write_seconds = 0;  // encoding and writing, on the writer thread
+  double stall_seconds = 0;  // tracing waited for the writer
+  double wall_seconds = 0;
+};
+
+[[nodiscard]] std::filesystem::path GetFramePath(const SequenceOptions& options, std::size_t frame);
+
+// Renders the frames in order against one loaded scene. Frame i + 1 is traced while frame i is encoded and written
+// on a separate thread, so throughput is that of tracing as long as writing is faster. A failed write stops the
+// sequence and its exception is rethrown here.
+SequenceStats RenderSequence(const Scene& scene, const std::vector<CameraOptions>& frames,
+                             const RenderOptions& render_options, const SequenceOptions& sequence_options);
+SequenceStats RenderSequence(const std::string& filename, const std::vector<CameraOptions>& frames,
+                             const RenderOptions& render_options, const SequenceOptions& sequence_options);
+
+}  // namespace rt
@@ -0,0 +1,97 @@
+#include <raytracer/tile.hpp>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace rt {
+
+namespace {
+
+static_assert(std::is_trivially_copyable_v<geom::Vector> && sizeof(geom::Vector) == 3 * sizeof(double));
+
+constexpr std::array<char, 8> kTileMagic = {'R', 'T', 'T', 'I', 'L', 'E', '1', '\0'};
+
+struct TileHeader {
+  std::array<char, 8> magic;
+  std::int32_t frame_width;
+  std::int32_t frame_height;
+  std::int32_t mode;
+  Region region;
+  double max_rgb;
+  double max_distance;
+};
+
+}  // namespace
+
+void WriteTile(const Tile& tile, const std::string& filename) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Can't open file " + filename);
+  }
+  TileHeader header{kTileMagic,      tile.frame_width, tile.frame_height, static_cast<std::int32_t>(tile.mode),
+                    tile.region,     tile.max_rgb,     tile.max_distance};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(tile.values.data()),
+             static_cast<std::streamsize>(tile.values.size() * sizeof(geom::Vector)));
+  file.write(reinterpret_cast<const char*>(tile.hits.data()), static_cast<std::streamsize>(tile.hits.size()));
+  if (!file) {
+    throw std::runtime_error("Can't write file " + filename);
+  }
+}
+
+Tile ReadTile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Can't open file " + filename);
+  }
+  TileHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  // A non-empty region inside a non-empty frame, checked before anything is sized from the header.
+  const Region& region = header.region;
+  bool valid = file && header.magic == kTileMagic && header.frame_width > 0 && header.frame_height > 0 &&
+               header.mode >= static_cast<std::int32_t>(RenderMode::kDepth) &&
+               header.mode <= static_cast<std::int32_t>(RenderMode::kFull) && region.x_begin >= 0 &&
+               region.y_begin >= 0 && region.x_end <= header.frame_width && region.y_end <= header.frame_height &&
+               region.Width() > 0 && region.Height() > 0;
+  if (!valid) {
+    throw std::runtime_error(filename + " is not a tile file");
+  }
+  Tile tile;
+  tile.frame_width = header.frame_width;
+  tile.frame_height = header.frame_height;
+  tile.mode = static_cast<RenderMode>(header.mode);
+  tile.region = header.region;
+  tile.max_rgb = header.max_rgb;
+  tile.max_distance = header.max_distance;
+  auto pixels = static_cast<std::size_t>(tile.region.Width()) * static_cast<std::size_t>(tile.region.Height());
+  tile.values.resize(pixels);
+  tile.hits.resize(pixels);
+  file.read(reinterpret_cast<char*>(tile.values.data()), static_cast<std::streamsize>(pixels * sizeof(geom::Vector)));
+  file.read(reinterpret_cast<char*>(tile.hits.data()), static_cast<std::streamsize>(pixels));
+  if (!file) {
+    throw std::runtime_error(filename + " is truncated");
+  }
+  return tile;
+}
+
+std::size_t GetFramebufferBytes(const CameraOptions& camera_options) noexcept {
+  auto width = static_cast<std::size_t>(camera_options.screen_width);
+  auto height = static_cast<std::size_t>(camera_options.screen_height);
+  // The image keeps a pointer to each of its RGBA rows.
+  std::size_t image = height * (sizeof(void*) + width * 4);
+  return width * height * (sizeof(geom::Vector) + sizeof(std::uint8_t)) + image;
+}
+
+std::vector<Region> SplitIntoBands(int width, int height, int count) {
+  count = std::clamp(count, 1, std::max(height, 1));
+  std::vector<Region> bands;
+  for (int i = 0; i < count; ++i) {
+    bands.push_back({0, height * i / count, width, height * (i + 1) / count});
+  }
+  return bands;
+}
+
+}  // namespace rt
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <geometry/vector.hpp>
+#include <raytracer/camera_options.hpp>
+#include <raytracer/image.hpp>
+#include <raytracer/render_options.hpp>
+#include <scene/scene.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rt {
+
+// Crop window of a frame in pixels, [x_begin, x_end) x [y_begin, y_end).
+struct Region {
+  int x_begin;
+  int y_begin;
+  int x_end;
+  int y_end;
+
+  [[nodiscard]] int Width() const noexcept {
+    return x_end - x_begin;
+  }
+
+  [[nodiscard]] int Height() const noexcept {
+    return y_end - y_begin;
+  }
+
+  bool operator==(const Region&) const = default;
+};
+
+// Linear pixel values of a region before tonemapping, with the maxima the tonemap normalizes by. The maxima of a
+// frame are the maxima over its tiles, so tiles rendered anywhere merge into exactly the image Render() gives.
+struct Tile {
+  int frame_width = 0;
+  int frame_height = 0;
+  RenderMode mode = RenderMode::kFull;
+  Region region{0, 0, 0, 0};
+  double max_rgb = 0;
+  double max_distance = 0;
+  std::vector<geom::Vector> values;  // row-major within the region
+  std::vector<std::uint8_t> hits;    // whether the primary ray hit anything
+};
+
+// Traces one region of the frame the camera describes. Throws if the region is empty or not inside the frame.
+[[nodiscard]] Tile RenderTile(const Scene& scene, const CameraOptions& camera_options,
+                              const RenderOptions& render_options, const Region& region);
+
+// Tonemaps tiles that cover their frame exactly once, with the maxima of all of them. Throws if the tiles disagree
+// on the frame or mode, overlap or leave pixels uncovered.
+[[nodiscard]] image::Image MergeTiles(const std::vector<Tile>& tiles);
+
+// Raw binary tile files for handing tiles between processes on one machine; the layout is that of the host. ReadTile
+// throws std::runtime_error for files whose header doesn't describe a region of a frame in a known mode.
+void WriteTile(const Tile& tile, const std::string& filename);
+[[nodiscard]] Tile ReadTile(const std::string& filename);
+
+// Bytes Render() holds for a frame of the camera at its peak: the linear values and hit flags of the tile and the
+// tonemapped image.
+[[nodiscard]] std::size_t GetFramebufferBytes(const CameraOptions& camera_options) noexcept;
+
+// Splits a frame into count horizontal bands of nearly equal height, top to bottom.
+[[nodiscard]] std::vector<Region> SplitIntoBands(int width, int height, int count);
+
+}  // namespace rt
@@ -0,0 +1,146 @@
+#include <raytracer/tonemap.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace rt {
+
+namespace {
+
+constexpr int kGammaBuckets = 4096;
+// Below this many pixels per thread, starting threads costs more than the tonemap itself.
+constexpr std::size_t kMinPixelsPerTask = std::size_t{1} << 16;
+
+[[nodiscard]] int ReferenceGamma(double value) {
+  return static_cast<int>(pow(value, 1 / 2.2) * 255);
+}
+
+// thresholds[code] is the smallest value that encodes to code or more, and start[bucket] the code of the smallest
+// value in bucket, so a lookup is a table read plus the few steps a bucket spans.
+struct GammaTable {
+  std::array<double, 256> thresholds;
+  std::array<std::uint8_t, kGammaBuckets> start;
+};
+
+[[nodiscard]] const GammaTable& GetGammaTable() {
+  static const GammaTable kTable = [] {
+    GammaTable table;
+    table.thresholds[0] = 0;
+    for (int code = 1; code < 256; ++code) {
+      // pow() of the exact inverse lands within an ulp or two of the step; nudge it onto the step pow() takes.
+      double threshold = pow(code / 255.0, 2.2);
+      while (ReferenceGamma(threshold) < code) {
+        threshold = std::nextafter(threshold, 2.0);
+      }
+      while (ReferenceGamma(std::nextafter(threshold, 0.0)) >= code) {
+        threshold = std::nextafter(threshold, 0.0);
+      }
+      table.thresholds[code] = threshold;
+    }
+    int code = 0;
+    for (int bucket = 0; bucket < kGammaBuckets; ++bucket) {
+      double value = static_cast<double>(bucket) / kGammaBuckets;
+      while (code < 255 && value >= table.thresholds[code + 1]) {
+        ++code;
+      }
+      table.start[bucket] = code;
+    }
+    return table;
+  }();
+  return kTable;
+}
+
+static_assert(sizeof(geom::Vector) == 3 * sizeof(double));
+
+// Reinhard with the white point at max_rgb over the channels of a whole row: no branches and no calls, so the loop
+// runs in vector registers. Pixels that missed are selected back when encoding.
+void MapFullRow(const geom::Vector* values, int width, double white_squared, double* mapped) {
+  const auto* channels = reinterpret_cast<const double*>(values);
+  std::size_t count = 3 * static_cast<std::size_t>(width);
+#pragma omp simd
+  for (std::size_t i = 0; i < count; ++i) {
+    double value = channels[i];
+    mapped[i] = value * (1 + value / white_squared) / (1 + value);
+  }
+}
+
+void TonemapRows(const Tile& tile, const ToneScale& scale, int y_begin, int y_end, image::Image* image) {
+  const Region& region = tile.region;
+  int width = region.Width();
+  std::vector<double> mapped(tile.mode == RenderMode::kFull ? 3 * static_cast<std::size_t>(width) : 0);
+  double white_squared = scale.max_rgb * scale.max_rgb;
+  for (int y = y_begin; y < y_end; ++y) {
+    std::size_t row = static_cast<std::size_t>(y - region.y_begin) * width;
+    const geom::Vector* values = tile.values.data() + row;
+    const std::uint8_t* hits = tile.hits.data() + row;
+    if (tile.mode == RenderMode::kFull) {
+      MapFullRow(values, width, white_squared, mapped.data());
+      for (int x = 0; x < width; ++x) {
+        image::RGB pixel;
+        if (hits[x]) {
+          pixel = {EncodeGamma(mapped[3 * x]), EncodeGamma(mapped[3 * x + 1]), EncodeGamma(mapped[3 * x + 2])};
+        } else {
+          pixel = {static_cast<int>(values[x][0] * 255), static_cast<int>(values[x][1] * 255),
+                   static_cast<int>(values[x][2] * 255)};
+        }
+        image->SetPixel(pixel, y, region.x_begin + x);
+      }
+    } else {
+      for (int x = 0; x < width; ++x) {
+        geom::Vector value = values[x];
+        if (tile.mode == RenderMode::kDepth && hits[x]) {
+          value /= scale.max_distance;
+        }
+        image->SetPixel({static_cast<int>(value[0] * 255), static_cast<int>(value[1] * 255),
+                         static_cast<int>(value[2] * 255)},
+                        y, region.x_begin + x);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void TonemapTile(const Tile& tile, const ToneScale& scale, image::Image* image, std::size_t threads) {
+  const Region& region = tile.region;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::size_t pixels = tile.values.size();
+  auto tasks = static_cast<int>(std::clamp<std::size_t>(
+      std::min(threads, pixels / kMinPixelsPerTask), 1, static_cast<std::size_t>(region.Height())));
+  auto band_begin = [&](int task) {
+    return region.y_begin + region.Height() * task / tasks;
+  };
+  std::vector<std::future<void>> bands;
+  for (int task = 1; task < tasks; ++task) {
+    bands.push_back(std::async(std::launch::async, TonemapRows, std::cref(tile), std::cref(scale), band_begin(task),
+                               band_begin(task + 1), image));
+  }
+  TonemapRows(tile, scale, band_begin(0), band_begin(1), image);
+  for (auto& band : bands) {
+    band.get();
+  }
+}
+
+int EncodeGamma(double value) noexcept {
+  if (!(value > 0)) {
+    return 0;
+  }
+  if (value >= 1) {
+    return 255;
+  }
+  const GammaTable& table = GetGammaTable();
+  int code = table.start[static_cast<std::size_t>(value * kGammaBuckets)];
+  while (code < 255 && value >= table.thresholds[code + 1]) {
+    ++code;
+  }
+  return code;
+}
+
+}  // namespace rt
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <raytracer/image.hpp>
+#include <raytracer/tile.hpp>
+
+#include <cstddef>
+
+namespace rt {
+
+// Frame-wide maxima the tonemap normalizes by: the largest channel of a lit pixel in kFull mode and the farthest
+// hit in kDepth mode.
+struct ToneScale {
+  double max_rgb = 0;
+  double max_distance = 0;
+};
+
+// Writes the tonemapped pixels of a tile into its region of the image, which must be the size of the tile's frame.
+// Rows are split between up to `threads` threads (0 means one per hardware thread); small tiles stay on the calling
+// thread.
+void TonemapTile(const Tile& tile, const ToneScale& scale, image::Image* image, std::size_t threads = 0);
+
+// static_cast<int>(255 * pow(value, 1 / 2.2)) for values in [0, 1], from a table instead of pow. Values outside are
+// clamped, NaN gives 0.
+[[nodiscard]] int EncodeGamma(double value) noexcept;
+
+}  // namespace rt
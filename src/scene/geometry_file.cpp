@@ -0,0 +1,405 @@
+#include <scene/geometry_file.hpp>
+#include <util/mapped_file.hpp>
+#include <util/mapped_vector.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace rt {
+
+namespace {
+
+constexpr std::array<char, 8> kMagic{'R', 'T', 'G', 'E', 'O', 'M', '0', '1'};
+// Sections start on page boundaries so that no page holds two kinds of data.
+constexpr std::uint64_t kAlignment = 4096;
+
+enum Section : std::size_t {
+  kVertices,
+  kNormals,
+  kVertexIndices,
+  kNormalIndices,
+  kMaterials,
+  kMeshObjects,
+  kBvhNodes,
+  kBvhIndices,
+  kSectionCount
+};
+
+using Triple = std::array<std::uint32_t, 3>;
+
+constexpr std::array<std::uint32_t, kSectionCount> kElementSizes{
+  sizeof(geom::Vector), sizeof(std::uint32_t), sizeof(Triple),        sizeof(Triple),
+  sizeof(MaterialId),   sizeof(std::uint32_t), sizeof(accel::BvhNode), sizeof(std::uint32_t)};
+
+static_assert(std::is_trivially_copyable_v<geom::Vector> && std::is_trivially_copyable_v<accel::BvhNode>);
+
+struct SectionEntry {
+  std::uint64_t offset;
+  std::uint64_t count;
+};
+
+struct FileHeader {
+  std::array<char, 8> magic;
+  std::array<std::uint32_t, kSectionCount> element_sizes;
+  std::array<SectionEntry, kSectionCount> sections;
+  std::uint64_t side_offset;  // serialized materials, spheres, lights, meshes and instances
+  std::uint64_t side_size;
+};
+
+// Appends plain values to the side data.
+class SideWriter {
+ public:
+  template <typename T>
+  void Put(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    data_.append(bytes, sizeof(T));
+  }
+
+  void PutString(const std::string& value) {
+    Put<std::uint64_t>(value.size());
+    data_.append(value);
+  }
+
+  [[nodiscard]] const std::string& Data() const noexcept {
+    return data_;
+  }
+
+ private:
+  std::string data_;
+};
+
+class SideReader {
+ public:
+  explicit SideReader(std::span<const std::byte> data) noexcept : data_(data) {
+  }
+
+  template <typename T>
+  T Get() {
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string GetString() {
+    auto size = Get<std::uint64_t>();
+    const std::byte* bytes = Take(size);
+    return {reinterpret_cast<const char*>(bytes), static_cast<std::size_t>(size)};
+  }
+
+ private:
+  const std::byte* Take(std::uint64_t size) {
+    if (size > data_.size() - position_) {
+      throw std::runtime_error("mapped file is truncated or corrupt");
+    }
+    const std::byte* bytes = data_.data() + position_;
+    position_ += size;
+    return bytes;
+  }
+
+  std::span<const std::byte> data_;
+  std::size_t position_ = 0;
+};
+
+// Index of every element in the order of first use; elements never used are dropped.
+class Renumbering {
+ public:
+  explicit Renumbering(std::size_t size) : new_index_(size, kUnused) {
+  }
+
+  std::uint32_t operator()(std::uint32_t old_index) {
+    if (new_index_[old_index] == kUnused) {
+      new_index_[old_index] = static_cast<std::uint32_t>(old_indices_.size());
+      old_indices_.push_back(old_index);
+    }
+    return new_index_[old_index];
+  }
+
+  [[nodiscard]] const std::vector<std::uint32_t>& OldIndices() const noexcept {
+    return old_indices_;
+  }
+
+ private:
+  static constexpr std::uint32_t kUnused = std::numeric_limits<std::uint32_t>::max();
+
+  std::vector<std::uint32_t> new_index_;
+  std::vector<std::uint32_t> old_indices_;
+};
+
+// Streams one section into the file: it starts on the next page boundary and its elements go out in batches, so the
+// writer never holds more than a batch of any section.
+template <typename T>
+class SectionWriter {
+ public:
+  SectionWriter(std::ofstream& file, FileHeader* header, Section section)
+    : file_(file), entry_(header->sections[section]) {
+    auto position = static_cast<std::uint64_t>(file_.tellp());
+    entry_ = {(position + kAlignment - 1) / kAlignment * kAlignment, 0};
+    std::string padding(entry_.offset - position, '\0');
+    file_.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+    batch_.reserve(kBatchBytes / sizeof(T));
+  }
+
+  SectionWriter(const SectionWriter&) = delete;
+  SectionWriter& operator=(const SectionWriter&) = delete;
+
+  ~SectionWriter() {
+    Flush();
+  }
+
+  void Put(const T& element) {
+    batch_.push_back(element);
+    if (batch_.size() == batch_.capacity()) {
+      Flush();
+    }
+  }
+
+ private:
+  static constexpr std::size_t kBatchBytes = 16 * kAlignment;
+
+  void Flush() {
+    file_.write(reinterpret_cast<const char*>(batch_.data()), static_cast<std::streamsize>(batch_.size() * sizeof(T)));
+    entry_.count += batch_.size();
+    batch_.clear();
+  }
+
+  std::ofstream& file_;
+  SectionEntry& entry_;
+  std::vector<T> batch_;
+};
+
+template <typename T>
+util::MappedVector<T> MapSection(const std::shared_ptr<const util::MappedFile>& file, const FileHeader& header,
+                                 Section section, std::uint64_t first, std::uint64_t count) {
+  const SectionEntry& entry = header.sections[section];
+  if (first > entry.count || count > entry.count - first) {
+    throw std::runtime_error("mapped file is truncated or corrupt");
+  }
+  return {file->View<T>(entry.offset + first * sizeof(T), count), file};
+}
+
+template <typename T>
+util::MappedVector<T> MapSection(const std::shared_ptr<const util::MappedFile>& file, const FileHeader& header,
+                                 Section section) {
+  return MapSection<T>(file, header, section, 0, header.sections[section].count);
+}
+
+}  // namespace
+
+void WriteGeometryFile(const Scene& scene, const std::string& filename) {
+  const IndexedMesh& objects = scene.GetObjects();
+  const auto& meshes = scene.GetMeshes();
+
+  SideWriter side;
+  side.Put<std::uint64_t>(meshes.size());
+  std::uint64_t first_object = 0;
+  std::uint64_t first_node = 0;
+  std::uint64_t max_object_count = 0;
+  for (const auto& mesh : meshes) {
+    side.PutString(mesh.name);
+    side.Put<std::uint64_t>(first_object);
+    side.Put<std::uint64_t>(mesh.bvh.GetIndices().size());
+    side.Put<std::uint64_t>(first_node);
+    side.Put<std::uint64_t>(mesh.bvh.GetNodes().size());
+    first_object += mesh.bvh.GetIndices().size();
+    first_node += mesh.bvh.GetNodes().size();
+    max_object_count = std::max<std::uint64_t>(max_object_count, mesh.bvh.GetIndices().size());
+  }
+  side.Put<std::uint64_t>(scene.GetInstances().size());
+  for (const auto& instance : scene.GetInstances()) {
+    side.Put(instance.mesh);
+    for (std::size_t row = 0; row < 4; ++row) {
+      side.Put(instance.object_to_world[row]);
+    }
+  }
+  side.Put<std::uint64_t>(scene.GetMaterials().size());
+  for (const auto& material : scene.GetMaterials()) {
+    side.PutString(material.name);
+    side.Put(material.ambient_color);
+    side.Put(material.diffuse_color);
+    side.Put(material.specular_color);
+    side.Put(material.intensity);
+    side.Put(material.specular_exponent);
+    side.Put(material.refraction_index);
+    side.Put(material.albedo);
+  }
+  side.Put<std::uint64_t>(scene.GetSphereObjects().size());
+  for (const auto& sphere_object : scene.GetSphereObjects()) {
+    side.Put(sphere_object.material);
+    side.Put(sphere_object.sphere.GetCenter());
+    side.Put(sphere_object.sphere.GetRadius());
+  }
+  side.Put<std::uint64_t>(scene.GetLights().size());
+  for (const auto& light : scene.GetLights()) {
+    side.Put(light.position);
+    side.Put(light.intensity);
+  }
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file.good()) {
+    throw std::runtime_error("file is not open");
+  }
+  FileHeader header{kMagic, kElementSizes, {}, sizeof(FileHeader), side.Data().size()};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(side.Data().data(), static_cast<std::streamsize>(side.Data().size()));
+
+  // Sections are streamed one after the other, each by its own walk over the triangles. Leaves list primitives in
+  // tree order; storing the triangles in that order turns the leaf indices into 0, 1, 2, ... and puts every subtree
+  // on a contiguous run of pages.
+  auto for_each_triangle = [&meshes, &objects](auto&& visit) {
+    for (const auto& mesh : meshes) {
+      for (std::uint32_t leaf_index : mesh.bvh.GetIndices()) {
+        visit(mesh.objects[leaf_index]);
+      }
+    }
+  };
+  Renumbering vertex_numbers(objects.VertexCount());
+  Renumbering normal_numbers(objects.NormalCount());
+  {
+    SectionWriter<Triple> section(file, &header, kVertexIndices);
+    for_each_triangle([&](std::uint32_t object) {
+      const Triple& old_vertices = objects.GetVertexIndices(object);
+      section.Put({vertex_numbers(old_vertices[0]), vertex_numbers(old_vertices[1]), vertex_numbers(old_vertices[2])});
+    });
+  }
+  {
+    SectionWriter<Triple> section(file, &header, kNormalIndices);
+    for_each_triangle([&](std::uint32_t object) {
+      const Triple& old_normals = objects.GetNormalIndices(object);
+      if (old_normals[0] == IndexedMesh::kNoNormal) {
+        section.Put(old_normals);
+      } else {
+        section.Put({normal_numbers(old_normals[0]), normal_numbers(old_normals[1]), normal_numbers(old_normals[2])});
+      }
+    });
+  }
+  {
+    SectionWriter<MaterialId> section(file, &header, kMaterials);
+    for_each_triangle([&](std::uint32_t object) { section.Put(objects.GetMaterial(object)); });
+  }
+  {
+    SectionWriter<geom::Vector> section(file, &header, kVertices);
+    for (std::uint32_t old_index : vertex_numbers.OldIndices()) {
+      section.Put(objects.GetVertex(old_index));
+    }
+  }
+  {
+    SectionWriter<std::uint32_t> section(file, &header, kNormals);
+    for (std::uint32_t old_index : normal_numbers.OldIndices()) {
+      section.Put(objects.GetNormalCode(old_index));
+    }
+  }
+  {
+    SectionWriter<std::uint32_t> section(file, &header, kMeshObjects);
+    for (std::uint64_t i = 0; i < first_object; ++i) {
+      section.Put(static_cast<std::uint32_t>(i));
+    }
+  }
+  {
+    SectionWriter<accel::BvhNode> section(file, &header, kBvhNodes);
+    for (const auto& mesh : meshes) {
+      for (const auto& node : mesh.bvh.GetNodes()) {
+        section.Put(node);
+      }
+    }
+  }
+  {
+    // Leaf indices are the same 0, 1, 2, ... in every mesh, so the longest run serves them all.
+    SectionWriter<std::uint32_t> section(file, &header, kBvhIndices);
+    for (std::uint64_t i = 0; i < max_object_count; ++i) {
+      section.Put(static_cast<std::uint32_t>(i));
+    }
+  }
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!file.good()) {
+    throw std::runtime_error("cannot write " + filename);
+  }
+}
+
+Scene MapScene(const std::string& filename, std::size_t resident_limit) {
+  auto file = std::make_shared<util::MappedFile>(filename, resident_limit);
+  std::shared_ptr<const util::MappedFile> owner = file;
+  const FileHeader& header = file->View<FileHeader>(0, 1)[0];
+  if (header.magic != kMagic || header.element_sizes != kElementSizes) {
+    throw std::runtime_error(filename + " is not a geometry file of this build");
+  }
+
+  SideReader side(file->View<std::byte>(header.side_offset, header.side_size));
+  std::vector<Mesh> meshes;
+  auto mesh_count = side.Get<std::uint64_t>();
+  for (std::uint64_t i = 0; i < mesh_count; ++i) {
+    std::string name = side.GetString();
+    auto first_object = side.Get<std::uint64_t>();
+    auto object_count = side.Get<std::uint64_t>();
+    auto first_node = side.Get<std::uint64_t>();
+    auto node_count = side.Get<std::uint64_t>();
+    meshes.emplace_back(std::move(name),
+                        MapSection<std::uint32_t>(owner, header, kMeshObjects, first_object, object_count));
+    // Leaf indices are 0, 1, 2, ... in every mesh, so all meshes share the front of one index array.
+    meshes.back().bvh = accel::Bvh(MapSection<accel::BvhNode>(owner, header, kBvhNodes, first_node, node_count),
+                                   MapSection<std::uint32_t>(owner, header, kBvhIndices, 0, object_count));
+  }
+  std::vector<Instance> instances;
+  auto instance_count = side.Get<std::uint64_t>();
+  for (std::uint64_t i = 0; i < instance_count; ++i) {
+    auto mesh = side.Get<std::uint32_t>();
+    if (mesh >= meshes.size()) {
+      throw std::runtime_error("mapped file is truncated or corrupt");
+    }
+    Matrix object_to_world;
+    for (std::size_t row = 0; row < 4; ++row) {
+      object_to_world[row] = side.Get<std::array<double, 4>>();
+    }
+    instances.emplace_back(mesh, object_to_world);
+  }
+  MaterialTable materials;
+  auto material_count = side.Get<std::uint64_t>();
+  for (std::uint64_t i = 0; i < material_count; ++i) {
+    Material material;
+    material.name = side.GetString();
+    material.ambient_color = side.Get<geom::Vector>();
+    material.diffuse_color = side.Get<geom::Vector>();
+    material.specular_color = side.Get<geom::Vector>();
+    material.intensity = side.Get<geom::Vector>();
+    material.specular_exponent = side.Get<double>();
+    material.refraction_index = side.Get<double>();
+    material.albedo = side.Get<std::array<double, 3>>();
+    materials.Add(std::move(material));
+  }
+  std::vector<SphereObject> sphere_objects;
+  auto sphere_count = side.Get<std::uint64_t>();
+  for (std::uint64_t i = 0; i < sphere_count; ++i) {
+    auto material = side.Get<MaterialId>();
+    auto center = side.Get<geom::Vector>();
+    sphere_objects.emplace_back(material, center, side.Get<double>());
+  }
+  std::vector<Light> lights;
+  auto light_count = side.Get<std::uint64_t>();
+  for (std::uint64_t i = 0; i < light_count; ++i) {
+    auto position = side.Get<geom::Vector>();
+    lights.emplace_back(position, side.Get<geom::Vector>());
+  }
+
+  IndexedMesh objects(MapSection<geom::Vector>(owner, header, kVertices),
+                      MapSection<std::uint32_t>(owner, header, kNormals),
+                      MapSection<Triple>(owner, header, kVertexIndices),
+                      MapSection<Triple>(owner, header, kNormalIndices),
+                      MapSection<MaterialId>(owner, header, kMaterials));
+  Scene scene{std::move(objects),   std::move(sphere_objects), std::move(lights),
+              std::move(materials), std::move(meshes),         std::move(instances)};
+  scene.AttachGeometryFile(std::move(file));
+  return scene;
+}
+
+}  // namespace rt
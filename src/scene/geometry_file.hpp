@@ -0,0 +1,24 @@
+#pragma once
+
+#include <scene/scene.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace rt {
+
+// Out-of-core scenes. The file holds the triangles, their vertices and normals and the per-mesh hierarchies as flat
+// arrays that are mapped, not read: only the pages rays actually reach are brought into memory. Triangles are
+// written in the order of the leaves of their mesh's hierarchy and vertices in the order these triangles first use
+// them, so a subtree's geometry sits on a few neighbouring pages. Materials, spheres, lights and instances are small
+// and are copied into memory.
+//
+// By convention such files have the .rtg extension; ReadScene() maps them instead of parsing them.
+void WriteGeometryFile(const Scene& scene, const std::string& filename);
+
+// Maps a file written by WriteGeometryFile(). A nonzero resident_limit caps the bytes of mapped geometry kept in
+// memory, see Scene::TrimGeometry(). The contents are trusted: indices are not validated, as that would read the
+// whole file.
+Scene MapScene(const std::string& filename, std::size_t resident_limit = 0);
+
+}  // namespace rt
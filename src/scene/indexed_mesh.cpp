@@ -0,0 +1,51 @@
+#include <geometry/octahedral.hpp>
+#include <scene/indexed_mesh.hpp>
+
+#include <cassert>
+
+namespace rt {
+
+std::uint32_t IndexedMesh::AddVertex(const geom::Vector& vertex) {
+  vertices_.push_back(vertex);
+  return vertices_.size() - 1;
+}
+
+std::uint32_t IndexedMesh::AddNormal(const geom::Vector& normal) {
+  normals_.push_back(geom::EncodeOctahedral(normal));
+  return normals_.size() - 1;
+}
+
+void IndexedMesh::AddTriangle(const std::array<std::uint32_t, 3>& vertices, const std::array<std::uint32_t, 3>& normals,
+                              MaterialId material) {
+  for (std::size_t i = 0; i < 3; ++i) {
+    assert(vertices[i] < vertices_.size());
+    assert(normals[i] == kNoNormal || normals[i] < normals_.size());
+  }
+  vertex_indices_.push_back(vertices);
+  normal_indices_.push_back(normals);
+  materials_.push_back(material);
+}
+
+geom::Vector IndexedMesh::GetNormal(std::uint32_t index) const noexcept {
+  return geom::DecodeOctahedral(normals_[index]);
+}
+
+Object IndexedMesh::operator[](std::size_t triangle) const {
+  Object object{{}, materials_[triangle], GetTriangle(triangle)};
+  const auto& normals = normal_indices_[triangle];
+  if (normals[0] != kNoNormal) {
+    for (std::size_t i = 0; i < 3; ++i) {
+      object.normals[i] = GetNormal(normals[i]);
+    }
+  }
+  return object;
+}
+
+std::size_t IndexedMesh::MemoryUsage() const noexcept {
+  return vertices_.capacity() * sizeof(geom::Vector) + normals_.capacity() * sizeof(std::uint32_t) +
+         vertex_indices_.capacity() * sizeof(std::array<std::uint32_t, 3>) +
+         normal_indices_.capacity() * sizeof(std::array<std::uint32_t, 3>) +
+         materials_.capacity() * sizeof(MaterialId);
+}
+
+}  // namespace rt
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <geometry/triangle.hpp>
+#include <geometry/vector.hpp>
+#include <scene/material.hpp>
+#include <scene/object.hpp>
+#include <util/mapped_vector.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace rt {
+
+// All scene triangles in indexed form: positions live once in a shared vertex buffer, normals once in a buffer of
+// octahedral codes, and every triangle is two 32-bit index triples plus its material id. Object is only built on
+// demand, as a value, for the triangle being shaded.
+class IndexedMesh {
+ public:
+  static constexpr std::uint32_t kNoNormal = std::numeric_limits<std::uint32_t>::max();
+
+  class Iterator {
+   public:
+    Iterator(const IndexedMesh* mesh, std::size_t index) noexcept : mesh_(mesh), index_(index) {
+    }
+
+    [[nodiscard]] Object operator*() const {
+      return (*mesh_)[index_];
+    }
+
+    Iterator& operator++() noexcept {
+      ++index_;
+      return *this;
+    }
+
+    [[nodiscard]] bool operator==(const Iterator& other) const noexcept {
+      return index_ == other.index_;
+    }
+
+   private:
+    const IndexedMesh* mesh_;
+    std::size_t index_;
+  };
+
+  IndexedMesh() = default;
+
+  // Wraps prepared buffers, which may be views of a mapped file; AddVertex and friends only work on owned ones.
+  IndexedMesh(util::MappedVector<geom::Vector> vertices, util::MappedVector<std::uint32_t> normals,
+              util::MappedVector<std::array<std::uint32_t, 3>> vertex_indices,
+              util::MappedVector<std::array<std::uint32_t, 3>> normal_indices,
+              util::MappedVector<MaterialId> materials) noexcept
+    : vertices_(std::move(vertices)),
+      normals_(std::move(normals)),
+      vertex_indices_(std::move(vertex_indices)),
+      normal_indices_(std::move(normal_indices)),
+      materials_(std::move(materials)) {
+  }
+
+  std::uint32_t AddVertex(const geom::Vector& vertex);
+  // The normal is expected to be unit length.
+  std::uint32_t AddNormal(const geom::Vector& normal);
+  // Normal indices are either all kNoNormal or all valid.
+  void AddTriangle(const std::array<std::uint32_t, 3>& vertices, const std::array<std::uint32_t, 3>& normals,
+                   MaterialId material);
+
+  [[nodiscard]] std::size_t VertexCount() const noexcept {
+    return vertices_.size();
+  }
+
+  [[nodiscard]] std::size_t NormalCount() const noexcept {
+    return normals_.size();
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {  // NOLINT
+    return vertex_indices_.size();
+  }
+
+  [[nodiscard]] bool empty() const noexcept {  // NOLINT
+    return vertex_indices_.empty();
+  }
+
+  [[nodiscard]] const geom::Vector& GetVertex(std::uint32_t index) const noexcept {
+    return vertices_[index];
+  }
+
+  [[nodiscard]] geom::Vector GetNormal(std::uint32_t index) const noexcept;
+
+  // Octahedral code of a normal, as stored.
+  [[nodiscard]] std::uint32_t GetNormalCode(std::uint32_t index) const noexcept {
+    return normals_[index];
+  }
+
+  [[nodiscard]] const std::array<std::uint32_t, 3>& GetVertexIndices(std::size_t triangle) const noexcept {
+    return vertex_indices_[triangle];
+  }
+
+  [[nodiscard]] const std::array<std::uint32_t, 3>& GetNormalIndices(std::size_t triangle) const noexcept {
+    return normal_indices_[triangle];
+  }
+
+  [[nodiscard]] MaterialId GetMaterial(std::size_t triangle) const noexcept {
+    return materials_[triangle];
+  }
+
+  [[nodiscard]] geom::Triangle GetTriangle(std::size_t triangle) const {
+    const auto& indices = vertex_indices_[triangle];
+    return {vertices_[indices[0]], vertices_[indices[1]], vertices_[indices[2]]};
+  }
+
+  [[nodiscard]] Object operator[](std::size_t triangle) const;
+
+  [[nodiscard]] Iterator begin() const noexcept {  // NOLINT
+    return {this, 0};
+  }
+
+  [[nodiscard]] Iterator end() const noexcept {  // NOLINT
+    return {this, size()};
+  }
+
+  // Heap bytes held by the buffers, counting reserved capacity. Views of a mapped file or an arena are not counted.
+  [[nodiscard]] std::size_t MemoryUsage() const noexcept;
+
+  // Calls visit(buffer) for each of the buffers, e.g. to move them into an arena.
+  template <typename Visitor>
+  void ForEachBuffer(Visitor&& visit) {
+    visit(vertices_);
+    visit(normals_);
+    visit(vertex_indices_);
+    visit(normal_indices_);
+    visit(materials_);
+  }
+
+  template <typename Visitor>
+  void ForEachBuffer(Visitor&& visit) const {
+    ForEachVertexBuffer(visit);
+    ForEachTriangleBuffer(visit);
+  }
+
+  // The buffers with an entry per vertex or normal: positions and normal codes.
+  template <typename Visitor>
+  void ForEachVertexBuffer(Visitor&& visit) const {
+    visit(vertices_);
+    visit(normals_);
+  }
+
+  // The buffers with an entry per triangle: index triples and material ids.
+  template <typename Visitor>
+  void ForEachTriangleBuffer(Visitor&& visit) const {
+    visit(vertex_indices_);
+    visit(normal_indices_);
+    visit(materials_);
+  }
+
+ private:
+  util::MappedVector<geom::Vector> vertices_;
+  util::MappedVector<std::uint32_t> normals_;
+  util::MappedVector<std::array<std::uint32_t, 3>> vertex_indices_;
+  util::MappedVector<std::array<std::uint32_t, 3>> normal_indices_;
+  util::MappedVector<MaterialId> materials_;
+};
+
+}  // namespace rt
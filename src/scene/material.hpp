@@ -3,10 +3,14 @@
 #include <geometry/vector.hpp>
 
 #include <array>
+#include <cstdint>
 #include <string>
 
 namespace rt {
 
+// Position of a material in the scene's MaterialTable.
+using MaterialId = std::uint16_t;
+
 struct Material {
   std::string name;
   geom::Vector ambient_color;   // Ka
@@ -0,0 +1,53 @@
+#include <scene/material_table.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+namespace rt {
+
+MaterialTable::MaterialTable() {
+  Add({"", {0, 0, 0}, {0.8, 0.8, 0.8}, {0, 0, 0}, {0, 0, 0}, 0, 1, {1, 0, 0}});
+}
+
+MaterialId MaterialTable::Add(Material material) {
+  auto it = ids_.find(material.name);
+  if (it != ids_.end()) {
+    materials_[it->second] = std::move(material);
+    return it->second;
+  }
+  if (materials_.size() == kMaxSize) {
+    throw std::runtime_error("too many materials");
+  }
+  auto id = static_cast<MaterialId>(materials_.size());
+  ids_.emplace(material.name, id);
+  materials_.push_back(std::move(material));
+  return id;
+}
+
+void MaterialTable::Set(MaterialId id, Material material) {
+  Material& target = materials_.at(id);
+  material.name = std::move(target.name);
+  target = std::move(material);
+}
+
+std::optional<MaterialId> MaterialTable::Find(std::string_view name) const {
+  auto it = ids_.find(std::string(name));
+  if (it == ids_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::size_t MaterialTable::MemoryUsage() const noexcept {
+  std::size_t bytes = materials_.capacity() * sizeof(Material) + ids_.bucket_count() * sizeof(void*) +
+                      ids_.size() * sizeof(std::pair<const std::string, MaterialId>);
+  for (const auto& material : materials_) {
+    bytes += material.name.capacity() + 1;
+  }
+  for (const auto& [name, id] : ids_) {
+    bytes += name.capacity() + 1;
+  }
+  return bytes;
+}
+
+}  // namespace rt
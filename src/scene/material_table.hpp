@@ -0,0 +1,63 @@
+#pragma once
+
+#include <scene/material.hpp>
+
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rt {
+
+// All materials of a scene in one flat array. Primitives refer to them by MaterialId, so the shading data of a
+// material is a single indexed load away and primitives with the same material are easy to group.
+class MaterialTable {
+ public:
+  static constexpr std::size_t kMaxSize = std::numeric_limits<MaterialId>::max() + std::size_t{1};
+  // Plain gray diffuse material with an empty name, for primitives that come before any usemtl.
+  static constexpr MaterialId kDefault = 0;
+
+  // Holds only the default material.
+  MaterialTable();
+
+  // Appends the material, or replaces the one with the same name as a repeated newmtl does and keeps its id.
+  MaterialId Add(Material material);
+
+  [[nodiscard]] std::optional<MaterialId> Find(std::string_view name) const;
+
+  // Replaces the material with the given id; it keeps its name. Throws std::out_of_range for unknown ids.
+  void Set(MaterialId id, Material material);
+
+  [[nodiscard]] const Material& operator[](MaterialId id) const noexcept {
+    return materials_[id];
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {  // NOLINT
+    return materials_.size();
+  }
+
+  [[nodiscard]] bool empty() const noexcept {  // NOLINT
+    return materials_.empty();
+  }
+
+  [[nodiscard]] std::vector<Material>::const_iterator begin() const noexcept {  // NOLINT
+    return materials_.begin();
+  }
+
+  [[nodiscard]] std::vector<Material>::const_iterator end() const noexcept {  // NOLINT
+    return materials_.end();
+  }
+
+  // Estimated heap bytes held by the materials, their names and the name index: names count at their capacity, short
+  // ones included, and the index at its buckets and entries, without the allocator's and the nodes' overhead.
+  [[nodiscard]] std::size_t MemoryUsage() const noexcept;
+
+ private:
+  std::vector<Material> materials_;
+  std::unordered_map<std::string, MaterialId> ids_;
+};
+
+}  // namespace rt
@@ -0,0 +1,73 @@
+#include <scene/memory.hpp>
+
+#include <accel/bvh.hpp>
+#include <scene/material.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iomanip>
+
+namespace rt {
+
+std::size_t SceneMemory::Total() const noexcept {
+  return vertices + triangles + spheres + materials + lights + acceleration;
+}
+
+std::size_t SceneMemory::Owned() const noexcept {
+  return Total() - mapped;
+}
+
+SceneMemory EstimateSceneMemory(std::size_t vertices, std::size_t normals, std::size_t triangles,
+                                bool lods) noexcept {
+  if (lods) {
+    // Each level keeps about a quarter of the triangles of the one before, 1/3 more in all, and adds the vertices it
+    // moved.
+    vertices += vertices / 3;
+    triangles += triangles / 3;
+  }
+  SceneMemory memory;
+  memory.vertices = vertices * sizeof(geom::Vector) + normals * sizeof(std::uint32_t);
+  memory.triangles = triangles * (2 * sizeof(std::array<std::uint32_t, 3>) + sizeof(MaterialId));
+  // The mesh lists the triangle, the hierarchy lists it again and has about one node for it.
+  memory.acceleration = triangles * (2 * sizeof(std::uint32_t) + sizeof(accel::BvhNode));
+  return memory;
+}
+
+void PrintBytes(std::size_t bytes, std::ostream& out) {
+  auto flags = out.flags();
+  auto precision = out.precision();
+  constexpr std::array<const char*, 4> kUnits = {"B", "KiB", "MiB", "GiB"};
+  auto value = static_cast<double>(bytes);
+  std::size_t unit = 0;
+  for (; unit + 1 < kUnits.size() && value >= 1024; ++unit) {
+    value /= 1024;
+  }
+  out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << value << ' ' << kUnits[unit];
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void PrintSceneMemory(const SceneMemory& memory, std::size_t framebuffer_bytes, std::ostream& out) {
+  auto line = [&out](const char* name, std::size_t bytes) {
+    out << "  " << std::left << std::setw(14) << name << std::right << std::setw(14);
+    PrintBytes(bytes, out);
+    out << '\n';
+  };
+  auto flags = out.flags();
+  line("vertices", memory.vertices);
+  line("triangles", memory.triangles);
+  line("spheres", memory.spheres);
+  line("materials", memory.materials);
+  line("lights", memory.lights);
+  line("acceleration", memory.acceleration);
+  if (framebuffer_bytes != 0) {
+    line("framebuffers", framebuffer_bytes);
+  }
+  line("total", memory.Total() + framebuffer_bytes);
+  if (memory.mapped != 0) {
+    line("of it mapped", memory.mapped);
+  }
+  out.flags(flags);
+}
+
+}  // namespace rt
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+
+namespace rt {
+
+// Bytes a scene holds, by part. Owned arrays count at their capacity; arrays in the scene's arena or in a mapped
+// geometry file count at their size.
+struct SceneMemory {
+  std::size_t vertices = 0;      // positions and normal codes
+  std::size_t triangles = 0;     // index triples and material ids, one of each per triangle
+  std::size_t spheres = 0;       // the spheres and their batched copy
+  std::size_t materials = 0;     // with their names
+  std::size_t lights = 0;
+  std::size_t acceleration = 0;  // triangle lists and hierarchies of the meshes and their levels, instances included
+  std::size_t mapped = 0;        // part of the above in a mapped geometry file, paged in and out by the kernel
+
+  [[nodiscard]] std::size_t Total() const noexcept;
+  // Total() less the mapped part: what the scene costs whatever is paged in. Memory budgets apply to this.
+  [[nodiscard]] std::size_t Owned() const noexcept;
+};
+
+// Memory of a scene with the given counts as ReadScene() builds it, with levels of detail if lods is set. Exact for
+// the triangles and vertices; the hierarchies are taken at one node per triangle, which is about what they get.
+// Spheres, materials and lights are left out, they are small next to any mesh that matters.
+[[nodiscard]] SceneMemory EstimateSceneMemory(std::size_t vertices, std::size_t normals, std::size_t triangles,
+                                              bool lods) noexcept;
+
+// Bytes in the largest binary unit they make one of, e.g. "12.5 MiB" or "640 B".
+void PrintBytes(std::size_t bytes, std::ostream& out);
+// A line per part and the total. framebuffer_bytes, e.g. from GetFramebufferBytes(), is added as a line of its own
+// when not zero.
+void PrintSceneMemory(const SceneMemory& memory, std::size_t framebuffer_bytes, std::ostream& out);
+
+}  // namespace rt
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <accel/bvh.hpp>
+#include <geometry/bounds.hpp>
+#include <raytracer/matrix.hpp>
+#include <util/mapped_vector.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+// Simplified version of a mesh, see BuildLods(). Its triangles are stored with all others in Scene::GetObjects().
+struct MeshLod {
+  MeshLod(util::MappedVector<std::uint32_t> objects, double error) noexcept
+    : objects(std::move(objects)), error(error) {
+  }
+
+  util::MappedVector<std::uint32_t> objects;
+  accel::Bvh bvh;
+  double error;  // bound on how far the surface moved, in the coordinates of the mesh
+};
+
+// Triangles of one o/g group. They are stored once in Scene::GetObjects(); the mesh keeps their indices and its
+// bottom-level hierarchy over them, in the coordinates they were written in.
+struct Mesh {
+  Mesh(std::string name, util::MappedVector<std::uint32_t> objects) noexcept
+    : name(std::move(name)), objects(std::move(objects)) {
+  }
+
+  std::string name;
+  util::MappedVector<std::uint32_t> objects;
+  accel::Bvh bvh;
+  std::vector<MeshLod> lods;  // coarser levels of detail, each with fewer triangles and a larger error
+};
+
+// Placement of a mesh in the world. Every group is placed once where it is written, `I` lines add more copies.
+struct Instance {
+  Instance(std::uint32_t mesh, const Matrix& object_to_world) noexcept
+    : mesh(mesh),
+      object_to_world(object_to_world),
+      world_to_object(Inverse(object_to_world)),
+      identity(IsIdentity(object_to_world)) {
+  }
+
+  std::uint32_t mesh;
+  Matrix object_to_world;
+  Matrix world_to_object;
+  bool identity;
+  geom::Bounds bounds;  // world space
+};
+
+}  // namespace rt
@@ -15,14 +15,14 @@ struct Object {
   }
 
   std::array<std::optional<geom::Vector>, 3> normals;
-  const Material* material = nullptr;
+  MaterialId material = 0;
   geom::Triangle polygon;
 };
 
 struct SphereObject {
-  SphereObject(const Material* m, geom::Vector c, double r) noexcept : material(m), sphere(std::move(c), r) {
+  SphereObject(MaterialId m, geom::Vector c, double r) noexcept : material(m), sphere(std::move(c), r) {
   }
-  const Material* material = nullptr;
+  MaterialId material = 0;
   geom::Sphere sphere;
 };
 
@@ -1,19 +1,108 @@
 #include <geometry/vector.hpp>
+#include <scene/geometry_file.hpp>
+#include <scene/indexed_mesh.hpp>
+#include <scene/material_table.hpp>
+#include <scene/memory.hpp>
 #include <scene/reader.hpp>
+#include <scene/simplify.hpp>
+#include <util/arena.hpp>
+#include <util/profile.hpp>
+#include <util/trace.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
-#include <map>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace rt {
 
 namespace {
 
-[[nodiscard]] std::size_t GetIndex(int ind, std::size_t size) noexcept {
-  return ind > 0 ? ind - 1 : size + ind;
+// A face as written: indices from 1, or negative ones counting back from the last vertex or normal parsed before it,
+// 32-bit as on f lines. The chunk's counts at the face make both resolvable once the earlier chunks are parsed, and
+// bound them, since a face may only refer back.
+struct ChunkTriangle {
+  std::array<std::int32_t, 3> vertices;
+  std::optional<std::array<std::int32_t, 3>> normals;
+  std::uint32_t vertex_count;
+  std::uint32_t normal_count;
+};
+
+// A line whose meaning depends on the lines before it (usemtl, mtllib, o, g, I, P, S). These are replayed in file
+// order after parsing; `triangles` is the number of triangles of the chunk that precede the line.
+struct StatefulLine {
+  std::size_t triangles;
+  std::string line;
+};
+
+// Everything parsed from a run of whole lines of the file.
+struct Chunk {
+  std::vector<geom::Vector> vertices;
+  std::vector<geom::Vector> normals;
+  std::vector<ChunkTriangle> triangles;
+  std::vector<StatefulLine> lines;
+};
+
+// Bytes held by a chunk, counting reserved capacity. Stateful lines are few and counted without their text.
+[[nodiscard]] std::size_t GetChunkBytes(const Chunk& chunk) noexcept {
+  return (chunk.vertices.capacity() + chunk.normals.capacity()) * sizeof(geom::Vector) +
+         chunk.triangles.capacity() * sizeof(ChunkTriangle) + chunk.lines.capacity() * sizeof(StatefulLine);
+}
+
+[[nodiscard]] std::string OverBudget(std::string_view filename, std::string_view what, std::size_t bytes,
+                                     std::size_t budget) {
+  std::ostringstream message;
+  message << filename << ": " << what << ' ';
+  PrintBytes(bytes, message);
+  message << ", over the memory budget of ";
+  PrintBytes(budget, message);
+  return message.str();
+}
+
+// Bytes held by all chunks being parsed, shared by the parser threads, so that a file too large for the memory budget
+// is given up part way through rather than once it is all in memory.
+class ParseBudget {
+ public:
+  ParseBudget(std::string_view filename, std::size_t limit) noexcept : filename_(filename), limit_(limit) {
+  }
+
+  // Records that a chunk that held *charged bytes now holds bytes, which is no less. Throws once the chunks together
+  // hold more than the limit.
+  void Update(std::size_t* charged, std::size_t bytes) {
+    if (limit_ == 0) {
+      return;
+    }
+    std::size_t used = used_.fetch_add(bytes - *charged, std::memory_order_relaxed) + bytes - *charged;
+    *charged = bytes;
+    if (used > limit_) {
+      throw std::runtime_error(OverBudget(filename_, "parsing takes at least", used, limit_));
+    }
+  }
+
+ private:
+  std::string_view filename_;
+  std::size_t limit_;
+  std::atomic<std::size_t> used_ = 0;
+};
+
+[[nodiscard]] std::int32_t ToFaceIndex(int ind) {
+  if (ind == 0) {
+    throw std::runtime_error("face index out of range");
+  }
+  return ind;
 }
 
 void ReadOne(std::istringstream& ss, int& ind, std::optional<int>& tx, std::optional<int>& n) noexcept {
@@ -32,25 +121,33 @@ void ReadOne(std::istringstream& ss, int& ind, std::optional<int>& tx, std::opti
   }
 }
 
-Object MakeObject(const int& ind_0, const std::optional<int>& n_0, const int& ind_1, const std::optional<int>& n_1,
-                  const int& ind_2, const std::optional<int>& n_2, std::vector<geom::Vector>& vertices,
-                  std::vector<geom::Vector>& normals, const Material* current_material) {
-  geom::Triangle tr({vertices[GetIndex(ind_0, vertices.size())], vertices[GetIndex(ind_1, vertices.size())],
-                     vertices[GetIndex(ind_2, vertices.size())]});
-  std::array<std::optional<geom::Vector>, 3> norm;
-  if (n_0.has_value()) {
-    norm[0] = normals[GetIndex(n_0.value(), normals.size())];
-    norm[1] = normals[GetIndex(n_1.value(), normals.size())];
-    norm[2] = normals[GetIndex(n_2.value(), normals.size())];
-  }
-  return Object{norm, current_material, tr};
+// `I name tx ty tz` places a copy of group `name` shifted by (tx, ty, tz); `I name` followed by twelve numbers
+// gives the rows of the full rt::Matrix (three basis rows, then the translation row).
+Matrix ReadInstanceTransform(std::istringstream& ss) {
+  std::vector<double> values;
+  double value;
+  while (ss >> value) {
+    values.push_back(value);
+  }
+  if (values.size() != 3 && values.size() != 12) {
+    throw std::runtime_error("instance needs 3 or 12 numbers");
+  }
+  Matrix transform = MakeIdentity();
+  std::size_t row = values.size() == 3 ? 3 : 0;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    transform[row + i / 3][i % 3] = values[i];
+  }
+  if (!IsInvertible(transform)) {
+    throw std::runtime_error("instance transform is singular");
+  }
+  return transform;
 }
 
-std::map<std::string, Material> ReadMaterials(std::string_view filename) {
+void ReadMaterials(std::string_view filename, MaterialTable& materials) {
+  RT_TRACE_SPAN("materials", std::string(filename));
   std::fstream file(std::string(filename), std::ios::in);
   std::string str;
 
-  std::map<std::string, Material> materials;
   std::string name;
   geom::Vector ambient_color{0, 0, 0};
   geom::Vector diffuse_color{0, 0, 0};
@@ -66,8 +163,8 @@ std::map<std::string, Material> ReadMaterials(std::string_view filename) {
     ss >> w;
     if (w == "newmtl") {
       if (flag) {
-        materials[name] = {name,      ambient_color,     diffuse_color,    specular_color,
-                           intensity, specular_exponent, refraction_index, albedo};
+        materials.Add({name, ambient_color, diffuse_color, specular_color, intensity, specular_exponent,
+                       refraction_index, albedo});
         ambient_color = {0, 0, 0};
         diffuse_color = {0, 0, 0};
         specular_color = {0, 0, 0};
@@ -104,29 +201,29 @@ std::map<std::string, Material> ReadMaterials(std::string_view filename) {
       albedo = {x, y, z};
     }
   }
-  materials[name] = {name,      ambient_color,     diffuse_color,    specular_color,
-                     intensity, specular_exponent, refraction_index, albedo};
-  return materials;
+  if (flag) {
+    materials.Add(
+      {name, ambient_color, diffuse_color, specular_color, intensity, specular_exponent, refraction_index, albedo});
+  }
 }
 
-}  // namespace
-
-Scene ReadScene(std::string_view filename) {
-  std::vector<Object> objects;
-  std::vector<SphereObject> sphere_objects;
-  std::vector<Light> lights;
-  std::map<std::string, Material> materials;
-
-  const Material* current_material = nullptr;
-  std::string mtl_filename;
-  std::vector<geom::Vector> vertices;
-  std::vector<geom::Vector> normals;
-  std::fstream file(std::string(filename), std::ios::in);
+Chunk ParseChunk(const std::string& filename, std::uintmax_t begin, std::uintmax_t end, ParseBudget* budget) {
+  constexpr std::size_t kBudgetInterval = 1 << 12;  // lines
+  util::PhaseScope phase(util::Phase::kSceneLoad);  // also on the parser threads
+  RT_TRACE_SPAN("parse");
+  std::fstream file(filename, std::ios::in);
   if (!file.good()) {
     throw std::runtime_error("file is not open");
   }
+  file.seekg(static_cast<std::streamoff>(begin));
+  Chunk chunk;
   std::string str;
-  while (std::getline(file, str)) {
+  std::size_t charged = 0;
+  std::size_t lines = 0;
+  for (std::uintmax_t position = begin; position < end && std::getline(file, str); position += str.size() + 1) {
+    if (++lines % kBudgetInterval == 0) {
+      budget->Update(&charged, GetChunkBytes(chunk));
+    }
     std::istringstream ss(str);
     std::string w;
     ss >> w;
@@ -134,20 +231,12 @@ Scene ReadScene(std::string_view filename) {
       double x, y, z;
       ss >> x >> y >> z;
       if (w == "v") {
-        vertices.push_back(geom::Vector{x, y, z});
+        chunk.vertices.push_back(geom::Vector{x, y, z});
       } else {
         geom::Vector n{x, y, z};
         n.Normalize();
-        normals.push_back(n);
+        chunk.normals.push_back(n);
       }
-    } else if (w == "mtllib") {
-      ss >> mtl_filename;
-      std::filesystem::path p(filename);
-      materials = ReadMaterials(p.parent_path().string() + "/" + mtl_filename);
-    } else if (w == "usemtl") {
-      std::string material;
-      ss >> material;
-      current_material = &materials[material];
     } else if (w == "f") {
       int ind_0;
       std::optional<int> tx_0, n_0;
@@ -161,7 +250,14 @@ Scene ReadScene(std::string_view filename) {
       do {
         ReadOne(ss, ind_2, tx_2, n_2);
         if (ind_1 != ind_2) {
-          objects.emplace_back(MakeObject(ind_0, n_0, ind_1, n_1, ind_2, n_2, vertices, normals, current_material));
+          ChunkTriangle triangle{{ToFaceIndex(ind_0), ToFaceIndex(ind_1), ToFaceIndex(ind_2)},
+                                 std::nullopt,
+                                 static_cast<std::uint32_t>(chunk.vertices.size()),
+                                 static_cast<std::uint32_t>(chunk.normals.size())};
+          if (n_0.has_value()) {
+            triangle.normals = {ToFaceIndex(n_0.value()), ToFaceIndex(n_1.value()), ToFaceIndex(n_2.value())};
+          }
+          chunk.triangles.push_back(triangle);
         }
         ind_1 = ind_2;
         tx_1 = tx_2;
@@ -169,17 +265,295 @@ Scene ReadScene(std::string_view filename) {
 
       } while (!ss.eof());
 
+    } else if (w == "mtllib" || w == "usemtl" || w == "o" || w == "g" || w == "I" || w == "P" || w == "S") {
+      chunk.lines.push_back({chunk.triangles.size(), str});
+    }
+  }
+  budget->Update(&charged, GetChunkBytes(chunk));
+  return chunk;
+}
+
+// Chunk boundaries: about equal byte ranges, each moved forward to the start of a line.
+std::vector<std::uintmax_t> SplitAtLines(const std::string& filename, std::uintmax_t size, std::size_t chunks) {
+  std::vector<std::uintmax_t> bounds{0};
+  std::fstream file(filename, std::ios::in);
+  for (std::size_t i = 1; i < chunks; ++i) {
+    std::uintmax_t bound = size / chunks * i;
+    if (bound <= bounds.back()) {
+      continue;
+    }
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(bound - 1));
+    std::string rest;
+    std::getline(file, rest);
+    bound += rest.size();
+    if (!file || bound >= size) {
+      break;
+    }
+    bounds.push_back(bound);
+  }
+  bounds.push_back(size);
+  return bounds;
+}
+
+// Name of the group an o or g line selects, read from after the keyword.
+[[nodiscard]] std::string ReadGroupName(std::istringstream& ss) {
+  std::string name = "default";
+  ss >> name;
+  return name;
+}
+
+struct GeometryCounts {
+  std::size_t vertices = 0;
+  std::size_t normals = 0;
+  std::size_t triangles = 0;
+  std::unordered_map<std::string, std::size_t> group_triangles;
+};
+
+[[nodiscard]] GeometryCounts CountGeometry(const std::vector<Chunk>& chunks) {
+  GeometryCounts counts;
+  // Faces before the first o or g line go to the default group, as SceneBuilder assigns them.
+  std::string group = "default";
+  for (const auto& chunk : chunks) {
+    counts.vertices += chunk.vertices.size();
+    counts.normals += chunk.normals.size();
+    counts.triangles += chunk.triangles.size();
+    std::size_t triangle = 0;
+    for (const auto& line : chunk.lines) {
+      counts.group_triangles[group] += line.triangles - triangle;
+      triangle = line.triangles;
+      std::istringstream ss(line.line);
+      std::string w;
+      ss >> w;
+      if (w == "o" || w == "g") {
+        group = ReadGroupName(ss);
+      }
+    }
+    counts.group_triangles[group] += chunk.triangles.size() - triangle;
+  }
+  return counts;
+}
+
+void CheckMemoryBudget(const Scene& scene, std::string_view filename, std::size_t budget) {
+  std::size_t owned = scene.GetMemory().Owned();
+  if (budget != 0 && owned > budget) {
+    throw std::runtime_error(OverBudget(filename, "the scene needs", owned, budget));
+  }
+}
+
+// Merges chunks in file order into the scene, carrying usemtl and group state from one chunk into the next.
+class SceneBuilder {
+ public:
+  explicit SceneBuilder(std::string_view filename)
+    : filename_(filename), arena_(std::make_shared<util::Arena>()) {
+  }
+
+  // Allocates the triangle buffers and the triangle lists of the groups in one block of the scene's arena, sized for
+  // all chunks, so that merging them neither reallocates nor leaves a copy to make once the scene is built. With lods
+  // there is room for the levels of detail as EstimateSceneMemory() expects them; levels that need more move the
+  // buffers they outgrow out of the arena.
+  void Reserve(GeometryCounts counts, bool lods) {
+    using Triple = std::array<std::uint32_t, 3>;
+    std::size_t vertices = counts.vertices + (lods ? counts.vertices / 3 : 0);
+    std::size_t triangles = counts.triangles + (lods ? counts.triangles / 3 : 0);
+    std::size_t bytes = util::ArenaBytes<geom::Vector>(vertices) + util::ArenaBytes<std::uint32_t>(counts.normals) +
+                        2 * util::ArenaBytes<Triple>(triangles) + util::ArenaBytes<MaterialId>(triangles);
+    for (const auto& [name, size] : counts.group_triangles) {
+      bytes += util::ArenaBytes<std::uint32_t>(size);
+    }
+    arena_->Reserve(bytes);
+    objects_ = IndexedMesh(util::AllocateVector<geom::Vector>(arena_, vertices),
+                           util::AllocateVector<std::uint32_t>(arena_, counts.normals),
+                           util::AllocateVector<Triple>(arena_, triangles),
+                           util::AllocateVector<Triple>(arena_, triangles),
+                           util::AllocateVector<MaterialId>(arena_, triangles));
+    group_triangles_ = std::move(counts.group_triangles);
+  }
+
+  void Add(Chunk& chunk) {
+    std::size_t vertex_offset = objects_.VertexCount();
+    std::size_t normal_offset = objects_.NormalCount();
+    for (const auto& vertex : chunk.vertices) {
+      objects_.AddVertex(vertex);
+    }
+    for (const auto& normal : chunk.normals) {
+      objects_.AddNormal(normal);
+    }
+    std::size_t triangle = 0;
+    for (const auto& line : chunk.lines) {
+      for (; triangle < line.triangles; ++triangle) {
+        AddTriangle(chunk.triangles[triangle], vertex_offset, normal_offset);
+      }
+      ApplyLine(line.line);
+    }
+    for (; triangle < chunk.triangles.size(); ++triangle) {
+      AddTriangle(chunk.triangles[triangle], vertex_offset, normal_offset);
+    }
+  }
+
+  Scene Build(bool build_lods) && {
+    std::vector<Mesh> meshes;
+    std::vector<Instance> instances;
+    for (std::uint32_t i = 0; i < groups_.size(); ++i) {
+      meshes.emplace_back(groups_[i].first, std::move(groups_[i].second));
+      if (build_lods) {
+        meshes.back().lods = BuildLods(meshes.back().objects, &objects_);
+      }
+      instances.emplace_back(i, MakeIdentity());
+    }
+    for (const auto& [name, transform] : placements_) {
+      auto it = group_indices_.find(name);
+      if (it == group_indices_.end()) {
+        throw std::runtime_error("instance of unknown group " + name);
+      }
+      instances.emplace_back(it->second, transform);
+    }
+    return Scene{std::move(objects_), std::move(sphere_objects_), std::move(lights_), std::move(materials_),
+                 std::move(meshes),   std::move(instances),      std::move(arena_)};
+  }
+
+ private:
+  // Index into the file's vertices or normals, of which the face may see the first offset + count.
+  [[nodiscard]] static std::uint32_t Resolve(std::int32_t index, std::size_t offset, std::size_t count) {
+    auto seen = static_cast<std::int64_t>(offset + count);
+    std::int64_t global = index > 0 ? index - 1 : seen + index;
+    if (global < 0 || global >= seen) {
+      throw std::runtime_error("face index out of range");
+    }
+    return static_cast<std::uint32_t>(global);
+  }
+
+  void AddTriangle(const ChunkTriangle& triangle, std::size_t vertex_offset, std::size_t normal_offset) {
+    if (!current_group_) {
+      SelectGroup("default");
+    }
+    std::array<std::uint32_t, 3> vertices;
+    std::array<std::uint32_t, 3> normals{IndexedMesh::kNoNormal, IndexedMesh::kNoNormal, IndexedMesh::kNoNormal};
+    for (std::size_t i = 0; i < 3; ++i) {
+      vertices[i] = Resolve(triangle.vertices[i], vertex_offset, triangle.vertex_count);
+      if (triangle.normals) {
+        normals[i] = Resolve((*triangle.normals)[i], normal_offset, triangle.normal_count);
+      }
+    }
+    groups_[*current_group_].second.push_back(objects_.size());
+    objects_.AddTriangle(vertices, normals, current_material_);
+  }
+
+  void SelectGroup(const std::string& name) {
+    auto [it, inserted] = group_indices_.try_emplace(name, groups_.size());
+    if (inserted) {
+      auto size = group_triangles_.find(name);
+      groups_.emplace_back(name, util::AllocateVector<std::uint32_t>(
+                                   arena_, size != group_triangles_.end() ? size->second : 0));
+    }
+    current_group_ = it->second;
+  }
+
+  void ApplyLine(const std::string& str) {
+    std::istringstream ss(str);
+    std::string w;
+    ss >> w;
+    if (w == "mtllib") {
+      std::string mtl_filename;
+      ss >> mtl_filename;
+      std::filesystem::path p(filename_);
+      ReadMaterials((p.parent_path() / mtl_filename).string(), materials_);
+    } else if (w == "usemtl") {
+      std::string material;
+      ss >> material;
+      auto found = materials_.Find(material);
+      if (!found) {
+        throw std::runtime_error("unknown material " + material);
+      }
+      current_material_ = *found;
+    } else if (w == "o" || w == "g") {
+      SelectGroup(ReadGroupName(ss));
+    } else if (w == "I") {
+      std::string name;
+      ss >> name;
+      placements_.emplace_back(name, ReadInstanceTransform(ss));
     } else if (w == "P") {
       double x, y, z, r, g, b;
       ss >> x >> y >> z >> r >> g >> b;
-      lights.emplace_back(geom::Vector{x, y, z}, geom::Vector{r, g, b});
+      lights_.emplace_back(geom::Vector{x, y, z}, geom::Vector{r, g, b});
     } else if (w == "S") {
       double x, y, z, r;
       ss >> x >> y >> z >> r;
-      sphere_objects.emplace_back(current_material, geom::Vector{x, y, z}, r);
+      sphere_objects_.emplace_back(current_material_, geom::Vector{x, y, z}, r);
+    }
+  }
+
+  std::string filename_;
+  std::shared_ptr<util::Arena> arena_;
+  std::unordered_map<std::string, std::size_t> group_triangles_;
+  IndexedMesh objects_;
+  std::vector<SphereObject> sphere_objects_;
+  std::vector<Light> lights_;
+  MaterialTable materials_;
+
+  MaterialId current_material_ = MaterialTable::kDefault;
+  std::vector<std::pair<std::string, util::MappedVector<std::uint32_t>>> groups_;
+  std::unordered_map<std::string, std::uint32_t> group_indices_;
+  std::optional<std::uint32_t> current_group_;
+  std::vector<std::pair<std::string, Matrix>> placements_;
+};
+
+}  // namespace
+
+Scene ReadScene(std::string_view filename, const ReaderOptions& options) {
+  util::PhaseScope phase(util::Phase::kSceneLoad);
+  RT_TRACE_SPAN("load scene", std::string(filename));
+  std::string path(filename);
+  if (std::filesystem::path(path).extension() == ".rtg") {
+    Scene scene = MapScene(path, options.resident_limit);
+    CheckMemoryBudget(scene, filename, options.memory_budget);
+    return scene;
+  }
+  std::error_code error;
+  std::uintmax_t size = std::filesystem::file_size(path, error);
+  if (error) {
+    throw std::runtime_error("file is not open");
+  }
+  std::size_t threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  std::size_t min_chunk_size = std::max<std::size_t>(options.min_chunk_size, 1);
+  std::size_t chunks = std::clamp<std::uintmax_t>(size / min_chunk_size, 1, threads);
+  std::vector<std::uintmax_t> bounds = SplitAtLines(path, size, chunks);
+
+  ParseBudget budget(filename, options.memory_budget);
+  std::vector<Chunk> parsed;
+  if (bounds.size() == 2) {
+    parsed.push_back(ParseChunk(path, 0, size, &budget));
+  } else {
+    std::vector<std::future<Chunk>> futures;
+    for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+      futures.push_back(
+        std::async(std::launch::async, ParseChunk, std::cref(path), bounds[i], bounds[i + 1], &budget));
+    }
+    for (auto& future : futures) {
+      parsed.push_back(future.get());
     }
   }
-  return Scene{std::move(objects), std::move(sphere_objects), std::move(lights), std::move(materials)};
+  GeometryCounts counts = CountGeometry(parsed);
+  bool build_lods = options.build_lods;
+  if (options.memory_budget != 0) {
+    // Estimated before any of the scene is built.
+    auto estimate = [&counts](bool lods) {
+      return EstimateSceneMemory(counts.vertices, counts.normals, counts.triangles, lods).Owned();
+    };
+    build_lods = build_lods && estimate(true) <= options.memory_budget;
+    if (estimate(false) > options.memory_budget) {
+      throw std::runtime_error(OverBudget(filename, "the scene needs about", estimate(false), options.memory_budget));
+    }
+  }
+  SceneBuilder builder(filename);
+  builder.Reserve(std::move(counts), build_lods);
+  for (auto& chunk : parsed) {
+    builder.Add(chunk);
+    chunk = Chunk{};
+  }
+  Scene scene = std::move(builder).Build(build_lods);
+  CheckMemoryBudget(scene, filename, options.memory_budget);
+  return scene;
 }
 
 }  // namespace rt
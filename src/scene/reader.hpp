@@ -2,10 +2,28 @@
 
 #include <scene/scene.hpp>
 
+#include <cstddef>
 #include <string_view>
 
 namespace rt {
 
-Scene ReadScene(std::string_view filename);
+struct ReaderOptions {
+  // Threads parsing the file, 0 for one per hardware thread. Each gets a run of whole lines of at least
+  // min_chunk_size bytes, so small files are read by a single thread. The scene does not depend on either value.
+  std::size_t threads = 0;
+  std::size_t min_chunk_size = std::size_t{1} << 22;
+  // Geometry files (.rtg) are mapped rather than parsed; this caps their resident bytes, 0 for no cap.
+  std::size_t resident_limit = 0;
+  // Builds simplified levels of detail of every large enough group, see BuildLods(), for renders to trace distant
+  // instances with; see RenderOptions::lod_pixel_error. Geometry files keep full detail only.
+  bool build_lods = false;
+  // Bytes the scene may hold, see Scene::GetMemory(), 0 for no limit; the mapped part of a geometry file is not
+  // counted. Loading checks the parsed lines as it goes, the estimated scene once the file is parsed and the built
+  // scene at the end, and throws std::runtime_error at the first that is over. If the estimate is over only because of
+  // levels of detail, the scene is built without them instead.
+  std::size_t memory_budget = 0;
+};
+
+Scene ReadScene(std::string_view filename, const ReaderOptions& options = {});
 
 }  // namespace rt
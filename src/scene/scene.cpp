@@ -0,0 +1,409 @@
+#include <geometry/geometry.hpp>
+#include <scene/scene.hpp>
+#include <util/profile.hpp>
+#include <util/trace.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace rt {
+
+namespace {
+
+struct ObjectRay {
+  geom::Ray ray;
+  double scale;  // object-space length of a unit step along the world ray
+};
+
+[[nodiscard]] ObjectRay ToObject(const Instance& instance, const geom::Ray& ray) noexcept {
+  geom::Vector direction = instance.world_to_object.multiply_direction(ray.GetDirection());
+  return {geom::Ray{instance.world_to_object.multiply_vector(ray.GetOrigin()), direction}, Length(direction)};
+}
+
+// Normals go through the inverse transpose: n_i = sum_j W[i][j] * n_j for the world-to-object matrix W.
+[[nodiscard]] geom::Vector TransformNormal(const Matrix& world_to_object, const geom::Vector& normal) noexcept {
+  geom::Vector result;
+  for (std::size_t i = 0; i < 3; ++i) {
+    const auto& row = world_to_object[i];
+    result[i] = row[0] * normal[0] + row[1] * normal[1] + row[2] * normal[2];
+  }
+  result.Normalize();
+  return result;
+}
+
+[[nodiscard]] geom::Bounds TransformBounds(const Matrix& m, const geom::Bounds& bounds) noexcept {
+  geom::Bounds result;
+  for (int corner = 0; corner < 8; ++corner) {
+    geom::Vector point{(corner & 1) ? bounds.Max()[0] : bounds.Min()[0],
+                       (corner & 2) ? bounds.Max()[1] : bounds.Min()[1],
+                       (corner & 4) ? bounds.Max()[2] : bounds.Min()[2]};
+    result.Extend(m.multiply_vector(point));
+  }
+  return result;
+}
+
+// Triangles and hierarchy a mesh is traced with at a level of detail, 0 being the mesh itself.
+struct MeshLevel {
+  const util::MappedVector<std::uint32_t>& objects;
+  const accel::Bvh& bvh;
+};
+
+[[nodiscard]] MeshLevel GetLevel(const Mesh& mesh, std::span<const std::uint8_t> lod_levels,
+                                 std::uint32_t instance) noexcept {
+  std::uint8_t level = lod_levels.empty() ? 0 : lod_levels[instance];
+  if (level == 0) {
+    return {mesh.objects, mesh.bvh};
+  }
+  const MeshLod& lod = mesh.lods[level - 1];
+  return {lod.objects, lod.bvh};
+}
+
+// Simplified levels may bulge out of the full mesh, so instances are bounded by all of them.
+[[nodiscard]] geom::Bounds GetMeshBounds(const Mesh& mesh) noexcept {
+  geom::Bounds bounds = mesh.bvh.GetBounds();
+  for (const auto& lod : mesh.lods) {
+    bounds.Extend(lod.bvh.GetBounds());
+  }
+  return bounds;
+}
+
+// Largest factor by which a transform stretches a direction, the top singular value of its linear part, found by
+// power iteration on M^T M.
+[[nodiscard]] double MaxStretch(const Matrix& m) noexcept {
+  geom::Vector direction{1, 1, 1};
+  double stretch = 0;
+  for (int i = 0; i < 32; ++i) {
+    direction.Normalize();
+    geom::Vector image = m.multiply_direction(direction);
+    stretch = Length(image);
+    // Directions multiply rows from the left, so the transpose multiplies columns.
+    for (std::size_t i = 0; i < 3; ++i) {
+      direction[i] = m[i][0] * image[0] + m[i][1] * image[1] + m[i][2] * image[2];
+    }
+    if (Length(direction) == 0) {
+      break;
+    }
+  }
+  return stretch;
+}
+
+[[nodiscard]] double DistanceTo(const geom::Bounds& bounds, const geom::Vector& point) noexcept {
+  geom::Vector offset;
+  for (std::size_t i = 0; i < 3; ++i) {
+    offset[i] = std::max({bounds.Min()[i] - point[i], 0.0, point[i] - bounds.Max()[i]});
+  }
+  return Length(offset);
+}
+
+[[nodiscard]] bool Closer(double distance, std::uint32_t instance, std::uint32_t object,
+                          const std::optional<ObjectHit>& best) noexcept {
+  if (!best || distance < best->distance) {
+    return true;
+  }
+  return distance == best->distance &&
+         (object < best->object || (object == best->object && instance < best->instance));
+}
+
+}  // namespace
+
+Scene::Scene(IndexedMesh objects, std::vector<SphereObject> sphere_objects, std::vector<Light> lights,
+             MaterialTable materials, std::vector<Mesh> meshes, std::vector<Instance> instances,
+             std::shared_ptr<util::Arena> arena)
+  : objects_(std::move(objects)),
+    sphere_objects_(std::move(sphere_objects)),
+    lights_(std::move(lights)),
+    materials_(std::move(materials)),
+    meshes_(std::move(meshes)),
+    instances_(std::move(instances)),
+    arena_(arena ? std::move(arena) : std::make_shared<util::Arena>()) {
+  if (meshes_.empty() && !objects_.empty()) {
+    std::vector<std::uint32_t> all(objects_.size());
+    for (std::uint32_t i = 0; i < all.size(); ++i) {
+      all[i] = i;
+    }
+    meshes_.emplace_back("default", std::move(all));
+    instances_.emplace_back(0, MakeIdentity());
+  }
+  sphere_batch_.Reserve(sphere_objects_.size());
+  for (const auto& sphere_object : sphere_objects_) {
+    sphere_batch_.Add(sphere_object.sphere);
+  }
+  BuildAcceleration();
+}
+
+accel::Bvh Scene::BuildMeshBvh(const util::MappedVector<std::uint32_t>& objects) const {
+  std::vector<geom::Bounds> bounds;
+  bounds.reserve(objects.size());
+  for (std::uint32_t object : objects) {
+    bounds.push_back(GetBounds(objects_.GetTriangle(object)));
+  }
+  return accel::Bvh(bounds);
+}
+
+void Scene::BuildAcceleration() {
+  util::PhaseScope phase(util::Phase::kAccelerationBuild);
+  RT_TRACE_SPAN("bvh build");
+  auto start = std::chrono::steady_clock::now();
+  for (auto& mesh : meshes_) {
+    if (!mesh.bvh.Empty()) {
+      continue;  // stored with the mesh
+    }
+    mesh.bvh = BuildMeshBvh(mesh.objects);
+    for (auto& lod : mesh.lods) {
+      lod.bvh = BuildMeshBvh(lod.objects);
+    }
+    MoveIntoArena(mesh);
+  }
+  // Instances of empty groups keep their place, so indices follow the file, but have nothing to bound.
+  std::vector<geom::Bounds> bounds;
+  bounds.reserve(instances_.size());
+  bvh_instances_.clear();
+  for (std::uint32_t i = 0; i < instances_.size(); ++i) {
+    Instance& instance = instances_[i];
+    if (meshes_[instance.mesh].bvh.Empty()) {
+      continue;
+    }
+    instance.bounds = TransformBounds(instance.object_to_world, GetMeshBounds(meshes_[instance.mesh]));
+    bounds.push_back(instance.bounds);
+    bvh_instances_.push_back(i);
+  }
+  instance_bvh_ = accel::Bvh(bounds);
+  acceleration_build_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Scene::MoveIntoArena(Mesh& mesh) {
+  // One mesh at a time, so at most one mesh's buffers exist twice. The instance hierarchy stays owned:
+  // SetInstanceTransform() refits it in place.
+  auto for_each_buffer = [&mesh](auto&& visit) {
+    visit(mesh.objects);
+    mesh.bvh.ForEachBuffer(visit);
+    for (auto& lod : mesh.lods) {
+      visit(lod.objects);
+      lod.bvh.ForEachBuffer(visit);
+    }
+  };
+  std::size_t bytes = 0;
+  for_each_buffer([&bytes](const auto& buffer) {
+    bytes += util::ArenaBytes(buffer);
+  });
+  if (bytes == 0) {
+    return;
+  }
+  arena_->Reserve(bytes);
+  for_each_buffer([this](auto& buffer) {
+    util::MoveIntoArena(buffer, arena_);
+  });
+}
+
+std::vector<std::uint8_t> Scene::SelectLods(const geom::Vector& eye, double error_per_distance) const {
+  bool any_lods = std::any_of(meshes_.begin(), meshes_.end(), [](const Mesh& mesh) {
+    return !mesh.lods.empty();
+  });
+  if (!any_lods || !(error_per_distance > 0)) {
+    return {};
+  }
+  std::vector<std::uint8_t> levels(instances_.size(), 0);
+  for (std::size_t i = 0; i < instances_.size(); ++i) {
+    const Instance& instance = instances_[i];
+    const Mesh& mesh = meshes_[instance.mesh];
+    if (mesh.lods.empty()) {
+      continue;
+    }
+    double allowed = error_per_distance * DistanceTo(instance.bounds, eye);
+    double stretch = instance.identity ? 1 : MaxStretch(instance.object_to_world);
+    std::size_t level = 0;
+    while (level < mesh.lods.size() && mesh.lods[level].error * stretch <= allowed) {
+      ++level;
+    }
+    levels[i] = static_cast<std::uint8_t>(level);
+  }
+  return levels;
+}
+
+std::optional<ObjectHit> Scene::FindClosestObject(const geom::Ray& ray,
+                                                  std::span<const std::uint8_t> lod_levels) const noexcept {
+  std::optional<ObjectHit> best;
+  double t_max = std::numeric_limits<double>::infinity();
+  instance_bvh_.Traverse(ray, t_max, [&](std::uint32_t leaf) {
+    std::uint32_t instance_index = bvh_instances_[leaf];
+    const Instance& instance = instances_[instance_index];
+    MeshLevel mesh = GetLevel(meshes_[instance.mesh], lod_levels, instance_index);
+    if (instance.identity) {
+      mesh.bvh.Traverse(ray, t_max, [&](std::uint32_t i) {
+        std::uint32_t object = mesh.objects[i];
+        auto intersection = GetIntersection(ray, objects_.GetTriangle(object));
+        if (intersection && Closer(intersection->GetDistance(), instance_index, object, best)) {
+          best = ObjectHit{intersection->GetDistance(), instance_index, object};
+          t_max = best->distance;
+        }
+        return false;
+      });
+      return false;
+    }
+    ObjectRay local = ToObject(instance, ray);
+    double local_t_max = t_max * local.scale;
+    mesh.bvh.Traverse(local.ray, local_t_max, [&](std::uint32_t i) {
+      std::uint32_t object = mesh.objects[i];
+      auto intersection = GetIntersection(local.ray, objects_.GetTriangle(object));
+      if (intersection) {
+        double distance = intersection->GetDistance() / local.scale;
+        if (Closer(distance, instance_index, object, best)) {
+          best = ObjectHit{distance, instance_index, object};
+          t_max = distance;
+          local_t_max = intersection->GetDistance();
+        }
+      }
+      return false;
+    });
+    return false;
+  });
+  return best;
+}
+
+bool Scene::ObjectCovers(const geom::Ray& ray, double distance,
+                         std::span<const std::uint8_t> lod_levels) const noexcept {
+  bool covered = false;
+  instance_bvh_.Traverse(ray, distance, [&](std::uint32_t leaf) {
+    std::uint32_t instance_index = bvh_instances_[leaf];
+    const Instance& instance = instances_[instance_index];
+    MeshLevel mesh = GetLevel(meshes_[instance.mesh], lod_levels, instance_index);
+    if (instance.identity) {
+      mesh.bvh.Traverse(ray, distance, [&](std::uint32_t i) {
+        auto intersection = GetIntersection(ray, objects_.GetTriangle(mesh.objects[i]));
+        covered = intersection && intersection->GetDistance() < distance;
+        return covered;
+      });
+      return covered;
+    }
+    ObjectRay local = ToObject(instance, ray);
+    mesh.bvh.Traverse(local.ray, distance * local.scale, [&](std::uint32_t i) {
+      auto intersection = GetIntersection(local.ray, objects_.GetTriangle(mesh.objects[i]));
+      covered = intersection && intersection->GetDistance() / local.scale < distance;
+      return covered;
+    });
+    return covered;
+  });
+  return covered;
+}
+
+Object Scene::GetWorldObject(const ObjectHit& hit) const {
+  const Instance& instance = instances_[hit.instance];
+  Object object = objects_[hit.object];
+  if (instance.identity) {
+    return object;
+  }
+  Object world{{},
+               object.material,
+               {instance.object_to_world.multiply_vector(object.polygon.GetVertex(0)),
+                instance.object_to_world.multiply_vector(object.polygon.GetVertex(1)),
+                instance.object_to_world.multiply_vector(object.polygon.GetVertex(2))}};
+  for (std::size_t i = 0; i < 3; ++i) {
+    if (object.normals[i]) {
+      world.normals[i] = TransformNormal(instance.world_to_object, *object.normals[i]);
+    }
+  }
+  return world;
+}
+
+void Scene::AttachGeometryFile(std::shared_ptr<util::MappedFile> file) noexcept {
+  geometry_file_ = std::move(file);
+}
+
+void Scene::TrimGeometry() const {
+  if (geometry_file_) {
+    geometry_file_->Trim();
+  }
+}
+
+std::optional<util::PagingStats> Scene::GetPagingStats() const {
+  if (!geometry_file_) {
+    return std::nullopt;
+  }
+  return geometry_file_->GetStats();
+}
+
+void Scene::SetInstanceTransform(std::size_t instance, const Matrix& object_to_world) {
+  Instance& target = instances_.at(instance);
+  if (!IsInvertible(object_to_world)) {
+    throw std::invalid_argument("instance transform is singular");
+  }
+  target = Instance(target.mesh, object_to_world);
+  auto leaf = std::lower_bound(bvh_instances_.begin(), bvh_instances_.end(), instance);
+  if (leaf == bvh_instances_.end() || *leaf != instance) {
+    return;  // an empty group, not in the hierarchy
+  }
+  target.bounds = TransformBounds(object_to_world, GetMeshBounds(meshes_[target.mesh]));
+  instance_bvh_.Refit(static_cast<std::uint32_t>(leaf - bvh_instances_.begin()), [this](std::uint32_t i) {
+    return instances_[bvh_instances_[i]].bounds;
+  });
+}
+
+void Scene::SetSphere(std::size_t sphere, const geom::Vector& center, double radius) {
+  SphereObject& target = sphere_objects_.at(sphere);
+  target.sphere = geom::Sphere(center, radius);
+  sphere_batch_.Set(sphere, target.sphere);
+}
+
+void Scene::SetLight(std::size_t light, const Light& value) {
+  lights_.at(light) = value;
+}
+
+void Scene::SetMaterial(MaterialId material, const Material& value) {
+  materials_.Set(material, value);
+}
+
+util::ArenaStats Scene::GetArenaStats() const noexcept {
+  return arena_ ? arena_->GetStats() : util::ArenaStats{};
+}
+
+SceneMemory Scene::GetMemory() const noexcept {
+  SceneMemory memory;
+  auto bytes = [this, &memory](const auto& buffer) {
+    if (!buffer.Mapped()) {
+      return buffer.capacity() * sizeof(*buffer.data());
+    }
+    std::size_t size = buffer.size() * sizeof(*buffer.data());
+    memory.mapped += geometry_file_ ? size : 0;  // otherwise a view of the arena
+    return size;
+  };
+  objects_.ForEachVertexBuffer([&](const auto& buffer) {
+    memory.vertices += bytes(buffer);
+  });
+  objects_.ForEachTriangleBuffer([&](const auto& buffer) {
+    memory.triangles += bytes(buffer);
+  });
+  memory.spheres = sphere_objects_.capacity() * sizeof(SphereObject) + sphere_batch_.MemoryUsage();
+  memory.materials = materials_.MemoryUsage();
+  memory.lights = lights_.capacity() * sizeof(Light);
+  auto add_bvh = [&](const accel::Bvh& bvh) {
+    memory.acceleration += bytes(bvh.GetNodes()) + bytes(bvh.GetIndices());
+  };
+  memory.acceleration += meshes_.capacity() * sizeof(Mesh) + instances_.capacity() * sizeof(Instance);
+  for (const auto& mesh : meshes_) {
+    memory.acceleration += bytes(mesh.objects) + mesh.lods.capacity() * sizeof(MeshLod);
+    add_bvh(mesh.bvh);
+    for (const auto& lod : mesh.lods) {
+      memory.acceleration += bytes(lod.objects);
+      add_bvh(lod.bvh);
+    }
+  }
+  add_bvh(instance_bvh_);
+  memory.acceleration += bvh_instances_.capacity() * sizeof(std::uint32_t);
+  return memory;
+}
+
+geom::Intersection Scene::GetWorldIntersection(const ObjectHit& hit, const geom::Ray& ray) const {
+  const Instance& instance = instances_[hit.instance];
+  geom::Triangle triangle = objects_.GetTriangle(hit.object);
+  if (instance.identity) {
+    return GetIntersection(ray, triangle).value();
+  }
+  ObjectRay local = ToObject(instance, ray);
+  geom::Intersection intersection = GetIntersection(local.ray, triangle).value();
+  double distance = intersection.GetDistance() / local.scale;
+  return {ray.GetOrigin() + distance * ray.GetDirection(),
+          TransformNormal(instance.world_to_object, intersection.GetNormal()), distance};
+}
+
+}  // namespace rt
@@ -1,26 +1,43 @@
 #pragma once
 
+#include <accel/bvh.hpp>
+#include <geometry/intersection.hpp>
+#include <geometry/ray.hpp>
+#include <geometry/sphere_batch.hpp>
+#include <scene/indexed_mesh.hpp>
 #include <scene/light.hpp>
-#include <scene/material.hpp>
+#include <scene/material_table.hpp>
+#include <scene/memory.hpp>
+#include <scene/mesh.hpp>
 #include <scene/object.hpp>
+#include <util/arena.hpp>
+#include <util/mapped_file.hpp>
 
-#include <map>
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace rt {
 
+struct ObjectHit {
+  double distance;
+  std::uint32_t instance;
+  std::uint32_t object;
+};
+
 class Scene {
  public:
-  Scene(std::vector<Object> objects, std::vector<SphereObject> sphere_objects, std::vector<Light> lights,
-        std::map<std::string, Material> materials)
-    : objects_(std::move(objects)),
-      sphere_objects_(std::move(sphere_objects)),
-      lights_(std::move(lights)),
-      materials_(std::move(materials)) {
-  }
+  // Without meshes all objects form a single mesh placed once, as if the file had no groups. Meshes that come with
+  // a hierarchy keep it. arena is the one the buffers were allocated from, if any; the mesh hierarchies are built
+  // into it too.
+  Scene(IndexedMesh objects, std::vector<SphereObject> sphere_objects, std::vector<Light> lights,
+        MaterialTable materials, std::vector<Mesh> meshes = {}, std::vector<Instance> instances = {},
+        std::shared_ptr<util::Arena> arena = nullptr);
 
-  const std::vector<Object>& GetObjects() const {
+  const IndexedMesh& GetObjects() const {
     return objects_;
   }
 
@@ -28,19 +45,98 @@ class Scene {
     return sphere_objects_;
   }
 
+  // Sphere centres and squared radii in the same order as GetSphereObjects(), laid out for batched intersection.
+  const geom::SphereBatch& GetSphereBatch() const {
+    return sphere_batch_;
+  }
+
   const std::vector<Light>& GetLights() const {
     return lights_;
   }
 
-  const std::map<std::string, Material>& GetMaterials() const {
+  const MaterialTable& GetMaterials() const {
     return materials_;
   }
 
+  const std::vector<Mesh>& GetMeshes() const {
+    return meshes_;
+  }
+
+  const std::vector<Instance>& GetInstances() const {
+    return instances_;
+  }
+
+  // Top-level hierarchy over the world bounds of the instances whose mesh has triangles; its leaves number those
+  // instances in order. Instances of empty meshes are kept, so that indices follow the file, but never hit.
+  const accel::Bvh& GetInstanceBvh() const {
+    return instance_bvh_;
+  }
+
+  // Wall time spent building all hierarchies, including the bounds of every triangle. Per-hierarchy quality and
+  // time are in Bvh::GetStats().
+  double GetAccelerationBuildSeconds() const {
+    return acceleration_build_seconds_;
+  }
+
+  // Level of detail of every instance for a camera at eye: the coarsest level of its mesh whose error, scaled to world
+  // space, is at most error_per_distance times the distance from eye to the instance. Rays that start elsewhere travel
+  // further, so this is the nearest any ray from the camera sees the instance, and one level serves primary, shadow
+  // and secondary rays alike. Empty if no mesh has levels or error_per_distance is not positive.
+  [[nodiscard]] std::vector<std::uint8_t> SelectLods(const geom::Vector& eye, double error_per_distance) const;
+
+  // Nearest triangle over all instances. Equal distances resolve to the lowest object index, as a linear scan
+  // over GetObjects() would. lod_levels picks the level of each instance, see SelectLods(); empty for full detail.
+  [[nodiscard]] std::optional<ObjectHit> FindClosestObject(
+    const geom::Ray& ray, std::span<const std::uint8_t> lod_levels = {}) const noexcept;
+  // Whether some triangle is hit strictly closer than distance.
+  [[nodiscard]] bool ObjectCovers(const geom::Ray& ray, double distance,
+                                  std::span<const std::uint8_t> lod_levels = {}) const noexcept;
+
+  // The hit triangle and its intersection with the ray, in world space.
+  [[nodiscard]] Object GetWorldObject(const ObjectHit& hit) const;
+  [[nodiscard]] geom::Intersection GetWorldIntersection(const ObjectHit& hit, const geom::Ray& ray) const;
+
+  // Out-of-core scenes keep their triangles and hierarchies in a mapped file; see MapScene().
+  void AttachGeometryFile(std::shared_ptr<util::MappedFile> file) noexcept;
+  // Keeps the resident part of the mapped geometry under its limit. Does nothing for in-memory scenes.
+  void TrimGeometry() const;
+  [[nodiscard]] std::optional<util::PagingStats> GetPagingStats() const;
+
+  // ReadScene() allocates the triangles and mesh object lists in the scene's arena as it merges the parsed file, and
+  // every mesh hierarchy goes there as soon as it is built, so tearing a scene down frees a few blocks at once. Zero
+  // stats for scenes whose geometry is all mapped.
+  [[nodiscard]] util::ArenaStats GetArenaStats() const noexcept;
+
+  // Bytes held by each part of the scene; see SceneMemory.
+  [[nodiscard]] SceneMemory GetMemory() const noexcept;
+
+  // In-place updates between frames. Moving an instance refits the top-level hierarchy along the path to its leaf
+  // instead of rebuilding it; spheres and lights have no hierarchy. Indices out of range throw std::out_of_range,
+  // singular transforms std::invalid_argument.
+  void SetInstanceTransform(std::size_t instance, const Matrix& object_to_world);
+  void SetSphere(std::size_t sphere, const geom::Vector& center, double radius);
+  void SetLight(std::size_t light, const Light& value);
+  // The material keeps its name.
+  void SetMaterial(MaterialId material, const Material& value);
+
  private:
-  std::vector<Object> objects_;
+  [[nodiscard]] accel::Bvh BuildMeshBvh(const util::MappedVector<std::uint32_t>& objects) const;
+  void BuildAcceleration();
+  // Moves what the mesh and its levels own into the arena.
+  void MoveIntoArena(Mesh& mesh);
+
+  IndexedMesh objects_;
   std::vector<SphereObject> sphere_objects_;
   std::vector<Light> lights_;
-  const std::map<std::string, Material> materials_;
+  MaterialTable materials_;
+  std::vector<Mesh> meshes_;
+  std::vector<Instance> instances_;
+  geom::SphereBatch sphere_batch_;
+  accel::Bvh instance_bvh_;
+  std::vector<std::uint32_t> bvh_instances_;  // instance of each leaf of instance_bvh_, ascending
+  double acceleration_build_seconds_ = 0;
+  std::shared_ptr<util::MappedFile> geometry_file_;
+  std::shared_ptr<util::Arena> arena_;
 };
 
 }  // namespace rt
@@ -0,0 +1,386 @@
+#include <geometry/vector.hpp>
+#include <scene/simplify.hpp>
+#include <util/trace.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace rt {
+
+namespace {
+
+// Each level aims for this fraction of the triangles of the one before, and none gets fewer than kMinLodTriangles.
+constexpr std::size_t kLevelReduction = 4;
+constexpr std::size_t kMinLodTriangles = 32;
+constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+// Sum of squared distances to a set of planes as a quadratic form x^T A x + 2 b^T x + c.
+struct Quadric {
+  std::array<double, 6> a{};  // upper triangle of the symmetric A: a00 a01 a02 a11 a12 a22
+  std::array<double, 3> b{};
+  double c = 0;
+
+  // The plane dot(normal, x) + offset = 0, normal of unit length.
+  void AddPlane(const geom::Vector& normal, double offset) noexcept {
+    a[0] += normal[0] * normal[0];
+    a[1] += normal[0] * normal[1];
+    a[2] += normal[0] * normal[2];
+    a[3] += normal[1] * normal[1];
+    a[4] += normal[1] * normal[2];
+    a[5] += normal[2] * normal[2];
+    for (std::size_t i = 0; i < 3; ++i) {
+      b[i] += offset * normal[i];
+    }
+    c += offset * offset;
+  }
+
+  Quadric& operator+=(const Quadric& other) noexcept {
+    for (std::size_t i = 0; i < 6; ++i) {
+      a[i] += other.a[i];
+    }
+    for (std::size_t i = 0; i < 3; ++i) {
+      b[i] += other.b[i];
+    }
+    c += other.c;
+    return *this;
+  }
+
+  [[nodiscard]] double Error(const geom::Vector& x) const noexcept {
+    double quadratic = a[0] * x[0] * x[0] + a[3] * x[1] * x[1] + a[5] * x[2] * x[2] +
+                       2 * (a[1] * x[0] * x[1] + a[2] * x[0] * x[2] + a[4] * x[1] * x[2]);
+    double error = quadratic + 2 * (b[0] * x[0] + b[1] * x[1] + b[2] * x[2]) + c;
+    return std::max(error, 0.0);
+  }
+
+  // The point of least error, unless the planes leave a line or plane of such points (A is near singular).
+  [[nodiscard]] std::optional<geom::Vector> Minimum() const noexcept {
+    double m00 = a[3] * a[5] - a[4] * a[4];
+    double m01 = a[2] * a[4] - a[1] * a[5];
+    double m02 = a[1] * a[4] - a[2] * a[3];
+    double det = a[0] * m00 + a[1] * m01 + a[2] * m02;
+    double trace = a[0] + a[3] + a[5];
+    if (!(std::fabs(det) > 1e-9 * trace * trace * trace)) {
+      return std::nullopt;
+    }
+    double m11 = a[0] * a[5] - a[2] * a[2];
+    double m12 = a[1] * a[2] - a[0] * a[4];
+    double m22 = a[0] * a[3] - a[1] * a[1];
+    // x = -A^-1 b, with A^-1 the adjugate over the determinant.
+    return geom::Vector{-(m00 * b[0] + m01 * b[1] + m02 * b[2]) / det, -(m01 * b[0] + m11 * b[1] + m12 * b[2]) / det,
+                        -(m02 * b[0] + m12 * b[1] + m22 * b[2]) / det};
+  }
+};
+
+struct Face {
+  std::array<std::uint32_t, 3> vertices;  // local
+  std::array<std::uint32_t, 3> normals;   // global, as in the source triangle
+  MaterialId material;
+  bool alive = true;
+};
+
+struct Candidate {
+  double cost;
+  std::uint32_t keep;
+  std::uint32_t remove;
+  std::uint32_t keep_version;
+  std::uint32_t remove_version;
+  geom::Vector position;
+
+  [[nodiscard]] bool operator>(const Candidate& other) const noexcept {
+    return cost > other.cost;
+  }
+};
+
+[[nodiscard]] std::uint64_t EdgeKey(std::uint32_t lhs, std::uint32_t rhs) noexcept {
+  return (static_cast<std::uint64_t>(std::min(lhs, rhs)) << 32) | std::max(lhs, rhs);
+}
+
+// One mesh being collapsed level by level. Vertices are numbered locally; a vertex keeps its global index until it
+// moves, so unchanged parts of the mesh share vertices with the full-detail triangles.
+class Simplifier {
+ public:
+  Simplifier(const util::MappedVector<std::uint32_t>& triangles, const IndexedMesh& objects) {
+    std::unordered_map<std::uint32_t, std::uint32_t> local;
+    faces_.reserve(triangles.size());
+    for (std::uint32_t object : triangles) {
+      Face face{{}, objects.GetNormalIndices(object), objects.GetMaterial(object)};
+      for (std::size_t i = 0; i < 3; ++i) {
+        std::uint32_t global = objects.GetVertexIndices(object)[i];
+        auto [it, inserted] = local.try_emplace(global, static_cast<std::uint32_t>(positions_.size()));
+        if (inserted) {
+          positions_.push_back(objects.GetVertex(global));
+          global_.push_back(global);
+        }
+        face.vertices[i] = it->second;
+      }
+      faces_.push_back(face);
+    }
+    face_count_ = faces_.size();
+    quadrics_.resize(positions_.size());
+    versions_.resize(positions_.size(), 0);
+    removed_.resize(positions_.size(), false);
+    vertex_faces_.resize(positions_.size());
+    for (std::uint32_t f = 0; f < faces_.size(); ++f) {
+      for (std::uint32_t vertex : faces_[f].vertices) {
+        vertex_faces_[vertex].push_back(f);
+      }
+    }
+    InitQuadrics();
+  }
+
+  [[nodiscard]] std::size_t FaceCount() const noexcept {
+    return face_count_;
+  }
+
+  // Collapses edges until at most target faces are left or no edge can go without flipping a face.
+  void CollapseTo(std::size_t target) {
+    while (face_count_ > target && !candidates_.empty()) {
+      Candidate candidate = candidates_.top();
+      candidates_.pop();
+      if (removed_[candidate.keep] || removed_[candidate.remove] ||
+          versions_[candidate.keep] != candidate.keep_version ||
+          versions_[candidate.remove] != candidate.remove_version) {
+        continue;  // stale: an endpoint changed since the candidate was queued
+      }
+      if (Flips(candidate.keep, candidate.remove, candidate.position)) {
+        continue;
+      }
+      max_cost_ = std::max(max_cost_, candidate.cost);
+      Collapse(candidate.keep, candidate.remove, candidate.position);
+    }
+  }
+
+  // Appends the faces left, and the vertices that moved since they were last appended, to objects.
+  [[nodiscard]] MeshLod Emit(IndexedMesh* objects) {
+    std::vector<std::uint32_t> lod_objects;
+    lod_objects.reserve(face_count_);
+    for (const Face& face : faces_) {
+      if (!face.alive) {
+        continue;
+      }
+      std::array<std::uint32_t, 3> vertices;
+      for (std::size_t i = 0; i < 3; ++i) {
+        std::uint32_t& global = global_[face.vertices[i]];
+        if (global == kNone) {
+          global = objects->AddVertex(positions_[face.vertices[i]]);
+        }
+        vertices[i] = global;
+      }
+      lod_objects.push_back(static_cast<std::uint32_t>(objects->size()));
+      objects->AddTriangle(vertices, face.normals, face.material);
+    }
+    return {std::move(lod_objects), std::sqrt(max_cost_)};
+  }
+
+ private:
+  [[nodiscard]] geom::Vector FaceNormal(const Face& face) const noexcept {
+    const geom::Vector& p0 = positions_[face.vertices[0]];
+    return CrossProduct(positions_[face.vertices[1]] - p0, positions_[face.vertices[2]] - p0);
+  }
+
+  // Every vertex starts with the planes of its faces. Edges on an open border, on a seam between materials or
+  // shared by more than two faces also get a plane through the edge at a right angle to each of their faces, so
+  // moving them along the surface costs as much as moving them off it.
+  void InitQuadrics() {
+    struct EdgeInfo {
+      std::uint32_t faces = 0;
+      std::uint32_t first_face;
+      bool seam = false;
+    };
+    std::unordered_map<std::uint64_t, EdgeInfo> edges;
+    for (std::uint32_t f = 0; f < faces_.size(); ++f) {
+      const Face& face = faces_[f];
+      for (std::size_t i = 0; i < 3; ++i) {
+        auto [it, inserted] = edges.try_emplace(EdgeKey(face.vertices[i], face.vertices[(i + 1) % 3]));
+        EdgeInfo& edge = it->second;
+        if (inserted) {
+          edge.first_face = f;
+        } else if (faces_[edge.first_face].material != face.material) {
+          edge.seam = true;
+        }
+        ++edge.faces;
+      }
+    }
+    for (const Face& face : faces_) {
+      geom::Vector normal = FaceNormal(face);
+      if (Length(normal) == 0) {
+        continue;
+      }
+      normal.Normalize();
+      for (std::uint32_t vertex : face.vertices) {
+        quadrics_[vertex].AddPlane(normal, -DotProduct(normal, positions_[face.vertices[0]]));
+      }
+      for (std::size_t i = 0; i < 3; ++i) {
+        std::uint32_t from = face.vertices[i];
+        std::uint32_t to = face.vertices[(i + 1) % 3];
+        const EdgeInfo& edge = edges.at(EdgeKey(from, to));
+        if (edge.faces == 2 && !edge.seam) {
+          continue;
+        }
+        geom::Vector border_normal = CrossProduct(positions_[to] - positions_[from], normal);
+        if (Length(border_normal) == 0) {
+          continue;
+        }
+        border_normal.Normalize();
+        double offset = -DotProduct(border_normal, positions_[from]);
+        quadrics_[from].AddPlane(border_normal, offset);
+        quadrics_[to].AddPlane(border_normal, offset);
+      }
+    }
+    for (std::uint32_t f = 0; f < faces_.size(); ++f) {
+      const Face& face = faces_[f];
+      for (std::size_t i = 0; i < 3; ++i) {
+        std::uint32_t from = face.vertices[i];
+        std::uint32_t to = face.vertices[(i + 1) % 3];
+        if (from != to && edges.at(EdgeKey(from, to)).first_face == f) {
+          Enqueue(from, to);
+        }
+      }
+    }
+  }
+
+  // Queues the collapse of remove into keep at the best of the minimum of their joint quadric, the endpoints and the
+  // midpoint. The minimum is skipped when it lies far off the edge, where a near-singular quadric puts it.
+  void Enqueue(std::uint32_t keep, std::uint32_t remove) {
+    Quadric quadric = quadrics_[keep];
+    quadric += quadrics_[remove];
+    const geom::Vector& p0 = positions_[keep];
+    const geom::Vector& p1 = positions_[remove];
+    geom::Vector midpoint = (p0 + p1) / 2;
+    std::optional<geom::Vector> best;
+    double cost = std::numeric_limits<double>::infinity();
+    auto consider = [&](const geom::Vector& position) {
+      double error = quadric.Error(position);
+      if (error < cost) {
+        cost = error;
+        best = position;
+      }
+    };
+    auto minimum = quadric.Minimum();
+    if (minimum && Length(*minimum - midpoint) <= Length(p1 - p0)) {
+      consider(*minimum);
+    }
+    consider(p0);
+    consider(p1);
+    consider(midpoint);
+    candidates_.push({cost, keep, remove, versions_[keep], versions_[remove], *best});
+  }
+
+  // Whether moving keep and remove to position turns some face that survives the collapse over.
+  [[nodiscard]] bool Flips(std::uint32_t keep, std::uint32_t remove, const geom::Vector& position) const {
+    for (std::uint32_t vertex : {keep, remove}) {
+      for (std::uint32_t f : vertex_faces_[vertex]) {
+        const Face& face = faces_[f];
+        if (!face.alive) {
+          continue;
+        }
+        const auto& v = face.vertices;
+        bool has_keep = v[0] == keep || v[1] == keep || v[2] == keep;
+        bool has_remove = v[0] == remove || v[1] == remove || v[2] == remove;
+        if (has_keep && has_remove) {
+          continue;  // collapses away
+        }
+        geom::Vector before = FaceNormal(face);
+        if (Length(before) == 0) {
+          continue;
+        }
+        std::array<geom::Vector, 3> corners;
+        for (std::size_t i = 0; i < 3; ++i) {
+          corners[i] = v[i] == vertex ? position : positions_[v[i]];
+        }
+        geom::Vector after = CrossProduct(corners[1] - corners[0], corners[2] - corners[0]);
+        if (DotProduct(before, after) <= 0) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void Collapse(std::uint32_t keep, std::uint32_t remove, const geom::Vector& position) {
+    const geom::Vector& old_position = positions_[keep];
+    if (old_position[0] != position[0] || old_position[1] != position[1] || old_position[2] != position[2]) {
+      positions_[keep] = position;
+      global_[keep] = kNone;
+    }
+    quadrics_[keep] += quadrics_[remove];
+    removed_[remove] = true;
+    ++versions_[keep];
+    ++versions_[remove];
+    for (std::uint32_t f : vertex_faces_[remove]) {
+      Face& face = faces_[f];
+      if (!face.alive) {
+        continue;
+      }
+      auto& v = face.vertices;
+      if (v[0] == keep || v[1] == keep || v[2] == keep) {
+        face.alive = false;
+        --face_count_;
+        continue;
+      }
+      std::replace(v.begin(), v.end(), remove, keep);
+      vertex_faces_[keep].push_back(f);
+    }
+    vertex_faces_[remove].clear();
+    std::erase_if(vertex_faces_[keep], [this](std::uint32_t f) {
+      return !faces_[f].alive;
+    });
+    std::vector<std::uint32_t> neighbours;
+    for (std::uint32_t f : vertex_faces_[keep]) {
+      for (std::uint32_t vertex : faces_[f].vertices) {
+        if (vertex != keep) {
+          neighbours.push_back(vertex);
+        }
+      }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    for (std::uint32_t neighbour : neighbours) {
+      Enqueue(keep, neighbour);
+    }
+  }
+
+  std::vector<geom::Vector> positions_;
+  std::vector<std::uint32_t> global_;  // kNone once the vertex has moved
+  std::vector<Quadric> quadrics_;
+  std::vector<std::uint32_t> versions_;
+  std::vector<bool> removed_;
+  std::vector<Face> faces_;
+  std::vector<std::vector<std::uint32_t>> vertex_faces_;
+  std::size_t face_count_ = 0;
+  double max_cost_ = 0;
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> candidates_;
+};
+
+}  // namespace
+
+std::vector<MeshLod> BuildLods(const util::MappedVector<std::uint32_t>& triangles, IndexedMesh* objects) {
+  RT_TRACE_SPAN("lods");
+  std::vector<MeshLod> lods;
+  std::size_t target = triangles.size() / kLevelReduction;
+  if (target < kMinLodTriangles) {
+    return lods;
+  }
+  Simplifier simplifier(triangles, *objects);
+  std::size_t previous = triangles.size();
+  while (target >= kMinLodTriangles) {
+    simplifier.CollapseTo(target);
+    // A level that saves little is not worth its memory, and the next ones would not get further.
+    if (simplifier.FaceCount() * 4 > previous * 3) {
+      break;
+    }
+    lods.push_back(simplifier.Emit(objects));
+    previous = simplifier.FaceCount();
+    target = previous / kLevelReduction;
+  }
+  return lods;
+}
+
+}  // namespace rt
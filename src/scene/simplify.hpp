@@ -0,0 +1,22 @@
+#pragma once
+
+#include <scene/indexed_mesh.hpp>
+#include <scene/mesh.hpp>
+#include <util/mapped_vector.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace rt {
+
+// Levels of detail of the mesh made of the given triangles of objects, built by quadric-error edge collapse (Garland
+// and Heckbert): edges are collapsed cheapest first into the point closest to the planes of all triangles merged into
+// it, and each level keeps about a quarter of the triangles of the one before. Open borders and seams between
+// materials are held in place by planes of their own. Triangles keep their materials and corner normals.
+//
+// The new triangles, and the vertices that moved, are appended to objects; the levels list their indices, coarsest
+// last, without hierarchies. A level's error is the square root of the largest quadric error of the collapses up to
+// it, which bounds how far any vertex moved off the planes it stands for. Small meshes get no levels.
+[[nodiscard]] std::vector<MeshLod> BuildLods(const util::MappedVector<std::uint32_t>& triangles, IndexedMesh* objects);
+
+}  // namespace rt
@@ -0,0 +1,56 @@
+#include <server/render_server.hpp>
+
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+rt::server::RenderServer* running_server = nullptr;
+
+extern "C" void StopServer(int) {
+  if (running_server) {
+    running_server->Stop();
+  }
+}
+
+void PrintUsage(const char* program) {
+  std::cerr << "usage: " << program << " SOCKET [--threads N] [--cache SCENES]\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  try {
+    rt::server::ServerOptions options;
+    options.socket_path = argv[1];
+    for (int i = 2; i < argc; i += 2) {
+      std::string_view flag = argv[i];
+      if (i + 1 >= argc || (flag != "--threads" && flag != "--cache")) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      (flag == "--threads" ? options.threads : options.cache_capacity) = std::stoul(argv[i + 1]);
+    }
+    rt::server::RenderServer server(options);
+    running_server = &server;
+    std::signal(SIGINT, StopServer);
+    std::signal(SIGTERM, StopServer);
+    std::cerr << "listening on " << options.socket_path << '\n';
+    server.Serve();
+    running_server = nullptr;
+    auto stats = server.GetStats();
+    std::cerr << "served " << stats.completed << " jobs, " << stats.failed << " failed\n";
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
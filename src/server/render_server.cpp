@@ -0,0 +1,235 @@
+#include <raytracer/deadline.hpp>
+#include <raytracer/raytracer.hpp>
+#include <raytracer/render_job.hpp>
+#include <server/render_server.hpp>
+#include <util/trace.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace rt::server {
+
+namespace {
+
+// A request line is tiny; anything longer is not a client of ours.
+constexpr std::size_t kMaxRequestSize = std::size_t{1} << 16;
+constexpr int kReceiveTimeoutSeconds = 5;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+[[nodiscard]] sockaddr_un MakeAddress(const std::string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("bad socket path " + path);
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+[[nodiscard]] std::string ErrorMessage(const std::string& what) {
+  return what + ": " + std::strerror(errno);
+}
+
+// Reads up to the first newline. Returns what was read if the peer closes first.
+[[nodiscard]] std::string ReadLine(int fd) {
+  std::string line;
+  char buffer[512];
+  while (line.size() < kMaxRequestSize) {
+    ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    line.append(buffer, static_cast<std::size_t>(count));
+    if (auto newline = line.find('\n'); newline != std::string::npos) {
+      line.resize(newline);
+      break;
+    }
+  }
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  return line;
+}
+
+void WriteLine(int fd, std::string line) {
+  line += '\n';
+  std::size_t sent = 0;
+  while (sent < line.size()) {
+    ssize_t count = send(fd, line.data() + sent, line.size() - sent, kSendFlags);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return;  // the client went away, nobody to tell
+    }
+    sent += static_cast<std::size_t>(count);
+  }
+}
+
+[[nodiscard]] double Seconds(std::chrono::steady_clock::duration duration) noexcept {
+  return std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+RenderServer::RenderServer(ServerOptions options)
+  : options_(std::move(options)), cache_(options_.cache_capacity, options_.reader), pool_(options_.threads) {
+  sockaddr_un address = MakeAddress(options_.socket_path);
+  listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener_ < 0) {
+    throw std::runtime_error(ErrorMessage("can't create socket"));
+  }
+  unlink(options_.socket_path.c_str());
+  if (bind(listener_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listener_, SOMAXCONN) != 0) {
+    std::string message = ErrorMessage("can't listen on " + options_.socket_path);
+    close(listener_);
+    throw std::runtime_error(message);
+  }
+}
+
+RenderServer::~RenderServer() {
+  close(listener_);
+  unlink(options_.socket_path.c_str());
+}
+
+void RenderServer::Serve() {
+  while (!stopping_) {
+    int connection = accept(listener_, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      break;  // Stop() shut the listener down
+    }
+    // The request is read on the pool too, so a client that is slow to send it holds up no one else's accept.
+    pool_.Submit([this, connection, accepted = Clock::now()] {
+      Handle(connection, accepted);
+    });
+  }
+  pool_.Wait();
+}
+
+void RenderServer::Stop() noexcept {
+  stopping_ = true;
+  shutdown(listener_, SHUT_RDWR);
+}
+
+ServerStats RenderServer::GetStats() const {
+  ServerStats stats;
+  {
+    std::lock_guard lock(stats_mutex_);
+    stats = stats_;
+    std::size_t finished = stats_.completed + stats_.failed;
+    if (finished > 0) {
+      stats.mean_wait_seconds = total_wait_seconds_ / static_cast<double>(finished);
+      stats.mean_latency_seconds = total_latency_seconds_ / static_cast<double>(finished);
+    }
+  }
+  stats.queued = pool_.QueueDepth();
+  stats.running = pool_.Running();
+  stats.cache = cache_.GetStats();
+  return stats;
+}
+
+void RenderServer::Handle(int connection, Clock::time_point accepted) {
+  timeval timeout{kReceiveTimeoutSeconds, 0};
+  setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  std::string request = ReadLine(connection);
+  if (request.starts_with("render ")) {
+    RunJob(connection, request.substr(7), accepted);
+    return;
+  }
+  if (request == "stats") {
+    ServerStats stats = GetStats();
+    std::ostringstream reply;
+    reply << "completed=" << stats.completed << " failed=" << stats.failed << " queued=" << stats.queued
+          << " running=" << stats.running << " mean_wait=" << stats.mean_wait_seconds
+          << " mean_latency=" << stats.mean_latency_seconds << " max_latency=" << stats.max_latency_seconds
+          << " cache_hits=" << stats.cache.hits << " cache_misses=" << stats.cache.misses
+          << " cache_evictions=" << stats.cache.evictions << " cache_size=" << stats.cache.size;
+    WriteLine(connection, reply.str());
+  } else if (request == "stop") {
+    WriteLine(connection, "ok");
+    Stop();
+  } else {
+    WriteLine(connection, "error unknown request");
+  }
+  close(connection);
+}
+
+void RenderServer::RunJob(int connection, const std::string& line, Clock::time_point accepted) {
+  auto started = Clock::now();
+  RT_TRACE_SPAN("job");
+  std::string reply;
+  bool ok = false;
+  try {
+    RenderJob job = ParseRenderJob(line);
+    std::shared_ptr<const Scene> scene = cache_.Get(job.scene);
+    std::ostringstream reply_stream;
+    if (job.time_limit > 0) {
+      DeadlineOptions deadline;
+      deadline.deadline = accepted + std::chrono::duration_cast<Clock::duration>(
+                                       std::chrono::duration<double>(job.time_limit));
+      DeadlineRender render = RenderWithDeadline(*scene, job.camera, job.render, deadline);
+      render.image.Write(job.output);
+      reply_stream << "ok " << Seconds(started - accepted) << ' ' << Seconds(Clock::now() - accepted) << ' '
+                   << GetQualityName(render.quality);
+    } else {
+      Render(*scene, job.camera, job.render).Write(job.output);
+      reply_stream << "ok " << Seconds(started - accepted) << ' ' << Seconds(Clock::now() - accepted);
+    }
+    reply = reply_stream.str();
+    ok = true;
+  } catch (const std::exception& error) {
+    reply = std::string("error ") + error.what();
+  }
+  Record(ok, accepted, started);
+  WriteLine(connection, reply);
+  close(connection);
+}
+
+void RenderServer::Record(bool ok, Clock::time_point accepted, Clock::time_point started) {
+  double latency = Seconds(Clock::now() - accepted);
+  std::lock_guard lock(stats_mutex_);
+  ++(ok ? stats_.completed : stats_.failed);
+  total_wait_seconds_ += Seconds(started - accepted);
+  total_latency_seconds_ += latency;
+  stats_.max_latency_seconds = std::max(stats_.max_latency_seconds, latency);
+}
+
+std::string SendRequest(const std::string& socket_path, std::string_view request) {
+  sockaddr_un address = MakeAddress(socket_path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw std::runtime_error(ErrorMessage("can't create socket"));
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    std::string message = ErrorMessage("can't connect to " + socket_path);
+    close(fd);
+    throw std::runtime_error(message);
+  }
+  WriteLine(fd, std::string(request));
+  std::string reply = ReadLine(fd);
+  close(fd);
+  return reply;
+}
+
+}  // namespace rt::server
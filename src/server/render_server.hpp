@@ -0,0 +1,78 @@
+#pragma once
+
+#include <server/scene_cache.hpp>
+#include <util/thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace rt::server {
+
+struct ServerOptions {
+  std::string socket_path;
+  std::size_t threads = 0;  // render threads, 0 for one per hardware thread
+  std::size_t cache_capacity = 8;
+  ReaderOptions reader;
+};
+
+struct ServerStats {
+  std::size_t completed = 0;
+  std::size_t failed = 0;
+  // Connections are read on the pool, so these count accepted requests of any kind, this one included.
+  std::size_t queued = 0;   // accepted requests waiting for a thread
+  std::size_t running = 0;
+  double mean_wait_seconds = 0;  // from accept to the start of the render
+  double mean_latency_seconds = 0;  // from accept to the reply
+  double max_latency_seconds = 0;
+  SceneCacheStats cache;
+};
+
+// Renders jobs sent over a Unix domain socket. Every connection carries one request line and gets one reply line:
+//   render JOB  (see ParseRenderJob)  ->  ok WAIT_SECONDS LATENCY_SECONDS [QUALITY]  or  error MESSAGE
+//   stats                             ->  key=value pairs of ServerStats
+//   stop                              ->  ok, and no more connections are accepted
+// QUALITY, the name of the RenderQuality reached, is given for jobs with a time limit, which counts from the accept.
+// Jobs run on a shared pool against scenes kept in a SceneCache, so repeated requests for a scene skip loading it
+// and building its hierarchies.
+class RenderServer {
+ public:
+  // Binds and listens, replacing a stale socket file. Throws std::runtime_error on failure.
+  explicit RenderServer(ServerOptions options);
+  ~RenderServer();
+
+  RenderServer(const RenderServer&) = delete;
+  RenderServer& operator=(const RenderServer&) = delete;
+
+  // Accepts connections until Stop() or a `stop` request, then waits for the accepted jobs.
+  void Serve();
+  // Only touches an atomic flag and the listening socket, so it may be called from a signal handler.
+  void Stop() noexcept;
+
+  [[nodiscard]] ServerStats GetStats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  void Handle(int connection, Clock::time_point accepted);
+  void RunJob(int connection, const std::string& line, Clock::time_point accepted);
+  void Record(bool ok, Clock::time_point accepted, Clock::time_point started);
+
+  ServerOptions options_;
+  int listener_ = -1;
+  std::atomic<bool> stopping_ = false;
+  SceneCache cache_;
+  mutable std::mutex stats_mutex_;
+  ServerStats stats_;
+  double total_wait_seconds_ = 0;
+  double total_latency_seconds_ = 0;
+  util::ThreadPool pool_;  // last, so that its destructor finishes the jobs before the rest goes away
+};
+
+// Client side: sends one request line and returns the reply line without its newline.
+[[nodiscard]] std::string SendRequest(const std::string& socket_path, std::string_view request);
+
+}  // namespace rt::server
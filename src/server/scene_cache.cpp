@@ -0,0 +1,71 @@
+#include <server/scene_cache.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <system_error>
+#include <utility>
+
+namespace rt::server {
+
+SceneCache::SceneCache(std::size_t capacity, ReaderOptions options) noexcept
+  : capacity_(std::max<std::size_t>(capacity, 1)), options_(options) {
+}
+
+std::shared_ptr<const Scene> SceneCache::Get(const std::string& filename) {
+  std::error_code error;
+  auto modified = std::filesystem::last_write_time(filename, error);
+  std::promise<std::shared_ptr<const Scene>> loaded;
+  std::shared_future<std::shared_ptr<const Scene>> scene;
+  std::optional<std::size_t> load;
+  {
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(filename);
+    if (it != entries_.end() && it->second.modified == modified) {
+      ++stats_.hits;
+      order_.splice(order_.begin(), order_, it->second.position);
+      scene = it->second.scene;
+    } else {
+      ++stats_.misses;
+      if (it != entries_.end()) {
+        Erase(filename);
+      }
+      load = next_load_++;
+      scene = loaded.get_future().share();
+      order_.push_front(filename);
+      entries_.emplace(filename, Entry{scene, modified, *load, order_.begin()});
+      while (entries_.size() > capacity_) {
+        std::string oldest = order_.back();
+        Erase(oldest);
+        ++stats_.evictions;
+      }
+      stats_.size = entries_.size();
+    }
+  }
+  if (load) {
+    try {
+      loaded.set_value(std::make_shared<const Scene>(ReadScene(filename, options_)));
+    } catch (...) {
+      loaded.set_exception(std::current_exception());
+      std::lock_guard lock(mutex_);
+      auto it = entries_.find(filename);
+      if (it != entries_.end() && it->second.load == *load) {
+        Erase(filename);
+        stats_.size = entries_.size();
+      }
+    }
+  }
+  return scene.get();
+}
+
+SceneCacheStats SceneCache::GetStats() const {
+  std::lock_guard lock(mutex_);
+  return stats_;
+}
+
+void SceneCache::Erase(const std::string& filename) {
+  auto it = entries_.find(filename);
+  order_.erase(it->second.position);
+  entries_.erase(it);
+}
+
+}  // namespace rt::server
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <scene/reader.hpp>
+#include <scene/scene.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace rt::server {
+
+struct SceneCacheStats {
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t evictions = 0;
+  std::size_t size = 0;
+};
+
+// Recently used scenes, with their hierarchies, keyed by file name. A file changed on disk since it was loaded is
+// read again. Concurrent requests for a scene that is being loaded wait for that load instead of starting another.
+// An evicted scene stays alive until the last render using it finishes.
+class SceneCache {
+ public:
+  explicit SceneCache(std::size_t capacity, ReaderOptions options = {}) noexcept;
+
+  // Throws what ReadScene throws; a failed load is not cached.
+  [[nodiscard]] std::shared_ptr<const Scene> Get(const std::string& filename);
+
+  [[nodiscard]] SceneCacheStats GetStats() const;
+
+ private:
+  struct Entry {
+    std::shared_future<std::shared_ptr<const Scene>> scene;
+    std::filesystem::file_time_type modified;
+    std::size_t load;  // tells a failed load whether the entry is still its own
+    std::list<std::string>::iterator position;
+  };
+
+  void Erase(const std::string& filename);
+
+  std::size_t capacity_;
+  ReaderOptions options_;
+  std::list<std::string> order_;  // most recently used first
+  std::unordered_map<std::string, Entry> entries_;
+  SceneCacheStats stats_;
+  std::size_t next_load_ = 0;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace rt::server
@@ -0,0 +1,131 @@
+#include <raytracer/render_job.hpp>
+#include <raytracer/tile.hpp>
+#include <scene/reader.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+void PrintUsage(const char* program) {
+  std::cerr << "usage:\n"
+            << "  " << program << " render X0,Y0,X1,Y1 TILE JOB...   trace one region of the job's frame\n"
+            << "  " << program << " merge OUTPUT TILE...              tonemap tiles into the final image\n"
+            << "  " << program << " farm PROCESSES JOB...             render the job in bands on local processes\n"
+            << "JOB is a render job as in batch manifests; its output is ignored by render.\n";
+}
+
+[[nodiscard]] rt::RenderJob ParseJob(char** begin, char** end) {
+  std::string line;
+  for (char** word = begin; word != end; ++word) {
+    line += *word;
+    line += ' ';
+  }
+  return rt::ParseRenderJob(line);
+}
+
+[[nodiscard]] rt::Region ParseRegion(std::string_view text) {
+  int values[4];
+  for (int i = 0; i < 4; ++i) {
+    std::size_t comma = i < 3 ? text.find(',') : text.size();
+    if (comma == std::string_view::npos ||
+        std::from_chars(text.data(), text.data() + comma, values[i]).ptr != text.data() + comma) {
+      throw std::runtime_error("bad region " + std::string(text));
+    }
+    text.remove_prefix(std::min(comma + 1, text.size()));
+  }
+  return {values[0], values[1], values[2], values[3]};
+}
+
+void RenderRegion(const rt::RenderJob& job, const rt::Region& region, const std::string& tile_filename) {
+  rt::Scene scene = rt::ReadScene(job.scene);
+  rt::WriteTile(rt::RenderTile(scene, job.camera, job.render, region), tile_filename);
+}
+
+void Merge(const std::string& output, const std::vector<std::string>& tile_filenames) {
+  std::vector<rt::Tile> tiles;
+  for (const auto& filename : tile_filenames) {
+    tiles.push_back(rt::ReadTile(filename));
+  }
+  rt::MergeTiles(tiles).Write(output);
+}
+
+// Forks one worker per band; each loads the scene itself, as a worker on another machine would.
+void Farm(const rt::RenderJob& job, int processes) {
+  auto start = std::chrono::steady_clock::now();
+  auto bands = rt::SplitIntoBands(job.camera.screen_width, job.camera.screen_height, processes);
+  std::vector<std::string> tile_filenames;
+  std::vector<pid_t> workers;
+  for (std::size_t i = 0; i < bands.size(); ++i) {
+    tile_filenames.push_back(job.output + ".tile" + std::to_string(i));
+    pid_t pid = fork();
+    if (pid < 0) {
+      throw std::runtime_error("fork failed");
+    }
+    if (pid == 0) {
+      try {
+        RenderRegion(job, bands[i], tile_filenames.back());
+        std::_Exit(EXIT_SUCCESS);
+      } catch (const std::exception& error) {
+        std::cerr << "band " << i << ": " << error.what() << '\n';
+        std::_Exit(EXIT_FAILURE);
+      }
+    }
+    workers.push_back(pid);
+  }
+  bool failed = false;
+  for (pid_t pid : workers) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    failed |= !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+  }
+  if (!failed) {
+    Merge(job.output, tile_filenames);
+  }
+  for (const auto& filename : tile_filenames) {
+    std::remove(filename.c_str());
+  }
+  if (failed) {
+    throw std::runtime_error("a worker failed");
+  }
+  std::cout << bands.size() << " bands rendered and merged in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  std::string_view mode = argv[1];
+  try {
+    if (mode == "render" && argc >= 5) {
+      RenderRegion(ParseJob(argv + 4, argv + argc), ParseRegion(argv[2]), argv[3]);
+    } else if (mode == "merge") {
+      Merge(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+    } else if (mode == "farm") {
+      Farm(ParseJob(argv + 3, argv + argc), std::stoi(argv[2]));
+    } else {
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
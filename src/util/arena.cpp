@@ -0,0 +1,39 @@
+#include <util/arena.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace rt::util {
+
+void* Arena::Allocate(std::size_t bytes, std::size_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= alignof(std::max_align_t));
+  auto padding = static_cast<std::size_t>(-reinterpret_cast<std::uintptr_t>(free_) & (alignment - 1));
+  if (free_ == nullptr || padding + bytes > free_bytes_) {
+    // Doubling keeps the chunk count logarithmic in the total size for arenas that grow without Reserve().
+    AddChunk(std::max({bytes, min_chunk_size_, stats_.reserved_bytes}));
+    padding = 0;  // chunks are aligned for any type
+  }
+  void* result = free_ + padding;
+  free_ += padding + bytes;
+  free_bytes_ -= padding + bytes;
+  stats_.used_bytes += padding + bytes;
+  ++stats_.allocations;
+  return result;
+}
+
+void Arena::Reserve(std::size_t bytes) {
+  if (free_ == nullptr || bytes > free_bytes_) {
+    AddChunk(std::max(bytes, min_chunk_size_));
+  }
+}
+
+void Arena::AddChunk(std::size_t size) {
+  chunks_.emplace_back(new std::byte[size]);
+  free_ = chunks_.back().get();
+  free_bytes_ = size;
+  ++stats_.chunks;
+  stats_.reserved_bytes += size;
+}
+
+}  // namespace rt::util
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <util/mapped_vector.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace rt::util {
+
+struct ArenaStats {
+  std::size_t chunks = 0;
+  std::size_t reserved_bytes = 0;  // sum of chunk sizes
+  std::size_t used_bytes = 0;      // handed out, including alignment padding
+  std::size_t allocations = 0;
+};
+
+// Bump allocator for data that lives as long as its owner, e.g. a scene. Memory is taken from large chunks and never
+// freed piecemeal: destroying the arena releases every chunk at once, whatever was allocated from it. Only for
+// trivially destructible types, since nothing is destroyed.
+class Arena {
+ public:
+  explicit Arena(std::size_t min_chunk_size = std::size_t{1} << 20) noexcept : min_chunk_size_(min_chunk_size) {
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // alignment must be a power of two no larger than alignof(std::max_align_t).
+  [[nodiscard]] void* Allocate(std::size_t bytes, std::size_t alignment);
+
+  template <typename T>
+  [[nodiscard]] std::span<T> AllocateArray(std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+    return {static_cast<T*>(Allocate(count * sizeof(T), alignof(T))), count};
+  }
+
+  // Makes sure the next allocations totalling `bytes`, padding included, come from one chunk. A new chunk is made no
+  // larger than that, so reserving ahead of each batch of allocations of known size wastes at most a chunk's tail.
+  void Reserve(std::size_t bytes);
+
+  [[nodiscard]] ArenaStats GetStats() const noexcept {
+    return stats_;
+  }
+
+ private:
+  void AddChunk(std::size_t size);
+
+  std::size_t min_chunk_size_;
+  std::vector<std::unique_ptr<std::byte[]>> chunks_;
+  std::byte* free_ = nullptr;
+  std::size_t free_bytes_ = 0;
+  ArenaStats stats_;
+};
+
+// An empty vector with room for capacity elements in the arena, which it keeps alive; see MappedVector.
+template <typename T>
+[[nodiscard]] MappedVector<T> AllocateVector(const std::shared_ptr<Arena>& arena, std::size_t capacity) {
+  if (capacity == 0) {
+    return {};
+  }
+  return {arena->AllocateArray<T>(capacity), arena, 0};
+}
+
+// Bytes AllocateVector and MoveIntoArena need for capacity elements at worst, padding included.
+template <typename T>
+[[nodiscard]] std::size_t ArenaBytes(std::size_t capacity) noexcept {
+  return capacity == 0 ? 0 : capacity * sizeof(T) + alignof(T);
+}
+
+// Bytes MoveIntoArena needs for the vector at worst, padding included.
+template <typename T>
+[[nodiscard]] std::size_t ArenaBytes(const MappedVector<T>& vector) noexcept {
+  return vector.Mapped() ? 0 : ArenaBytes<T>(vector.size());
+}
+
+// Copies an owned vector into the arena and leaves it a read-only view of the copy that keeps the arena alive.
+// Views of other storage are left alone.
+template <typename T>
+void MoveIntoArena(MappedVector<T>& vector, const std::shared_ptr<Arena>& arena) {
+  if (vector.Mapped() || vector.empty()) {
+    return;
+  }
+  std::span<T> copy = arena->AllocateArray<T>(vector.size());
+  std::copy(vector.begin(), vector.end(), copy.begin());
+  vector = MappedVector<T>(std::span<const T>(copy), arena);
+}
+
+}  // namespace rt::util
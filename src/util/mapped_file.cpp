@@ -0,0 +1,130 @@
+#include <util/mapped_file.hpp>
+
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace rt::util {
+
+namespace {
+
+// Most a single page fault can map: with fault-around and large folios the kernel maps neighbouring cached pages
+// too, up to a whole huge page.
+constexpr std::size_t kMaxBytesPerFault = 2 * 1024 * 1024;
+
+[[maybe_unused]] void GetFaults(long* minor, long* major) noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  *minor = usage.ru_minflt;
+  *major = usage.ru_majflt;
+#else
+  *minor = 0;
+  *major = 0;
+#endif
+}
+
+}  // namespace
+
+#if defined(__unix__) || defined(__APPLE__)
+
+MappedFile::MappedFile(const std::string& filename, std::size_t resident_limit) : resident_limit_(resident_limit) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("file is not open");
+  }
+  off_t size = lseek(fd, 0, SEEK_END);
+  if (size <= 0) {
+    close(fd);
+    throw std::runtime_error("mapped file is empty");
+  }
+  void* data = mmap(nullptr, static_cast<std::size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("cannot map " + filename);
+  }
+  data_ = static_cast<const std::byte*>(data);
+  size_ = static_cast<std::size_t>(size);
+  GetFaults(&faults_at_map_[0], &faults_at_map_[1]);
+  faults_at_check_ = faults_at_map_[0] + faults_at_map_[1];
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<std::byte*>(data_), size_);
+}
+
+void MappedFile::Trim() {
+  if (resident_limit_ == 0) {
+    return;
+  }
+  std::lock_guard lock(mutex_);
+  long minor, major;
+  GetFaults(&minor, &major);
+  auto faults = static_cast<std::size_t>(minor + major - faults_at_check_);
+  if (resident_at_check_ + faults * kMaxBytesPerFault <= resident_limit_) {
+    return;
+  }
+  faults_at_check_ = minor + major;
+  resident_at_check_ = ResidentBytes();
+  if (resident_at_check_ > resident_limit_) {
+    madvise(const_cast<std::byte*>(data_), size_, MADV_DONTNEED);
+    resident_at_check_ = 0;
+    ++trims_;
+  }
+}
+
+std::size_t MappedFile::ResidentBytes() const {
+#if defined(__linux__)
+  // mincore() would report the page cache, which keeps the file after the mapping is released; the Rss of the
+  // mapping in smaps is what this process actually holds.
+  std::ifstream smaps("/proc/self/smaps");
+  std::ostringstream range;
+  range << std::hex << reinterpret_cast<std::uintptr_t>(data_) << '-';
+  std::string prefix = range.str();
+  std::string line;
+  bool found = false;
+  while (std::getline(smaps, line)) {
+    if (!found) {
+      found = line.starts_with(prefix);
+    } else if (line.starts_with("Rss:")) {
+      std::istringstream ss(line.substr(4));
+      std::size_t kilobytes = 0;
+      ss >> kilobytes;
+      return kilobytes * 1024;
+    }
+  }
+#endif
+  return 0;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string&, std::size_t resident_limit) : resident_limit_(resident_limit) {
+  throw std::runtime_error("memory-mapped scenes are not supported on this platform");
+}
+
+MappedFile::~MappedFile() = default;
+
+void MappedFile::Trim() {
+}
+
+std::size_t MappedFile::ResidentBytes() const {
+  return 0;
+}
+
+#endif
+
+PagingStats MappedFile::GetStats() const {
+  long minor, major;
+  GetFaults(&minor, &major);
+  std::lock_guard lock(mutex_);
+  return {size_, ResidentBytes(), resident_limit_, minor - faults_at_map_[0], major - faults_at_map_[1], trims_};
+}
+
+}  // namespace rt::util
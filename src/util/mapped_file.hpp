@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace rt::util {
+
+struct PagingStats {
+  std::size_t mapped_bytes = 0;
+  std::size_t resident_bytes = 0;  // pages of the mapping present in this process
+  std::size_t resident_limit = 0;  // 0 for no limit
+  long minor_faults = 0;           // faults of the whole process since the file was mapped
+  long major_faults = 0;
+  std::size_t trims = 0;  // times the mapping was released to stay under the limit
+};
+
+// A file mapped read-only into memory. Its pages are read on first access and, being clean, can always be dropped
+// and read again, so a mapping larger than RAM only costs page faults.
+class MappedFile {
+ public:
+  // A nonzero resident_limit bounds the bytes of the mapping kept in memory, see Trim().
+  explicit MappedFile(const std::string& filename, std::size_t resident_limit = 0);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  [[nodiscard]] std::size_t Size() const noexcept {
+    return size_;
+  }
+
+  // count elements of type T starting at byte offset, which must be inside the file and suitably aligned.
+  template <typename T>
+  [[nodiscard]] std::span<const T> View(std::uint64_t offset, std::uint64_t count) const {
+    if (offset > size_ || count > (size_ - offset) / sizeof(T) || offset % alignof(T) != 0) {
+      throw std::runtime_error("mapped file is truncated or corrupt");
+    }
+    return {reinterpret_cast<const T*>(data_ + offset), static_cast<std::size_t>(count)};
+  }
+
+  // Releases all pages of the mapping once more than resident_limit bytes of it are in memory. Residency is only
+  // measured after enough page faults have happened to possibly cross the limit, so calling this often is cheap.
+  // Safe to call from several threads rendering the same scene.
+  void Trim();
+
+  [[nodiscard]] PagingStats GetStats() const;
+
+ private:
+  [[nodiscard]] std::size_t ResidentBytes() const;
+
+  const std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t resident_limit_;
+  long faults_at_map_[2] = {0, 0};
+  long faults_at_check_ = 0;
+  std::size_t resident_at_check_ = 0;
+  std::size_t trims_ = 0;
+  mutable std::mutex mutex_;  // guards the *_at_check_ fields and trims_
+};
+
+}  // namespace rt::util
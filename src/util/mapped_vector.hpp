@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace rt::util {
+
+// Array that either owns its elements like a std::vector or is a view of elements stored elsewhere, usually a
+// memory-mapped file or an arena kept alive by `owner`. Reads are the same in both cases. Views of a file are
+// read-only; views of writable storage can grow in place up to its size, and beyond that move into owned storage.
+template <typename T>
+class MappedVector {
+ public:
+  MappedVector() = default;
+
+  MappedVector(std::vector<T> elements) noexcept : owned_(std::move(elements)) {  // NOLINT
+  }
+
+  MappedVector(std::span<const T> elements, std::shared_ptr<const void> owner) noexcept
+    : view_(elements), owner_(std::move(owner)) {
+  }
+
+  // The first size elements of storage, with the rest as room to append to.
+  MappedVector(std::span<T> storage, std::shared_ptr<const void> owner, std::size_t size) noexcept
+    : view_(storage.first(size)), storage_(storage), owner_(std::move(owner)) {
+  }
+
+  [[nodiscard]] bool Mapped() const noexcept {
+    return owner_ != nullptr;
+  }
+
+  [[nodiscard]] const T* data() const noexcept {  // NOLINT
+    return Mapped() ? view_.data() : owned_.data();
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {  // NOLINT
+    return Mapped() ? view_.size() : owned_.size();
+  }
+
+  [[nodiscard]] bool empty() const noexcept {  // NOLINT
+    return size() == 0;
+  }
+
+  // Heap bytes held by the array; mapped elements are not counted.
+  [[nodiscard]] std::size_t capacity() const noexcept {  // NOLINT
+    return owned_.capacity();
+  }
+
+  [[nodiscard]] const T& operator[](std::size_t index) const noexcept {
+    return data()[index];
+  }
+
+  [[nodiscard]] T& operator[](std::size_t index) noexcept {
+    assert(Writable());
+    return Mapped() ? storage_[index] : owned_[index];
+  }
+
+  [[nodiscard]] const T* begin() const noexcept {  // NOLINT
+    return data();
+  }
+
+  [[nodiscard]] const T* end() const noexcept {  // NOLINT
+    return data() + size();
+  }
+
+  void push_back(const T& value) {  // NOLINT
+    assert(Writable());
+    if (Mapped() && view_.size() == storage_.size()) {
+      MoveToOwned(std::max<std::size_t>(2 * view_.size(), 1));
+    }
+    if (!Mapped()) {
+      owned_.push_back(value);
+      return;
+    }
+    storage_[view_.size()] = value;
+    view_ = storage_.first(view_.size() + 1);
+  }
+
+  void reserve(std::size_t size) {  // NOLINT
+    assert(Writable());
+    if (!Mapped()) {
+      owned_.reserve(size);
+    } else if (size > storage_.size()) {
+      MoveToOwned(size);
+    }
+  }
+
+  friend bool operator==(const MappedVector& lhs, const MappedVector& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+
+ private:
+  [[nodiscard]] bool Writable() const noexcept {
+    return !Mapped() || !storage_.empty();
+  }
+
+  void MoveToOwned(std::size_t capacity) {
+    owned_.reserve(capacity);
+    owned_.assign(view_.begin(), view_.end());
+    view_ = {};
+    storage_ = {};
+    owner_.reset();
+  }
+
+  std::vector<T> owned_;
+  std::span<const T> view_;
+  std::span<T> storage_;  // empty for read-only views
+  std::shared_ptr<const void> owner_;
+};
+
+}  // namespace rt::util
@@ -0,0 +1,293 @@
+#include <util/profile.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace rt::util {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t kCounterCount = 4;  // cycles, instructions, cache misses, branch misses
+
+struct Reading {
+  Clock::time_point time;
+  std::array<double, kCounterCount> counts{};
+};
+
+// Counts of one thread. They outlive the thread, so a pool that has been joined can still be reported; once the
+// thread exits, the next new thread adds to them, so there are only as many records as threads ever ran at once.
+struct ThreadRecord {
+  std::size_t thread = 0;
+  bool in_use = false;            // guarded by registry_mutex
+  bool hardware_counters = true;  // while every thread that used the record had them
+  std::array<PhaseCounters, kPhaseCount> phases;
+  std::mutex mutex;  // the thread adds to its counts while GetProfile() may copy them
+};
+
+std::mutex registry_mutex;
+std::deque<ThreadRecord> registry;  // a deque, so records stay put as threads are added
+
+#if defined(__linux__)
+[[nodiscard]] int OpenCounter(std::uint64_t config, int group) noexcept {
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+#endif
+
+// The counter group and the stack of open phases of the calling thread.
+class ThreadCounters {
+ public:
+  ThreadCounters() {
+    {
+      std::lock_guard lock(registry_mutex);
+      auto unused = std::find_if(registry.begin(), registry.end(), [](const ThreadRecord& record) {
+        return !record.in_use;
+      });
+      if (unused != registry.end()) {
+        record_ = &*unused;
+      } else {
+        record_ = &registry.emplace_back();
+        record_->thread = registry.size() - 1;
+      }
+      record_->in_use = true;
+    }
+#if defined(__linux__)
+    constexpr std::array<std::uint64_t, kCounterCount> kConfigs = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    // All or nothing: the group is read in one go, and a partial one would leave columns that can't be compared.
+    for (std::size_t i = 0; i < kCounterCount; ++i) {
+      fds_[i] = OpenCounter(kConfigs[i], i == 0 ? -1 : fds_[0]);
+      if (fds_[i] < 0) {
+        Close();
+        break;
+      }
+    }
+#endif
+    std::lock_guard lock(record_->mutex);
+    record_->hardware_counters = record_->hardware_counters && fds_[0] >= 0;
+  }
+
+  ~ThreadCounters() {
+    Close();
+    std::lock_guard lock(registry_mutex);
+    record_->in_use = false;
+  }
+
+  ThreadCounters(const ThreadCounters&) = delete;
+  ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+  void Enter(Phase phase) {
+    Reading now = Read();
+    std::lock_guard lock(record_->mutex);
+    if (!stack_.empty()) {
+      Add(stack_.back(), now);
+    }
+    stack_.push_back(phase);
+    ++record_->phases[static_cast<std::size_t>(phase)].calls;
+    last_ = now;
+  }
+
+  void Leave() noexcept {
+    Reading now = Read();
+    std::lock_guard lock(record_->mutex);
+    Add(stack_.back(), now);
+    stack_.pop_back();
+    last_ = now;
+  }
+
+ private:
+  [[nodiscard]] Reading Read() const noexcept {
+    Reading reading = last_;
+    reading.time = Clock::now();
+#if defined(__linux__)
+    if (fds_[0] >= 0) {
+      // PERF_FORMAT_GROUP layout: the number of counters, the times enabled and running, then the values.
+      std::array<std::uint64_t, 3 + kCounterCount> buffer{};
+      auto size = static_cast<ssize_t>(sizeof(buffer));
+      if (read(fds_[0], buffer.data(), sizeof(buffer)) == size && buffer[0] == kCounterCount && buffer[2] > 0) {
+        double scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+        for (std::size_t i = 0; i < kCounterCount; ++i) {
+          reading.counts[i] = static_cast<double>(buffer[3 + i]) * scale;
+        }
+      }
+    }
+#endif
+    return reading;
+  }
+
+  // Counts what happened since the last reading towards phase; the caller holds the record's mutex.
+  void Add(Phase phase, const Reading& now) noexcept {
+    PhaseCounters& counters = record_->phases[static_cast<std::size_t>(phase)];
+    counters.seconds += std::chrono::duration<double>(now.time - last_.time).count();
+    auto delta = [&](std::size_t i) {
+      return static_cast<std::uint64_t>(std::llround(std::max(0.0, now.counts[i] - last_.counts[i])));
+    };
+    counters.cycles += delta(0);
+    counters.instructions += delta(1);
+    counters.cache_misses += delta(2);
+    counters.branch_misses += delta(3);
+  }
+
+  void Close() noexcept {
+#if defined(__linux__)
+    for (int& fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+        fd = -1;
+      }
+    }
+#endif
+  }
+
+  ThreadRecord* record_ = nullptr;
+  std::array<int, kCounterCount> fds_ = {-1, -1, -1, -1};
+  std::vector<Phase> stack_;
+  Reading last_;
+};
+
+[[nodiscard]] ThreadCounters& GetThreadCounters() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+void PrintPhases(const std::array<PhaseCounters, kPhaseCount>& phases, bool hardware_counters, std::ostream& out) {
+  out << "  " << std::left << std::setw(14) << "phase" << std::right << std::setw(10) << "calls" << std::setw(12)
+      << "seconds";
+  if (hardware_counters) {
+    out << std::setw(16) << "cycles" << std::setw(16) << "instructions" << std::setw(8) << "IPC" << std::setw(14)
+        << "cache misses" << std::setw(14) << "branch misses";
+  }
+  out << '\n';
+  for (std::size_t i = 0; i < kPhaseCount; ++i) {
+    const PhaseCounters& counters = phases[i];
+    if (counters.calls == 0) {
+      continue;
+    }
+    out << "  " << std::left << std::setw(14) << GetPhaseName(static_cast<Phase>(i)) << std::right << std::setw(10)
+        << counters.calls << std::setw(12) << std::fixed << std::setprecision(4) << counters.seconds;
+    if (hardware_counters) {
+      double ipc = counters.cycles > 0 ? static_cast<double>(counters.instructions) / counters.cycles : 0;
+      out << std::setw(16) << counters.cycles << std::setw(16) << counters.instructions << std::setw(8)
+          << std::setprecision(2) << ipc << std::setw(14) << counters.cache_misses << std::setw(14)
+          << counters.branch_misses;
+    }
+    out << '\n';
+  }
+}
+
+}  // namespace
+
+std::string_view GetPhaseName(Phase phase) noexcept {
+  switch (phase) {
+    case Phase::kSceneLoad:
+      return "scene_load";
+    case Phase::kAccelerationBuild:
+      return "accel_build";
+    case Phase::kPrimaryTracing:
+      return "primary";
+    case Phase::kShading:
+      return "shading";
+    case Phase::kTonemapping:
+      return "tonemap";
+    case Phase::kEncoding:
+      return "encode";
+  }
+  return "unknown";
+}
+
+PhaseCounters& PhaseCounters::operator+=(const PhaseCounters& other) noexcept {
+  calls += other.calls;
+  seconds += other.seconds;
+  cycles += other.cycles;
+  instructions += other.instructions;
+  cache_misses += other.cache_misses;
+  branch_misses += other.branch_misses;
+  return *this;
+}
+
+PhaseCounters Profile::GetTotal(Phase phase) const noexcept {
+  PhaseCounters total;
+  for (const ThreadProfile& thread : threads) {
+    total += thread.phases[static_cast<std::size_t>(phase)];
+  }
+  return total;
+}
+
+void EnableProfiling(bool enabled) noexcept {
+  details::profiling_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+Profile GetProfile() {
+  Profile profile;
+  std::lock_guard lock(registry_mutex);
+  for (ThreadRecord& record : registry) {
+    std::lock_guard record_lock(record.mutex);
+    profile.threads.push_back({record.thread, record.hardware_counters, record.phases});
+  }
+  return profile;
+}
+
+void ResetProfile() {
+  std::lock_guard lock(registry_mutex);
+  for (ThreadRecord& record : registry) {
+    std::lock_guard record_lock(record.mutex);
+    record.phases = {};
+  }
+}
+
+void PrintProfile(const Profile& profile, std::ostream& out) {
+  auto flags = out.flags();
+  auto precision = out.precision();
+  // Totals only add up counters where every thread had them.
+  bool all_hardware = !profile.threads.empty();
+  for (const ThreadProfile& thread : profile.threads) {
+    if (std::all_of(thread.phases.begin(), thread.phases.end(), [](const PhaseCounters& counters) {
+          return counters.calls == 0;
+        })) {
+      continue;
+    }
+    out << "thread " << thread.thread << (thread.hardware_counters ? "" : " (timing only)") << '\n';
+    PrintPhases(thread.phases, thread.hardware_counters, out);
+    all_hardware = all_hardware && thread.hardware_counters;
+  }
+  std::array<PhaseCounters, kPhaseCount> total;
+  for (std::size_t i = 0; i < kPhaseCount; ++i) {
+    total[i] = profile.GetTotal(static_cast<Phase>(i));
+  }
+  out << "all threads" << (all_hardware ? "" : " (timing only)") << '\n';
+  PrintPhases(total, all_hardware, out);
+  out.flags(flags);
+  out.precision(precision);
+}
+
+namespace details {
+
+void EnterPhase(Phase phase) {
+  GetThreadCounters().Enter(phase);
+}
+
+void LeavePhase() noexcept {
+  GetThreadCounters().Leave();
+}
+
+}  // namespace details
+
+}  // namespace rt::util
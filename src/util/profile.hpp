@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace rt::util {
+
+// Parts of a render that profiling tells apart. Shading includes the shadow, reflected and refracted rays of a hit.
+enum class Phase { kSceneLoad, kAccelerationBuild, kPrimaryTracing, kShading, kTonemapping, kEncoding };
+
+inline constexpr std::size_t kPhaseCount = 6;
+
+[[nodiscard]] std::string_view GetPhaseName(Phase phase) noexcept;
+
+struct PhaseCounters {
+  std::uint64_t calls = 0;
+  double seconds = 0;
+  // User-space events, scaled up where the kernel had to multiplex the counters; zero without hardware counters.
+  std::uint64_t cycles = 0;
+  std::uint64_t instructions = 0;
+  std::uint64_t cache_misses = 0;  // last-level cache
+  std::uint64_t branch_misses = 0;
+
+  PhaseCounters& operator+=(const PhaseCounters& other) noexcept;
+};
+
+struct ThreadProfile {
+  // Numbered in the order threads first entered a phase. A thread that exits leaves its number and counts to the next
+  // new one, so a short-lived thread per task doesn't add a row each.
+  std::size_t thread = 0;
+  bool hardware_counters = false;
+  std::array<PhaseCounters, kPhaseCount> phases;
+};
+
+struct Profile {
+  std::vector<ThreadProfile> threads;
+
+  [[nodiscard]] PhaseCounters GetTotal(Phase phase) const noexcept;
+};
+
+// Profiling is off by default, and a phase scope then costs one relaxed load. Once it is on, each thread opens its own
+// group of perf_event_open counters the first time it enters a phase and reads the group, along with the clock,
+// whenever it enters or leaves one. Phases nest and each gets only what is not inside an inner one. Threads whose
+// counters can't be opened (no PMU, e.g. in most VMs, perf_event_paranoid above 2, or not Linux) get timings only.
+void EnableProfiling(bool enabled) noexcept;
+// The counts of every thread that entered a phase, including threads that have exited since, those folded into
+// the threads that took their numbers.
+[[nodiscard]] Profile GetProfile();
+void ResetProfile();
+// A table per thread and one for all of them together.
+void PrintProfile(const Profile& profile, std::ostream& out);
+
+namespace details {
+
+inline std::atomic<bool> profiling_enabled = false;
+
+void EnterPhase(Phase phase);
+void LeavePhase() noexcept;
+
+}  // namespace details
+
+// Counts the enclosing block towards a phase while profiling is on.
+class PhaseScope {
+ public:
+  explicit PhaseScope(Phase phase) : active_(details::profiling_enabled.load(std::memory_order_relaxed)) {
+    if (active_) {
+      details::EnterPhase(phase);
+    }
+  }
+
+  ~PhaseScope() {
+    if (active_) {
+      details::LeavePhase();
+    }
+  }
+
+  PhaseScope(const PhaseScope&) = delete;
+  PhaseScope& operator=(const PhaseScope&) = delete;
+
+ private:
+  bool active_;
+};
+
+}  // namespace rt::util
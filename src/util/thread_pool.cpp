@@ -0,0 +1,75 @@
+#include <util/thread_pool.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace rt::util {
+
+ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  workers_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(&ThreadPool::Work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  has_task_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  has_task_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock lock(mutex_);
+  idle_.wait(lock, [this] {
+    return tasks_.empty() && running_ == 0;
+  });
+}
+
+std::size_t ThreadPool::QueueDepth() const {
+  std::lock_guard lock(mutex_);
+  return tasks_.size();
+}
+
+std::size_t ThreadPool::Running() const {
+  std::lock_guard lock(mutex_);
+  return running_;
+}
+
+void ThreadPool::Work() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    has_task_.wait(lock, [this] {
+      return !tasks_.empty() || stopping_;
+    });
+    if (tasks_.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    ++running_;
+    lock.unlock();
+    task();
+    lock.lock();
+    if (--running_ == 0 && tasks_.empty()) {
+      idle_.notify_all();
+    }
+  }
+}
+
+}  // namespace rt::util
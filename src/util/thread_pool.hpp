@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rt::util {
+
+// Fixed set of worker threads running submitted tasks in submission order. Tasks must not throw; the destructor
+// runs the tasks still queued and joins the workers.
+class ThreadPool {
+ public:
+  // 0 threads means one per hardware thread.
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Submit(std::function<void()> task);
+  // Blocks until every submitted task has finished.
+  void Wait();
+
+  [[nodiscard]] std::size_t Size() const noexcept {
+    return workers_.size();
+  }
+
+  // Tasks submitted but not yet started.
+  [[nodiscard]] std::size_t QueueDepth() const;
+  // Tasks currently running.
+  [[nodiscard]] std::size_t Running() const;
+
+ private:
+  void Work();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::size_t running_ = 0;
+  bool stopping_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable has_task_;
+  std::condition_variable idle_;
+};
+
+}  // namespace rt::util
@@ -0,0 +1,171 @@
+#include <util/trace.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace rt::util {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct SpanRecord {
+  const char* name;
+  std::int64_t begin;  // nanoseconds since the first span of the process
+  std::int64_t end;
+  std::string detail;
+};
+
+// Spans of one thread. The buffer outlives the thread, and its mutex is only ever contended by WriteTrace() and
+// ClearTrace(). Once the thread exits, the next new thread takes the buffer and its track over, so there are only as
+// many buffers as threads ever ran at once.
+struct ThreadTrace {
+  std::size_t thread = 0;
+  bool in_use = false;  // guarded by registry_mutex
+  std::vector<SpanRecord> spans;
+  std::mutex mutex;
+};
+
+std::mutex registry_mutex;
+std::deque<ThreadTrace> registry;  // a deque, so buffers stay put as threads are added
+
+// Holds the buffer of the calling thread until it exits.
+class ThreadTraceSlot {
+ public:
+  ThreadTraceSlot() {
+    std::lock_guard lock(registry_mutex);
+    auto unused = std::find_if(registry.begin(), registry.end(), [](const ThreadTrace& trace) {
+      return !trace.in_use;
+    });
+    if (unused != registry.end()) {
+      trace_ = &*unused;
+    } else {
+      trace_ = &registry.emplace_back();
+      trace_->thread = registry.size() - 1;
+    }
+    trace_->in_use = true;
+  }
+
+  ~ThreadTraceSlot() {
+    std::lock_guard lock(registry_mutex);
+    trace_->in_use = false;
+  }
+
+  ThreadTraceSlot(const ThreadTraceSlot&) = delete;
+  ThreadTraceSlot& operator=(const ThreadTraceSlot&) = delete;
+
+  [[nodiscard]] ThreadTrace& Get() const noexcept {
+    return *trace_;
+  }
+
+ private:
+  ThreadTrace* trace_ = nullptr;
+};
+
+[[nodiscard]] ThreadTrace& GetThreadTrace() {
+  thread_local ThreadTraceSlot slot;
+  return slot.Get();
+}
+
+void WriteEscaped(std::ostream& out, std::string_view text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    } else {
+      out << c;
+    }
+  }
+}
+
+}  // namespace
+
+void StartTracing() noexcept {
+  details::tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTracing() noexcept {
+  details::tracing_enabled.store(false, std::memory_order_relaxed);
+}
+
+void ClearTrace() {
+  std::lock_guard lock(registry_mutex);
+  for (ThreadTrace& trace : registry) {
+    std::lock_guard trace_lock(trace.mutex);
+    trace.spans.clear();
+  }
+}
+
+void WriteTrace(const std::string& filename) {
+  std::ofstream out(filename);
+  if (!out) {
+    throw std::runtime_error("can't open " + filename);
+  }
+  // Complete ("X") events with microsecond timestamps, and a name for each thread's track.
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto separate = [&] {
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+  std::lock_guard lock(registry_mutex);
+  for (ThreadTrace& trace : registry) {
+    std::lock_guard trace_lock(trace.mutex);
+    if (trace.spans.empty()) {
+      continue;
+    }
+    separate();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace.thread
+        << ",\"args\":{\"name\":\"thread " << trace.thread << "\"}}";
+    for (const SpanRecord& span : trace.spans) {
+      separate();
+      out << "{\"name\":\"";
+      WriteEscaped(out, span.name);
+      out << "\",\"cat\":\"rt\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace.thread
+          << ",\"ts\":" << static_cast<double>(span.begin) / 1000
+          << ",\"dur\":" << static_cast<double>(span.end - span.begin) / 1000;
+      if (!span.detail.empty()) {
+        out << ",\"args\":{\"detail\":\"";
+        WriteEscaped(out, span.detail);
+        out << "\"}";
+      }
+      out << '}';
+    }
+  }
+  out << "\n]}\n";
+  if (!out) {
+    throw std::runtime_error("can't write " + filename);
+  }
+}
+
+namespace details {
+
+std::int64_t TraceNow() noexcept {
+  static const Clock::time_point epoch = Clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+}
+
+void RecordSpan(const char* name, std::int64_t begin, std::int64_t end, std::string detail) noexcept {
+  try {
+    ThreadTrace& trace = GetThreadTrace();
+    std::lock_guard lock(trace.mutex);
+    trace.spans.push_back({name, begin, end, std::move(detail)});
+  } catch (...) {
+    // Out of memory: the span is lost, the render goes on.
+  }
+}
+
+}  // namespace details
+
+}  // namespace rt::util
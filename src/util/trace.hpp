@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Timeline tracing. Spans are only recorded in builds configured with -DRT_TRACING=ON; elsewhere RT_TRACE_SPAN
+// expands to nothing and its arguments are not evaluated. In tracing builds a span costs one relaxed load until
+// StartTracing() is called, and then two clock reads and an append to a buffer of the calling thread.
+#if defined(RT_TRACING)
+#define RT_TRACE_CONCAT_IMPL(a, b) a##b
+#define RT_TRACE_CONCAT(a, b) RT_TRACE_CONCAT_IMPL(a, b)
+// Records the rest of the enclosing block as a span: RT_TRACE_SPAN("name") or RT_TRACE_SPAN("name", detail), where
+// name is a string literal and detail an expression giving a std::string shown with the span. The detail is only
+// evaluated when the span is recorded.
+#define RT_TRACE_SPAN(name, ...)                                         \
+  const ::rt::util::TraceSpan RT_TRACE_CONCAT(rt_trace_span_, __LINE__)( \
+    name __VA_OPT__(, [&]() -> std::string { return __VA_ARGS__; }))
+#else
+#define RT_TRACE_SPAN(...) static_cast<void>(0)
+#endif
+
+namespace rt::util {
+
+#if defined(RT_TRACING)
+inline constexpr bool kTracingBuilt = true;
+#else
+inline constexpr bool kTracingBuilt = false;
+#endif
+
+// Recording is off until started; starting again keeps the spans recorded so far.
+void StartTracing() noexcept;
+void StopTracing() noexcept;
+// Drops the spans recorded so far.
+void ClearTrace();
+// Writes the spans of every thread, including threads that have exited, as Chrome trace_event JSON, which Perfetto
+// and chrome://tracing open; each thread is a track, which a new thread takes over once its thread exits. Throws
+// std::runtime_error if the file can't be written.
+void WriteTrace(const std::string& filename);
+
+namespace details {
+
+inline std::atomic<bool> tracing_enabled = false;
+
+[[nodiscard]] std::int64_t TraceNow() noexcept;
+// Drops the span if it can't be stored.
+void RecordSpan(const char* name, std::int64_t begin, std::int64_t end, std::string detail) noexcept;
+
+}  // namespace details
+
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name, std::string detail = {})
+    : name_(name), recording_(details::tracing_enabled.load(std::memory_order_relaxed)) {
+    if (recording_) {
+      detail_ = std::move(detail);
+      begin_ = details::TraceNow();
+    }
+  }
+
+  // Calls make_detail() for the detail only if the span is recorded.
+  template <typename MakeDetail>
+    requires std::is_invocable_r_v<std::string, MakeDetail&>
+  TraceSpan(const char* name, MakeDetail&& make_detail)
+    : name_(name), recording_(details::tracing_enabled.load(std::memory_order_relaxed)) {
+    if (recording_) {
+      detail_ = make_detail();
+      begin_ = details::TraceNow();
+    }
+  }
+
+  ~TraceSpan() {
+    if (recording_) {
+      details::RecordSpan(name_, begin_, details::TraceNow(), std::move(detail_));
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  bool recording_;
+  std::int64_t begin_ = 0;
+  std::string detail_;
+};
+
+}  // namespace rt::util
@@ -0,0 +1,195 @@
+#include <accel/bvh.hpp>
+#include <geometry/geometry.hpp>
+#include <raytracer/matrix.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr double kErr = 1e-9;
+
+using namespace rt::geom;
+
+[[nodiscard]] std::vector<Triangle> RandomTriangles(std::mt19937& gen, int count) {
+  std::uniform_real_distribution<double> coord(-10., 10.);
+  std::uniform_real_distribution<double> offset(-1., 1.);
+  std::vector<Triangle> triangles;
+  for (int i = 0; i < count; ++i) {
+    Vector base{coord(gen), coord(gen), coord(gen)};
+    triangles.push_back({base, base + Vector{offset(gen), offset(gen), offset(gen)},
+                         base + Vector{offset(gen), offset(gen), offset(gen)}});
+  }
+  return triangles;
+}
+
+TEST(BvhClosestHit, Raytracer) {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> coord(-12., 12.);
+  auto triangles = RandomTriangles(gen, 300);
+  std::vector<Bounds> bounds;
+  for (const auto& triangle : triangles) {
+    bounds.push_back(GetBounds(triangle));
+  }
+  rt::accel::Bvh bvh(bounds);
+  EXPECT_EQ(bvh.GetIndices().size(), triangles.size());
+
+  for (int i = 0; i < 1000; ++i) {
+    Ray ray{{coord(gen), coord(gen), coord(gen)}, {coord(gen), coord(gen), coord(gen)}};
+    std::optional<double> expected;
+    for (const auto& triangle : triangles) {
+      auto intersection = GetIntersection(ray, triangle);
+      if (intersection && (!expected || intersection->GetDistance() < *expected)) {
+        expected = intersection->GetDistance();
+      }
+    }
+
+    std::optional<double> actual;
+    double t_max = std::numeric_limits<double>::infinity();
+    bvh.Traverse(ray, t_max, [&](std::uint32_t index) {
+      auto intersection = GetIntersection(ray, triangles[index]);
+      if (intersection && intersection->GetDistance() < t_max) {
+        actual = t_max = intersection->GetDistance();
+      }
+      return false;
+    });
+    ASSERT_EQ(actual.has_value(), expected.has_value());
+    if (actual) {
+      EXPECT_EQ(*actual, *expected);
+    }
+  }
+}
+
+TEST(BvhRefit, Raytracer) {
+  std::mt19937 gen(13);
+  std::uniform_real_distribution<double> coord(-12., 12.);
+  auto triangles = RandomTriangles(gen, 300);
+  std::vector<Bounds> bounds;
+  for (const auto& triangle : triangles) {
+    bounds.push_back(GetBounds(triangle));
+  }
+  rt::accel::Bvh bvh(bounds);
+  auto bounds_of = [&triangles](std::uint32_t index) {
+    return GetBounds(triangles[index]);
+  };
+  auto move = [&](std::size_t index) {
+    Vector shift{coord(gen), coord(gen), coord(gen)};
+    triangles[index] = {triangles[index].GetVertex(0) + shift, triangles[index].GetVertex(1) + shift,
+                        triangles[index].GetVertex(2) + shift};
+  };
+  auto check = [&] {
+    for (int i = 0; i < 300; ++i) {
+      Ray ray{{coord(gen), coord(gen), coord(gen)}, {coord(gen), coord(gen), coord(gen)}};
+      std::optional<double> expected;
+      for (const auto& triangle : triangles) {
+        auto intersection = GetIntersection(ray, triangle);
+        if (intersection && (!expected || intersection->GetDistance() < *expected)) {
+          expected = intersection->GetDistance();
+        }
+      }
+      std::optional<double> actual;
+      double t_max = std::numeric_limits<double>::infinity();
+      bvh.Traverse(ray, t_max, [&](std::uint32_t index) {
+        auto intersection = GetIntersection(ray, triangles[index]);
+        if (intersection && intersection->GetDistance() < t_max) {
+          actual = t_max = intersection->GetDistance();
+        }
+        return false;
+      });
+      ASSERT_EQ(actual.has_value(), expected.has_value());
+      if (actual) {
+        EXPECT_EQ(*actual, *expected);
+      }
+    }
+  };
+
+  for (std::uint32_t index : {0u, 17u, 299u}) {
+    move(index);
+    bvh.Refit(index, bounds_of);
+  }
+  check();
+
+  for (std::size_t i = 0; i < triangles.size(); i += 2) {
+    move(i);
+  }
+  bvh.Refit(bounds_of);
+  check();
+  EXPECT_EQ(bvh.GetNodes().size(), bvh.GetStats().nodes);
+}
+
+TEST(BvhEmpty, Raytracer) {
+  rt::accel::Bvh bvh(std::vector<Bounds>{});
+  EXPECT_TRUE(bvh.Empty());
+  EXPECT_TRUE(bvh.GetBounds().Empty());
+  bool visited = false;
+  bvh.Traverse({{0, 0, 0}, {1, 0, 0}}, std::numeric_limits<double>::infinity(), [&](std::uint32_t) {
+    visited = true;
+    return false;
+  });
+  EXPECT_FALSE(visited);
+}
+
+TEST(BvhParallelBuild, Raytracer) {
+  std::mt19937 gen(11);
+  auto triangles = RandomTriangles(gen, 5000);
+  std::vector<Bounds> bounds;
+  for (const auto& triangle : triangles) {
+    bounds.push_back(GetBounds(triangle));
+  }
+  rt::accel::Bvh serial(bounds, {1});
+  // a low threshold makes even this small input take the parallel binning and subtree paths
+  rt::accel::Bvh parallel(bounds, {4, 64});
+  ASSERT_EQ(serial.GetNodes().size(), parallel.GetNodes().size());
+  for (std::size_t i = 0; i < serial.GetNodes().size(); ++i) {
+    const auto& lhs = serial.GetNodes()[i];
+    const auto& rhs = parallel.GetNodes()[i];
+    EXPECT_EQ(lhs.first, rhs.first);
+    EXPECT_EQ(lhs.count, rhs.count);
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      EXPECT_EQ(lhs.bounds.Min()[axis], rhs.bounds.Min()[axis]);
+      EXPECT_EQ(lhs.bounds.Max()[axis], rhs.bounds.Max()[axis]);
+    }
+  }
+  EXPECT_EQ(serial.GetIndices(), parallel.GetIndices());
+
+  const auto& stats = parallel.GetStats();
+  EXPECT_EQ(stats.primitives, triangles.size());
+  EXPECT_EQ(stats.nodes, 2 * stats.leaves - 1);
+  EXPECT_EQ(stats.threads, 4);
+  EXPECT_LT(stats.max_depth, 64);
+  EXPECT_GT(stats.sah_cost, 0);
+  // far cheaper than testing every primitive
+  EXPECT_LT(stats.sah_cost, triangles.size() / 20.);
+  EXPECT_EQ(stats.sah_cost, serial.GetStats().sah_cost);
+}
+
+TEST(BvhCoincident, Raytracer) {
+  std::vector<Bounds> bounds(10, Bounds{{0, 0, 0}, {1, 1, 1}});
+  rt::accel::Bvh bvh(bounds);
+  ASSERT_EQ(bvh.GetNodes().size(), 1);
+  EXPECT_EQ(bvh.GetNodes()[0].count, 10);
+}
+
+TEST(MatrixInverse, Raytracer) {
+  rt::Matrix m = rt::MakeIdentity();
+  m[0] = {0., 2., 0., 0.};
+  m[1] = {-1., 0., 0., 0.};
+  m[2] = {0., 0., 3., 0.};
+  m[3] = {5., -2., 1., 1.};
+  rt::Matrix inverse = rt::Inverse(m);
+  Vector point{0.3, -1.7, 2.5};
+  Vector back = inverse.multiply_vector(m.multiply_vector(point));
+  for (std::size_t i = 0; i < 3; ++i) {
+    EXPECT_LT(std::fabs(back[i] - point[i]), kErr);
+  }
+  EXPECT_TRUE(rt::IsIdentity(rt::MakeIdentity()));
+  EXPECT_FALSE(rt::IsIdentity(m));
+}
+
+}  // namespace
@@ -0,0 +1,59 @@
+#include <generator/generator.hpp>
+#include <scene/reader.hpp>
+#include <utils/scene.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(SceneGenerator, Raytracer) {
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_generated.obj").string();
+  rt::generator::GeneratorOptions options{
+    .triangles = 5001, .spheres = 7, .lights = 3, .reflective = 0.3, .refractive = 0.2, .seed = 5, .tile_size = 8};
+  auto generated = rt::generator::GenerateScene(options, filename);
+  EXPECT_EQ(generated.triangles, 5001);
+  EXPECT_GT(generated.groups, 1);
+  EXPECT_EQ(generated.bytes, std::filesystem::file_size(filename));
+
+  // Exactly the requested counts, one group per tile, and the same scene however the file is split between threads.
+  const auto scene = rt::ReadScene(filename, {1});
+  EXPECT_EQ(scene.GetObjects().size(), 5001);
+  EXPECT_EQ(scene.GetObjects().VertexCount(), generated.vertices);
+  EXPECT_EQ(scene.GetMeshes().size(), generated.groups);
+  EXPECT_EQ(scene.GetSphereObjects().size(), 7);
+  EXPECT_EQ(scene.GetLights().size(), 3);
+  ExpectSameScene(scene, rt::ReadScene(filename, {4, 1}));
+  bool reflective = false;
+  bool refractive = false;
+  for (const auto& sphere : scene.GetSphereObjects()) {
+    const auto& albedo = scene.GetMaterials()[sphere.material].albedo;
+    reflective = reflective || albedo[1] > 0;
+    refractive = refractive || albedo[2] > 0;
+  }
+  EXPECT_TRUE(reflective || refractive);
+
+  // The options alone decide the file.
+  auto read = [&filename] {
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), {});
+  };
+  std::string contents = read();
+  (void)rt::generator::GenerateScene(options, filename);
+  EXPECT_EQ(read(), contents);
+  options.seed = 6;
+  (void)rt::generator::GenerateScene(options, filename);
+  EXPECT_NE(read(), contents);
+
+  options.reflective = 0.9;
+  EXPECT_THROW((void)rt::generator::GenerateScene(options, filename), std::runtime_error);
+  std::filesystem::remove(filename);
+  std::filesystem::remove(std::filesystem::path(filename).replace_extension(".mtl"));
+}
+
+}  // namespace
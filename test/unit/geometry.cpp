@@ -1,7 +1,11 @@
 #include <geometry/geometry.hpp>
+#include <geometry/octahedral.hpp>
+#include <geometry/sphere_batch.hpp>
 
 #include <cmath>
 #include <optional>
+#include <random>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -151,6 +155,63 @@ TEST(Intersection, Raytracer) {
   EXPECT_TRUE(!intersection);
 }
 
+TEST(SphereBatch, Raytracer) {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> coord(-10., 10.);
+  std::uniform_real_distribution<double> radius(0.1, 2.);
+
+  std::vector<Sphere> spheres;
+  SphereBatch batch;
+  for (int i = 0; i < 37; ++i) {
+    spheres.emplace_back(Vector{coord(gen), coord(gen), coord(gen)}, radius(gen));
+    batch.Add(spheres.back());
+  }
+  EXPECT_EQ(batch.Size(), 37);
+
+  for (int i = 0; i < 500; ++i) {
+    Ray ray{{coord(gen), coord(gen), coord(gen)}, {coord(gen), coord(gen), coord(gen)}};
+    std::optional<std::size_t> expected_index;
+    double expected_distance = 0;
+    for (std::size_t j = 0; j < spheres.size(); ++j) {
+      auto intersection = GetIntersection(ray, spheres[j]);
+      if (intersection && (!expected_index || intersection->GetDistance() < expected_distance)) {
+        expected_index = j;
+        expected_distance = intersection->GetDistance();
+      }
+    }
+    auto hit = batch.FindNearest(ray);
+    ASSERT_EQ(hit.has_value(), expected_index.has_value());
+    if (hit) {
+      EXPECT_EQ(hit->index, *expected_index);
+      EXPECT_EQ(hit->distance, expected_distance);
+      // the kernel's hit alone gives the same point and normal as the scalar test
+      Intersection made = MakeSphereIntersection(ray, spheres[hit->index], hit->distance);
+      Intersection scalar = *GetIntersection(ray, spheres[hit->index]);
+      for (std::size_t j = 0; j < 3; ++j) {
+        EXPECT_EQ(made.GetPosition()[j], scalar.GetPosition()[j]);
+        EXPECT_EQ(made.GetNormal()[j], scalar.GetNormal()[j]);
+      }
+    }
+  }
+}
+
+TEST(Octahedral, Raytracer) {
+  std::mt19937 gen(42);
+  std::normal_distribution<double> coord;
+
+  std::vector<Vector> normals{{1, 0, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {-1, -1, -1}, {1, -1, -1e-9}};
+  for (int i = 0; i < 1000; ++i) {
+    normals.push_back({coord(gen), coord(gen), coord(gen)});
+  }
+  for (auto& normal : normals) {
+    normal.Normalize();
+    Vector decoded = DecodeOctahedral(EncodeOctahedral(normal));
+    EXPECT_LT(std::fabs(Length(decoded) - 1), kErr);
+    EXPECT_GT(DotProduct(decoded, normal), std::cos(1e-4));
+  }
+  EXPECT_EQ(DecodeOctahedral(EncodeOctahedral({0, 1, 0}))[1], 1.);
+}
+
 TEST(RefractReflect, Raytracer) {
   Vector normal{0, 1, 0};
   Vector ray{0.707107, -0.707107, 0};
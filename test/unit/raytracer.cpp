@@ -1,11 +1,32 @@
+#include <batch/batch.hpp>
 #include <raytracer/camera_options.hpp>
+#include <raytracer/camera_rays.hpp>
+#include <raytracer/deadline.hpp>
+#include <raytracer/image_diff.hpp>
+#include <raytracer/matrix.hpp>
 #include <raytracer/raytracer.hpp>
+#include <raytracer/relight.hpp>
 #include <raytracer/render_options.hpp>
+#include <raytracer/sequence.hpp>
+#include <raytracer/tile.hpp>
+#include <raytracer/tonemap.hpp>
+#include <scene/geometry_file.hpp>
+#include <scene/reader.hpp>
+#include <util/profile.hpp>
+#include <util/trace.hpp>
 #include <utils/diff.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <optional>
+#include <random>
+#include <stop_token>
+#include <stdexcept>
 #include <string>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -85,3 +106,587 @@ TEST(Deer, Raytracer) {
   RenderOptions render_opts{1};
   CheckImage("deer/CERF_Free.obj", "deer/result.png", camera_opts, render_opts);
 }
+
+TEST(Lod, Raytracer) {
+  CameraOptions camera_opts(500, 500);
+  camera_opts.look_from = std::array<double, 3>{100, 200, 150};
+  camera_opts.look_to = std::array<double, 3>{0.0, 100.0, 0.0};
+  RenderOptions render_opts{1};
+  const auto scene = rt::ReadScene("../../test/models/deer/CERF_Free.obj", {.build_lods = true});
+  Compare(rt::Render(scene, camera_opts, render_opts), rt::image::Image("../../test/models/deer/result.png"));
+
+  // Far enough for the simplified deer to stand in for the full one.
+  camera_opts.look_from = std::array<double, 3>{6000, 12000, 9000};
+  rt::CameraRays camera(camera_opts);
+  auto levels = scene.SelectLods(camera.GetOrigin(), render_opts.lod_pixel_error * camera.GetPixelAngle());
+  ASSERT_EQ(levels.size(), 1);
+  EXPECT_GT(levels[0], 0);
+  auto image = rt::Render(scene, camera_opts, render_opts);
+  render_opts.lod_pixel_error = 0;
+  Compare(image, rt::Render(scene, camera_opts, render_opts));
+}
+
+TEST(Relight, Raytracer) {
+  CameraOptions camera_opts(320, 240, M_PI / 3);
+  camera_opts.look_from = std::array<double, 3>{0.0, 0.7, 1.75};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.7, 0.0};
+  RenderOptions render_opts{4};
+  auto scene = rt::ReadScene("../../test/models/box/cube.obj");
+  auto expect_same = [&](const rt::image::Image& image) {
+    auto expected = rt::Render(scene, camera_opts, render_opts);
+    for (int y = 0; y < image.Height(); ++y) {
+      for (int x = 0; x < image.Width(); ++x) {
+        ASSERT_EQ(image.GetPixel(y, x), expected.GetPixel(y, x));
+      }
+    }
+  };
+  rt::RelightSession session(scene, camera_opts, render_opts);
+  expect_same(session.Render());
+  auto rays = session.GetStats().shadow_rays;
+  EXPECT_GT(rays, 0);
+
+  // A brighter light needs no new shadow rays, a moved one needs them for itself only.
+  scene.SetLight(1, {scene.GetLights()[1].position, {2, 1.5, 1}});
+  expect_same(session.Render());
+  EXPECT_EQ(session.GetStats().shadow_rays, rays);
+  EXPECT_EQ(session.GetStats().lights_reused, 2);
+  scene.SetLight(0, {{0.3, 0.9, 1.5}, scene.GetLights()[0].intensity});
+  expect_same(session.Render());
+  EXPECT_EQ(session.GetStats().shadow_rays, 3 * rays / 2);
+
+  auto material = *scene.GetMaterials().Find("backWall");
+  rt::Material edited = scene.GetMaterials()[material];
+  edited.diffuse_color = {0.9, 0.2, 0.1};
+  edited.albedo = {0.5, 0.4, 0};
+  scene.SetMaterial(material, edited);
+  EXPECT_EQ(scene.GetMaterials()[material].name, "backWall");
+  expect_same(session.Render());
+  EXPECT_EQ(session.GetStats().renders, 4);
+
+  render_opts.mode = RenderMode::kDepth;
+  EXPECT_THROW(rt::RelightSession(scene, camera_opts, render_opts), std::runtime_error);
+}
+
+TEST(Deadline, Raytracer) {
+  CameraOptions camera_opts(320, 240, M_PI / 3);
+  camera_opts.look_from = std::array<double, 3>{0.0, 0.7, 1.75};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.7, 0.0};
+  RenderOptions render_opts{4};
+  auto scene = rt::ReadScene("../../test/models/box/cube.obj");
+  auto expected = rt::Render(scene, camera_opts, render_opts);
+
+  // Without a deadline every tile is traced in full and the image is that of Render.
+  auto full = rt::RenderWithDeadline(scene, camera_opts, render_opts, {});
+  EXPECT_EQ(full.quality, rt::RenderQuality::kFull);
+  EXPECT_EQ(full.full_tiles, 80);
+  EXPECT_FALSE(full.stopped);
+  EXPECT_EQ(rt::image::CompareImages(full.image, expected).max_error, 0);
+
+  // A stop or a deadline that has passed still leaves the preview of the whole frame.
+  std::stop_source stop;
+  stop.request_stop();
+  rt::DeadlineOptions deadline_opts;
+  deadline_opts.stop_token = stop.get_token();
+  auto stopped = rt::RenderWithDeadline(scene, camera_opts, render_opts, deadline_opts);
+  EXPECT_EQ(stopped.quality, rt::RenderQuality::kPreview);
+  EXPECT_EQ(stopped.preview_tiles, 80);
+  EXPECT_TRUE(stopped.stopped);
+  EXPECT_GT(rt::image::CompareImages(stopped.image, expected).psnr, 15);
+
+  deadline_opts = {};
+  deadline_opts.deadline = std::chrono::steady_clock::now();
+  deadline_opts.tile_size = 100;
+  auto late = rt::RenderWithDeadline(scene, camera_opts, render_opts, deadline_opts);
+  EXPECT_EQ(late.quality, rt::RenderQuality::kPreview);
+  EXPECT_EQ(late.preview_tiles, 12);
+  EXPECT_FALSE(late.stopped);
+
+  deadline_opts.tile_size = 0;
+  EXPECT_THROW((void)rt::RenderWithDeadline(scene, camera_opts, render_opts, deadline_opts), std::runtime_error);
+}
+
+TEST(Profile, Raytracer) {
+  CameraOptions camera_opts(160, 120, M_PI / 3);
+  camera_opts.look_from = std::array<double, 3>{0.0, 0.7, 1.75};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.7, 0.0};
+  auto output = (std::filesystem::temp_directory_path() / "rt_unit_profile.png").string();
+  rt::util::EnableProfiling(true);
+  rt::util::ResetProfile();
+  rt::Render("../../test/models/box/cube.obj", camera_opts, RenderOptions{4}).Write(output);
+  rt::util::EnableProfiling(false);
+  auto profile = rt::util::GetProfile();
+  for (auto phase : {rt::util::Phase::kSceneLoad, rt::util::Phase::kAccelerationBuild,
+                     rt::util::Phase::kPrimaryTracing, rt::util::Phase::kShading, rt::util::Phase::kTonemapping,
+                     rt::util::Phase::kEncoding}) {
+    EXPECT_GT(profile.GetTotal(phase).calls, 0) << rt::util::GetPhaseName(phase);
+  }
+  // One primary pass and one shading pass per 16x16 block.
+  EXPECT_EQ(profile.GetTotal(rt::util::Phase::kPrimaryTracing).calls, 80);
+  EXPECT_EQ(profile.GetTotal(rt::util::Phase::kShading).calls, 80);
+  EXPECT_GT(profile.GetTotal(rt::util::Phase::kShading).seconds, 0);
+  for (const auto& thread : profile.threads) {
+    if (thread.hardware_counters && thread.phases[static_cast<std::size_t>(rt::util::Phase::kShading)].calls > 0) {
+      EXPECT_GT(thread.phases[static_cast<std::size_t>(rt::util::Phase::kShading)].instructions, 0);
+    }
+  }
+
+  // The next pool's threads take over the records of the joined ones, counts included.
+  rt::util::EnableProfiling(true);
+  (void)rt::Render("../../test/models/box/cube.obj", camera_opts, RenderOptions{4});
+  rt::util::EnableProfiling(false);
+  auto again = rt::util::GetProfile();
+  EXPECT_EQ(again.threads.size(), profile.threads.size());
+  EXPECT_EQ(again.GetTotal(rt::util::Phase::kShading).calls, 160);
+
+  // Switched off, nothing is counted.
+  rt::util::ResetProfile();
+  (void)rt::Render("../../test/models/box/cube.obj", camera_opts, RenderOptions{4});
+  EXPECT_EQ(rt::util::GetProfile().GetTotal(rt::util::Phase::kShading).calls, 0);
+}
+
+TEST(Trace, Raytracer) {
+  auto filename = (std::filesystem::temp_directory_path() / "rt_unit_trace.json").string();
+  rt::util::ClearTrace();
+  rt::util::StartTracing();
+  {
+    rt::util::TraceSpan outer("outer", "a \"quoted\" detail");
+    rt::util::TraceSpan inner("inner");
+  }
+  std::thread([] {
+    rt::util::TraceSpan span("worker");
+  }).join();
+  std::thread([] {
+    rt::util::TraceSpan span("next worker");
+  }).join();
+  CameraOptions camera_opts(64, 48, M_PI / 3);
+  camera_opts.look_from = std::array<double, 3>{0.0, 0.7, 1.75};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.7, 0.0};
+  (void)rt::Render("../../test/models/box/cube.obj", camera_opts, RenderOptions{1});
+  int details = 0;
+  {
+    RT_TRACE_SPAN("counted", std::to_string(++details));
+  }
+  rt::util::StopTracing();
+  {
+    rt::util::TraceSpan ignored("stopped");
+    RT_TRACE_SPAN("stopped", std::to_string(++details));
+  }
+  // Details are built for recorded spans only.
+  EXPECT_EQ(details, rt::util::kTracingBuilt ? 1 : 0);
+  rt::util::WriteTrace(filename);
+
+  std::ifstream file(filename);
+  std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  EXPECT_TRUE(json.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE(json.find("\"name\":\"outer\""), std::string::npos);
+  EXPECT_NE(json.find("\"detail\":\"a \\\"quoted\\\" detail\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"inner\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"worker\""), std::string::npos);
+  // The second worker takes over the exited one's track.
+  auto tid = [&json](std::string_view name) {
+    auto event = json.find("\"name\":\"" + std::string(name) + "\"");
+    return event == std::string::npos ? std::string() : json.substr(json.find("\"tid\":", event), 10);
+  };
+  EXPECT_FALSE(tid("worker").empty());
+  EXPECT_EQ(tid("worker"), tid("next worker"));
+  EXPECT_EQ(json.find("\"name\":\"stopped\""), std::string::npos);
+  // The library's own spans only exist in tracing builds.
+  EXPECT_EQ(json.find("\"name\":\"tile\"") != std::string::npos, rt::util::kTracingBuilt);
+  EXPECT_EQ(json.find("\"detail\":\"0,0 64x48\"") != std::string::npos, rt::util::kTracingBuilt);
+  rt::util::ClearTrace();
+}
+
+TEST(Instances, Raytracer) {
+  CameraOptions camera_opts(640, 480);
+  camera_opts.look_from = std::array<double, 3>{0.5, 2.5, 5.0};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.3, 0.0};
+  RenderOptions render_opts{2};
+  auto image = rt::Render("../../test/models/instances/scene.obj", camera_opts, render_opts);
+  auto flat_image = rt::Render("../../test/models/instances/flat.obj", camera_opts, render_opts);
+  Compare(image, flat_image);
+}
+
+TEST(MaterialSorted, Raytracer) {
+  CameraOptions camera_opts(640, 480, M_PI / 3);
+  camera_opts.look_from = std::array<double, 3>{0.0, 0.7, 1.75};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.7, 0.0};
+  RenderOptions render_opts{4};
+  auto image = rt::Render("../../test/models/box/cube.obj", camera_opts, render_opts);
+  render_opts.sort_by_material = true;
+  auto sorted_image = rt::Render("../../test/models/box/cube.obj", camera_opts, render_opts);
+  for (int y = 0; y < image.Height(); ++y) {
+    for (int x = 0; x < image.Width(); ++x) {
+      ASSERT_EQ(image.GetPixel(y, x), sorted_image.GetPixel(y, x));
+    }
+  }
+}
+
+TEST(GeometryFile, Raytracer) {
+  CameraOptions camera_opts(640, 480);
+  camera_opts.look_from = std::array<double, 3>{0.5, 2.5, 5.0};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.3, 0.0};
+  RenderOptions render_opts{2};
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_raytracer_instances.rtg").string();
+  rt::WriteGeometryFile(rt::ReadScene("../../test/models/instances/scene.obj"), filename);
+  auto image = rt::Render("../../test/models/instances/scene.obj", camera_opts, render_opts);
+  auto mapped_image = rt::Render(filename, camera_opts, render_opts);
+  Compare(image, mapped_image);
+  std::filesystem::remove(filename);
+}
+
+[[nodiscard]] bool SamePixels(const rt::image::Image& lhs, const rt::image::Image& rhs) {
+  for (int y = 0; y < lhs.Height(); ++y) {
+    for (int x = 0; x < lhs.Width(); ++x) {
+      if (lhs.GetPixel(y, x) != rhs.GetPixel(y, x)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+TEST(SceneUpdate, Raytracer) {
+  CameraOptions camera_opts(640, 480);
+  camera_opts.look_from = std::array<double, 3>{0.5, 2.5, 5.0};
+  camera_opts.look_to = std::array<double, 3>{0.0, 0.3, 0.0};
+  RenderOptions render_opts{2};
+
+  // the same scene with the first pyramid copy raised by 0.5, written out as a file
+  auto dir = std::filesystem::temp_directory_path() / "rt_unit_scene_update";
+  std::filesystem::create_directories(dir);
+  std::filesystem::copy_file("../../test/models/instances/scene.mtl", dir / "scene.mtl",
+                             std::filesystem::copy_options::overwrite_existing);
+  {
+    std::ifstream in("../../test/models/instances/scene.obj");
+    std::ofstream out(dir / "scene.obj");
+    for (std::string line; std::getline(in, line);) {
+      out << (line == "I pyramid 1.5 0 0" ? "I pyramid 1.5 0.5 0" : line) << '\n';
+    }
+  }
+  auto moved_image = rt::Render((dir / "scene.obj").string(), camera_opts, render_opts);
+
+  rt::Scene scene = rt::ReadScene("../../test/models/instances/scene.obj");
+  std::optional<std::size_t> copy;
+  for (std::size_t i = 0; i < scene.GetInstances().size(); ++i) {
+    if (scene.GetInstances()[i].object_to_world[3][0] == 1.5) {
+      copy = i;
+    }
+  }
+  ASSERT_TRUE(copy.has_value());
+  rt::Matrix transform = scene.GetInstances()[*copy].object_to_world;
+  transform[3][1] = 0.5;
+  scene.SetInstanceTransform(*copy, transform);
+  Compare(rt::Render(scene, camera_opts, render_opts), moved_image);
+  EXPECT_THROW(scene.SetInstanceTransform(scene.GetInstances().size(), transform), std::out_of_range);
+  transform[2] = {0, 0, 0, 0};
+  EXPECT_THROW(scene.SetInstanceTransform(*copy, transform), std::invalid_argument);
+  Compare(rt::Render(scene, camera_opts, render_opts), moved_image);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(SceneUpdateRestore, Raytracer) {
+  CameraOptions camera_opts(320, 240);
+  RenderOptions render_opts{1};
+  rt::Scene scene = rt::ReadScene("../../test/models/shading_parts/scene.obj");
+  auto image = rt::Render(scene, camera_opts, render_opts);
+
+  rt::SphereObject sphere = scene.GetSphereObjects()[1];
+  rt::Light light = scene.GetLights()[0];
+  scene.SetSphere(1, sphere.sphere.GetCenter() + rt::geom::Vector{0, 0.2, 0}, 0.1);
+  scene.SetLight(0, rt::Light{light.position + rt::geom::Vector{0.5, 0, 0}, light.intensity});
+  EXPECT_FALSE(SamePixels(rt::Render(scene, camera_opts, render_opts), image));
+
+  scene.SetSphere(1, sphere.sphere.GetCenter(), sphere.sphere.GetRadius());
+  scene.SetLight(0, light);
+  EXPECT_TRUE(SamePixels(rt::Render(scene, camera_opts, render_opts), image));
+  EXPECT_THROW(scene.SetSphere(3, sphere.sphere.GetCenter(), 1), std::out_of_range);
+  EXPECT_THROW(scene.SetLight(1, light), std::out_of_range);
+}
+
+TEST(Sequence, Raytracer) {
+  CameraOptions first(160, 120, M_PI / 3, {0.0, 0.7, 1.75}, {0.0, 0.7, 0.0});
+  CameraOptions last(160, 120, M_PI / 2, {1.0, 0.9, 1.75}, {0.0, 0.5, 0.0});
+  auto cameras = rt::InterpolateCameraPath({{1, first}, {5, last}});
+  ASSERT_EQ(cameras.size(), 6);
+  EXPECT_EQ(cameras[0].look_from, first.look_from);
+  EXPECT_EQ(cameras[1].look_from, first.look_from);
+  EXPECT_DOUBLE_EQ(cameras[3].fov, (first.fov + last.fov) / 2);
+  EXPECT_DOUBLE_EQ(cameras[3].look_from[0], 0.5);
+  EXPECT_EQ(cameras[5].look_to, last.look_to);
+  EXPECT_THROW(rt::InterpolateCameraPath({{5, first}, {1, last}}), std::runtime_error);
+
+  rt::SequenceOptions sequence_opts;
+  sequence_opts.directory = std::filesystem::temp_directory_path() / "rt_unit_sequence";
+  std::filesystem::create_directories(sequence_opts.directory);
+  RenderOptions render_opts{4};
+  rt::Scene scene = rt::ReadScene("../../test/models/box/cube.obj");
+  auto stats = rt::RenderSequence(scene, cameras, render_opts, sequence_opts);
+  EXPECT_EQ(stats.frames, cameras.size());
+  for (std::size_t i = 0; i < cameras.size(); ++i) {
+    rt::image::Image written(rt::GetFramePath(sequence_opts, i).string());
+    EXPECT_TRUE(SamePixels(written, rt::Render(scene, cameras[i], render_opts)));
+  }
+
+  // a failed write stops the sequence
+  sequence_opts.directory /= "missing";
+  EXPECT_THROW(rt::RenderSequence(scene, cameras, render_opts, sequence_opts), std::runtime_error);
+  std::filesystem::remove_all(std::filesystem::temp_directory_path() / "rt_unit_sequence");
+}
+
+TEST(Batch, Raytracer) {
+  auto dir = std::filesystem::temp_directory_path() / "rt_unit_batch";
+  std::filesystem::create_directories(dir);
+  std::string models = std::filesystem::absolute("../../test/models").string();
+  {
+    std::ofstream manifest(dir / "jobs.txt");
+    manifest << "# interleaved scenes load once each\n"
+             << "scene=" << models << "/box/cube.obj output=box0.png width=160 height=120 fov=1.0471975511965976"
+             << " from=0,0.7,1.75 to=0,0.7,0 depth=4\n\n"
+             << "scene=" << models << "/triangle/scene.obj output=triangle.png width=160 height=120\n"
+             << "scene=" << models << "/box/cube.obj output=box1.png width=160 height=120 mode=depth\n"
+             << "scene=" << models << "/missing.obj output=missing.png\n";
+  }
+  auto jobs = rt::batch::ReadManifest((dir / "jobs.txt").string());
+  ASSERT_EQ(jobs.size(), 4);
+  EXPECT_EQ(jobs[0].output, (dir / "box0.png").string());
+
+  std::vector<std::size_t> reported;
+  rt::batch::BatchOptions batch_opts;
+  batch_opts.threads = 2;
+  auto stats = rt::batch::RenderBatch(jobs, batch_opts, [&reported](const rt::batch::JobResult& result) {
+    EXPECT_EQ(result.error.empty(), result.job != 3);
+    reported.push_back(result.job);
+  });
+  EXPECT_EQ(stats.scenes, 3);
+  EXPECT_EQ(stats.completed, 3);
+  EXPECT_EQ(stats.failed, 1);
+  EXPECT_EQ(reported.size(), 4);
+  for (std::size_t i = 0; i < 3; ++i) {
+    rt::image::Image written(jobs[i].output);
+    EXPECT_TRUE(SamePixels(written, rt::Render(jobs[i].scene, jobs[i].camera, jobs[i].render)));
+  }
+
+  {
+    std::ofstream manifest(dir / "bad.txt");
+    manifest << "scene=a.obj output=a.png\nscene=b.obj\n";
+  }
+  try {
+    (void)rt::batch::ReadManifest((dir / "bad.txt").string());
+    FAIL();
+  } catch (const std::runtime_error& error) {
+    EXPECT_NE(std::string(error.what()).find("bad.txt:2: "), std::string::npos);
+  }
+  std::filesystem::remove_all(dir);
+}
+
+TEST(Tiles, Raytracer) {
+  CameraOptions camera_opts(200, 150, M_PI / 3, {0.0, 0.7, 1.75}, {0.0, 0.7, 0.0});
+  rt::Scene scene = rt::ReadScene("../../test/models/box/cube.obj");
+  for (RenderMode mode : {RenderMode::kFull, RenderMode::kDepth, RenderMode::kNormal}) {
+    RenderOptions render_opts{4, mode};
+    auto image = rt::Render(scene, camera_opts, render_opts);
+    // uneven regions, one of them round-tripped through a file
+    std::vector<rt::Tile> tiles;
+    tiles.push_back(rt::RenderTile(scene, camera_opts, render_opts, {0, 0, 200, 37}));
+    tiles.push_back(rt::RenderTile(scene, camera_opts, render_opts, {0, 37, 61, 150}));
+    tiles.push_back(rt::RenderTile(scene, camera_opts, render_opts, {61, 37, 200, 150}));
+    std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_tile.bin").string();
+    rt::WriteTile(tiles[1], filename);
+    tiles[1] = rt::ReadTile(filename);
+    std::filesystem::remove(filename);
+    EXPECT_TRUE(SamePixels(rt::MergeTiles(tiles), image));
+
+    tiles.pop_back();
+    EXPECT_THROW((void)rt::MergeTiles(tiles), std::runtime_error);
+    tiles.push_back(tiles.back());
+    EXPECT_THROW((void)rt::MergeTiles(tiles), std::runtime_error);
+  }
+  EXPECT_THROW((void)rt::RenderTile(scene, camera_opts, {1}, {0, 0, 201, 10}), std::runtime_error);
+
+  // headers that don't fit their frame are rejected before any pixels are read
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_bad_tile.bin").string();
+  rt::Tile bad = rt::RenderTile(scene, camera_opts, {1}, {0, 0, 200, 37});
+  bad.frame_width = 100;
+  rt::WriteTile(bad, filename);
+  EXPECT_THROW((void)rt::ReadTile(filename), std::runtime_error);
+  bad.frame_width = 200;
+  bad.mode = static_cast<RenderMode>(7);
+  rt::WriteTile(bad, filename);
+  EXPECT_THROW((void)rt::ReadTile(filename), std::runtime_error);
+  bad.mode = RenderMode::kFull;
+  bad.region = {-1, 0, 199, 37};
+  rt::WriteTile(bad, filename);
+  EXPECT_THROW((void)rt::ReadTile(filename), std::runtime_error);
+  std::filesystem::remove(filename);
+
+  auto bands = rt::SplitIntoBands(200, 150, 4);
+  ASSERT_EQ(bands.size(), 4);
+  EXPECT_EQ(bands.front().y_begin, 0);
+  EXPECT_EQ(bands.back().y_end, 150);
+  for (std::size_t i = 1; i < bands.size(); ++i) {
+    EXPECT_EQ(bands[i].y_begin, bands[i - 1].y_end);
+  }
+}
+
+TEST(Tonemap, Raytracer) {
+  auto reference = [](double value) {
+    return static_cast<int>(pow(value, 1 / 2.2) * 255);
+  };
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> unit(0, 1);
+  for (int i = 0; i < 100000; ++i) {
+    double value = unit(gen);
+    value = i % 2 ? value : value * value * value * value;  // plenty of values near 0, where the curve is steep
+    ASSERT_EQ(rt::EncodeGamma(value), reference(value)) << value;
+  }
+  for (int code = 0; code < 256; ++code) {
+    double value = pow(code / 255.0, 2.2);
+    for (double probe : {std::nextafter(value, 0.0), value, std::nextafter(value, 1.0)}) {
+      ASSERT_EQ(rt::EncodeGamma(probe), reference(std::min(probe, 1.0))) << probe;
+    }
+  }
+  EXPECT_EQ(rt::EncodeGamma(0), 0);
+  EXPECT_EQ(rt::EncodeGamma(1), 255);
+  EXPECT_EQ(rt::EncodeGamma(NAN), 0);
+
+  // A tile large enough to be split between threads gives the pixels of the scalar formula.
+  rt::Tile tile;
+  tile.frame_width = 600;
+  tile.frame_height = 300;
+  tile.region = {0, 0, 600, 300};
+  tile.max_rgb = 3;
+  for (int i = 0; i < 600 * 300; ++i) {
+    bool hit = i % 7 != 0;
+    rt::geom::Vector value{3 * unit(gen), 3 * unit(gen), 3 * unit(gen)};
+    tile.values.push_back(hit ? value : rt::geom::Vector{0, 0, 0});
+    tile.hits.push_back(hit);
+  }
+  rt::image::Image image(600, 300);
+  rt::TonemapTile(tile, {tile.max_rgb, 0}, &image, 4);
+  for (int y = 0; y < 300; ++y) {
+    for (int x = 0; x < 600; ++x) {
+      std::size_t index = static_cast<std::size_t>(y) * 600 + x;
+      rt::geom::Vector intense = tile.values[index];
+      if (tile.hits[index]) {
+        auto out = intense * (rt::geom::Vector{1, 1, 1} + intense / pow(tile.max_rgb, 2)) /
+                   (rt::geom::Vector{1, 1, 1} + intense);
+        intense = {pow(out[0], 1 / 2.2), pow(out[1], 1 / 2.2), pow(out[2], 1 / 2.2)};
+      }
+      rt::image::RGB expected = {static_cast<int>(intense[0] * 255), static_cast<int>(intense[1] * 255),
+                                 static_cast<int>(intense[2] * 255)};
+      ASSERT_EQ(image.GetPixel(y, x), expected) << y << ' ' << x;
+    }
+  }
+}
+
+TEST(PathWeight, Raytracer) {
+  CameraOptions camera_opts(320, 240, M_PI / 3, {0.0, 0.7, 1.75}, {0.0, 0.7, 0.0});
+  rt::Scene box = rt::ReadScene("../../test/models/box/cube.obj");
+  // Every secondary ray weighs less than 1, so a cutoff of 1 traces only primary rays.
+  RenderOptions cut_all{4};
+  cut_all.min_path_weight = 1;
+  EXPECT_TRUE(SamePixels(rt::Render(box, camera_opts, cut_all), rt::Render(box, camera_opts, {0})));
+
+  // Dropping bounces that weigh next to nothing keeps the image.
+  camera_opts = CameraOptions(800, 600);
+  camera_opts.look_from = std::array<double, 3>{2, 1.5, -0.1};
+  camera_opts.look_to = std::array<double, 3>{1, 1.2, -2.8};
+  RenderOptions render_opts{9};
+  render_opts.min_path_weight = 1e-3;
+  CheckImage("mirrors/scene.obj", "mirrors/result.png", camera_opts, render_opts);
+
+  // Roulette depends on the rays alone: repeatable, and the same however the frame is split.
+  camera_opts = CameraOptions(200, 150, M_PI / 3, {0.0, 0.7, 1.75}, {0.0, 0.7, 0.0});
+  render_opts = {6};
+  render_opts.min_path_weight = 0.5;
+  render_opts.russian_roulette = true;
+  auto image = rt::Render(box, camera_opts, render_opts);
+  EXPECT_TRUE(SamePixels(rt::Render(box, camera_opts, render_opts), image));
+  std::vector<rt::Tile> tiles;
+  for (const auto& band : rt::SplitIntoBands(200, 150, 3)) {
+    tiles.push_back(rt::RenderTile(box, camera_opts, render_opts, band));
+  }
+  EXPECT_TRUE(SamePixels(rt::MergeTiles(tiles), image));
+}
+
+TEST(CameraRays, Raytracer) {
+  CameraOptions camera_opts(64, 48, 1.1, {0.3, 0.7, 1.75}, {0.0, 0.5, -1.0});
+  rt::CameraRays camera(camera_opts);
+  rt::Matrix camera_to_world = rt::MakeCameraToWorld(camera_opts.look_from, camera_opts.look_to);
+  double scale = tan(camera_opts.fov / 2);
+  for (int y = 0; y < 48; y += 7) {
+    for (int x = 0; x < 64; x += 5) {
+      double px = (2 * ((x + 0.5) / 64) - 1) * scale * 64 / 48;
+      double py = (1 - 2 * (y + 0.5) / 48) * scale;
+      rt::geom::Vector target = camera_to_world.multiply_vector({px, py, -1});
+      rt::geom::Ray expected(camera_opts.look_from, target - camera_to_world.multiply_vector({0, 0, 0}));
+      rt::geom::Ray ray = camera.Get(x, y);
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(ray.GetOrigin()[i], expected.GetOrigin()[i]);
+        EXPECT_NEAR(ray.GetDirection()[i], expected.GetDirection()[i], 1e-12);
+      }
+    }
+  }
+
+  // A partial block is covered once, in Z order: the first four pixels are a 2x2 square.
+  std::vector<rt::PixelRay> packet;
+  camera.Fill({48, 40, 64, 45}, &packet);
+  ASSERT_EQ(packet.size(), 16 * 5);
+  std::vector<int> seen(64 * 48, 0);
+  for (const auto& pixel : packet) {
+    ++seen[pixel.y * 64 + pixel.x];
+    EXPECT_EQ(pixel.ray.GetDirection()[0], camera.Get(pixel.x, pixel.y).GetDirection()[0]);
+  }
+  EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), 16 * 5);
+  EXPECT_EQ(packet[1].x, 49);
+  EXPECT_EQ(packet[1].y, 40);
+  EXPECT_EQ(packet[2].x, 48);
+  EXPECT_EQ(packet[2].y, 41);
+  EXPECT_EQ(packet[3].x, 49);
+  EXPECT_EQ(packet[3].y, 41);
+}
+
+TEST(ImageDiff, Raytracer) {
+  rt::image::Image expected(600, 300);
+  rt::image::Image actual(600, 300);
+  for (int y = 0; y < 300; ++y) {
+    for (int x = 0; x < 600; ++x) {
+      rt::image::RGB pixel{x % 256, y % 256, (x + y) % 256};
+      expected.SetPixel(pixel, y, x);
+      actual.SetPixel(pixel, y, x);
+    }
+  }
+  auto same = rt::image::CompareImages(actual, expected);
+  EXPECT_EQ(same.max_error, 0);
+  EXPECT_EQ(same.pixels_over, 0);
+  EXPECT_TRUE(std::isinf(same.psnr));
+
+  actual.SetPixel({3, 4, 0}, 0, 0);            // 5 away
+  actual.SetPixel({51, 1, 51}, 1, 50);         // 1 away, within tolerance
+  actual.SetPixel({255, 255, 255}, 299, 599);  // far
+  rt::image::ImageDiffOptions options;
+  options.tolerance = 2;
+  options.threads = 1;
+  auto diff = rt::image::CompareImages(actual, expected, options);
+  EXPECT_EQ(diff.pixels_over, 2);
+  EXPECT_DOUBLE_EQ(diff.over_tolerance, 2.0 / (600 * 300));
+  EXPECT_GT(diff.max_error, 5);
+  EXPECT_GT(diff.psnr, 40);
+  options.threads = 4;
+  auto threaded = rt::image::CompareImages(actual, expected, options);
+  EXPECT_EQ(threaded.pixels_over, diff.pixels_over);
+  EXPECT_EQ(threaded.max_error, diff.max_error);
+  EXPECT_EQ(threaded.psnr, diff.psnr);
+  options.tolerance = 5;
+  EXPECT_EQ(rt::image::CompareImages(actual, expected, options).pixels_over, 2);
+  options.tolerance = 5.01;
+  EXPECT_EQ(rt::image::CompareImages(actual, expected, options).pixels_over, 1);
+
+  auto heatmap = rt::image::MakeDiffHeatmap(actual, expected);
+  EXPECT_EQ(heatmap.GetPixel(299, 599), (rt::image::RGB{255, 255, 0}));
+  EXPECT_EQ(heatmap.GetPixel(0, 0).r, 255);
+  EXPECT_LT(heatmap.GetPixel(0, 0).g, 255);
+  EXPECT_EQ(heatmap.GetPixel(1, 50).r, heatmap.GetPixel(1, 50).g);
+
+  EXPECT_THROW((void)rt::image::CompareImages(actual, rt::image::Image(600, 299)), std::runtime_error);
+}
@@ -1,4 +1,14 @@
+#include <raytracer/tile.hpp>
+#include <scene/geometry_file.hpp>
 #include <scene/reader.hpp>
+#include <utils/scene.hpp>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
 
 #include <gtest/gtest.h>
 
@@ -9,25 +19,27 @@ TEST(Scene, Raytracer) {
   const double eps = 1e-6;
 
   const auto& materials_map = scene.GetMaterials();
-  EXPECT_EQ(materials_map.size(), 9);
+  EXPECT_EQ(materials_map.size(), 10);  // nine from the file and the default one
 
   // objects
   const auto& objects = scene.GetObjects();
   EXPECT_EQ(objects.size(), 10);
 
-  const rt::geom::Vector& vertex_coord_check = objects[0].polygon.GetVertex(0);
+  const rt::geom::Vector vertex_coord_check = objects[0].polygon.GetVertex(0);
   EXPECT_LT(std::fabs(vertex_coord_check[0] - 1.), eps);
   EXPECT_LT(std::fabs(vertex_coord_check[1] - 0.), eps);
   EXPECT_LT(std::fabs(vertex_coord_check[2] - (-1.04)), eps);
 
-  const rt::geom::Vector& normal_check = *objects[1].GetNormal(1);
+  const rt::geom::Vector normal_check = *objects[1].GetNormal(1);
   EXPECT_LT(std::fabs(normal_check[0] - 0.), eps);
   EXPECT_LT(std::fabs(normal_check[1] - 1.), eps);
   EXPECT_LT(std::fabs(normal_check[2] - 0.), eps);
 
   for (const auto& object : objects) {
-    EXPECT_TRUE(materials_map.find(object.material->name) != materials_map.end());
+    EXPECT_LT(object.material, materials_map.size());
   }
+  // corners shared by the faces of the box are stored once
+  EXPECT_LT(objects.VertexCount(), 3 * objects.size());
 
   // spheres
   const auto& spheres = scene.GetSphereObjects();
@@ -39,7 +51,7 @@ TEST(Scene, Raytracer) {
   EXPECT_LT(std::fabs(center[2] - (-0.4)), eps);
   EXPECT_LT(std::fabs(spheres[0].sphere.GetRadius() - 0.3), eps);
   for (const auto& sphere : spheres) {
-    EXPECT_TRUE(materials_map.find(sphere.material->name) != materials_map.end());
+    EXPECT_LT(sphere.material, materials_map.size());
   }
 
   // lights
@@ -52,23 +64,273 @@ TEST(Scene, Raytracer) {
   EXPECT_LT(std::fabs(lights[1].intensity[2] - 0.5), eps);
 
   // materials
-  const rt::Material& right_sphere = materials_map.at("rightSphere");
+  const rt::Material& right_sphere = materials_map[materials_map.Find("rightSphere").value()];
   EXPECT_LT(std::fabs(right_sphere.albedo[0] - 0.), eps);
   EXPECT_LT(std::fabs(right_sphere.albedo[1] - 0.3), eps);
   EXPECT_LT(std::fabs(right_sphere.albedo[2] - 0.7), eps);
   EXPECT_LT(std::fabs(right_sphere.specular_exponent - 1024), eps);
   EXPECT_LT(std::fabs(right_sphere.refraction_index - 1.8), eps);
 
-  const rt::Material& light = materials_map.at("light");
+  const rt::Material& light = materials_map[materials_map.Find("light").value()];
   EXPECT_LT(std::fabs(light.ambient_color[1] - 0.78), eps);
   EXPECT_LT(std::fabs(light.diffuse_color[2] - 0.78), eps);
   EXPECT_LT(std::fabs(light.specular_color[1] - 0.), eps);
   EXPECT_LT(std::fabs(light.intensity[2] - 1.), eps);
 
-  const rt::geom::Vector& wall_behind_diffuse = materials_map.at("wallBehind").diffuse_color;
+  const rt::geom::Vector& wall_behind_diffuse = materials_map[materials_map.Find("wallBehind").value()].diffuse_color;
   EXPECT_LT(std::fabs(wall_behind_diffuse[0] - 0.2), eps);
   EXPECT_LT(std::fabs(wall_behind_diffuse[1] - 0.7), eps);
   EXPECT_LT(std::fabs(wall_behind_diffuse[2] - 0.8), eps);
 }
 
+TEST(Instances, Raytracer) {
+  const auto scene = rt::ReadScene("../../test/models/instances/scene.obj");
+  const double eps = 1e-6;
+
+  // the pyramid is stored once and placed four times
+  EXPECT_EQ(scene.GetObjects().size(), 8);
+  const auto& meshes = scene.GetMeshes();
+  ASSERT_EQ(meshes.size(), 2);
+  EXPECT_EQ(meshes[0].name, "floor");
+  EXPECT_EQ(meshes[0].objects.size(), 2);
+  EXPECT_EQ(meshes[1].name, "pyramid");
+  EXPECT_EQ(meshes[1].objects.size(), 6);
+
+  const auto& instances = scene.GetInstances();
+  ASSERT_EQ(instances.size(), 5);
+  EXPECT_TRUE(instances[0].identity);
+  EXPECT_TRUE(instances[1].identity);
+  EXPECT_EQ(instances[2].mesh, 1);
+  EXPECT_FALSE(instances[2].identity);
+  EXPECT_LT(std::fabs(instances[2].object_to_world[3][0] - 1.5), eps);
+  EXPECT_LT(std::fabs(instances[4].object_to_world[1][1] - 0.5), eps);
+  EXPECT_LT(std::fabs(instances[4].world_to_object[1][1] - 2.), eps);
+  EXPECT_LT(std::fabs(instances[3].bounds.Min()[0] - (-2.)), eps);
+  EXPECT_LT(std::fabs(instances[3].bounds.Max()[1] - 1.), eps);
+
+  // an empty group keeps its instance, so indices still follow the file
+  std::string empty_group = (std::filesystem::temp_directory_path() / "rt_unit_empty_group.obj").string();
+  {
+    std::ofstream file(empty_group);
+    file << "o camera\no tri\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nI tri 2 0 0\nI camera 5 0 0\n";
+  }
+  auto with_empty = rt::ReadScene(empty_group);
+  std::filesystem::remove(empty_group);
+  ASSERT_EQ(with_empty.GetInstances().size(), 4);
+  EXPECT_EQ(with_empty.GetMeshes()[with_empty.GetInstances()[0].mesh].name, "camera");
+  EXPECT_EQ(with_empty.GetInstances()[2].object_to_world[3][0], 2);
+  rt::Matrix moved = with_empty.GetInstances()[2].object_to_world;
+  moved[3][1] = 3;
+  with_empty.SetInstanceTransform(2, moved);
+  with_empty.SetInstanceTransform(3, moved);
+  rt::geom::Ray ray({2.25, 3.25, 1}, {0, 0, -1});
+  auto hit = with_empty.FindClosestObject(ray);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->instance, 2);
+
+  // a flattened copy has no inverse to trace it with
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_singular_instance.obj").string();
+  {
+    std::ofstream file(filename);
+    file << "o tri\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nI tri 1 0 0 0 1 0 0 0 0 0 0 0\n";
+  }
+  EXPECT_THROW((void)rt::ReadScene(filename), std::runtime_error);
+  std::filesystem::remove(filename);
+}
+
+TEST(NoMaterials, Raytracer) {
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_no_materials.obj").string();
+  {
+    std::ofstream file(filename);
+    file << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\nS 0 0 -2 0.5\n";
+  }
+  const auto scene = rt::ReadScene(filename);
+  ASSERT_EQ(scene.GetObjects().size(), 1);
+  EXPECT_EQ(scene.GetObjects().GetMaterial(0), rt::MaterialTable::kDefault);
+  ASSERT_EQ(scene.GetSphereObjects().size(), 1);
+  EXPECT_EQ(scene.GetSphereObjects()[0].material, rt::MaterialTable::kDefault);
+  EXPECT_EQ(scene.GetMaterials().size(), 1);
+
+  {
+    std::ofstream file(filename);
+    file << "v 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl missing\nf 1 2 3\n";
+  }
+  EXPECT_THROW((void)rt::ReadScene(filename), std::runtime_error);
+  std::filesystem::remove(filename);
+}
+
+TEST(ParallelRead, Raytracer) {
+  for (const char* model : {"box/cube.obj", "instances/scene.obj", "classic_box/CornellBox-Original.obj",
+                            "deer/CERF_Free.obj"}) {
+    SCOPED_TRACE(model);
+    std::string filename = std::string("../../test/models/") + model;
+    const auto sequential = rt::ReadScene(filename, {1});
+    // tiny chunks put boundaries inside groups, between usemtl and its faces and between relative indices
+    // and the vertices they refer to
+    for (std::size_t threads : {2, 3, 7, 16}) {
+      ExpectSameScene(sequential, rt::ReadScene(filename, {threads, 1}));
+    }
+  }
+}
+
+TEST(ParallelReadErrors, Raytracer) {
+  // faces may only refer back, and 0 is no index, however the file is split
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_parallel_errors.obj").string();
+  for (const char* faces : {"f 1 2 4\nv 0 0 1\n", "f -1 0 -2\n", "f 1 2 3\nf 1//1 2//1 3//1\nvn 0 0 1\n"}) {
+    SCOPED_TRACE(faces);
+    {
+      std::ofstream file(filename);
+      file << "v 0 0 0\nv 1 0 0\nv 0 1 0\n" << faces << "v 1 1 0\n";
+    }
+    for (std::size_t threads : {1, 2, 4}) {
+      EXPECT_THROW((void)rt::ReadScene(filename, {threads, 1}), std::runtime_error) << threads << " threads";
+    }
+  }
+  std::filesystem::remove(filename);
+}
+
+TEST(GeometryFile, Raytracer) {
+  const auto scene = rt::ReadScene("../../test/models/deer/CERF_Free.obj");
+  std::string filename = (std::filesystem::temp_directory_path() / "rt_unit_reader_deer.rtg").string();
+  rt::WriteGeometryFile(scene, filename);
+  auto mapped = rt::MapScene(filename, 1);
+
+  const auto& objects = mapped.GetObjects();
+  EXPECT_EQ(objects.size(), scene.GetObjects().size());
+  EXPECT_EQ(objects.VertexCount(), scene.GetObjects().VertexCount());
+  EXPECT_EQ(objects.MemoryUsage(), 0);
+  ASSERT_EQ(mapped.GetMeshes().size(), scene.GetMeshes().size());
+  EXPECT_EQ(mapped.GetMeshes()[0].bvh.GetNodes().size(), scene.GetMeshes()[0].bvh.GetNodes().size());
+  EXPECT_EQ(mapped.GetInstances().size(), scene.GetInstances().size());
+  ASSERT_EQ(mapped.GetMaterials().size(), scene.GetMaterials().size());
+  rt::MaterialId last = mapped.GetMaterials().size() - 1;
+  EXPECT_EQ(mapped.GetMaterials()[last].name, scene.GetMaterials()[last].name);
+  EXPECT_EQ(mapped.GetMaterials()[last].albedo, scene.GetMaterials()[last].albedo);
+  EXPECT_EQ(mapped.GetLights().size(), scene.GetLights().size());
+
+  // triangles are stored in another order, but every ray finds the same surface
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> coord(-1000., 1000.);
+  const auto bounds = scene.GetInstanceBvh().GetBounds();
+  for (int i = 0; i < 2000; ++i) {
+    rt::geom::Vector target{std::uniform_real_distribution<double>(bounds.Min()[0], bounds.Max()[0])(gen),
+                            std::uniform_real_distribution<double>(bounds.Min()[1], bounds.Max()[1])(gen),
+                            std::uniform_real_distribution<double>(bounds.Min()[2], bounds.Max()[2])(gen)};
+    rt::geom::Vector origin{coord(gen), coord(gen), coord(gen)};
+    rt::geom::Ray ray{origin, target - origin};
+    auto expected = scene.FindClosestObject(ray);
+    auto hit = mapped.FindClosestObject(ray);
+    ASSERT_EQ(hit.has_value(), expected.has_value());
+    if (hit) {
+      EXPECT_EQ(hit->distance, expected->distance);
+    }
+    if (i % 100 == 0) {
+      mapped.TrimGeometry();
+    }
+  }
+
+  auto stats = mapped.GetPagingStats();
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->mapped_bytes, std::filesystem::file_size(filename));
+  EXPECT_EQ(stats->resident_limit, 1);
+  EXPECT_GT(stats->trims, 0);
+  EXPECT_FALSE(scene.GetPagingStats().has_value());
+  EXPECT_EQ(mapped.GetArenaStats().chunks, 0);
+  std::filesystem::remove(filename);
+}
+
+TEST(SceneArena, Raytracer) {
+  const auto scene = rt::ReadScene("../../test/models/deer/CERF_Free.obj");
+  auto stats = scene.GetArenaStats();
+  EXPECT_LE(stats.used_bytes, stats.reserved_bytes);
+  // The triangles, the object lists and the hierarchies were all built in the arena.
+  EXPECT_EQ(scene.GetObjects().MemoryUsage(), 0);
+  EXPECT_GE(stats.used_bytes, scene.GetObjects().size() * sizeof(std::array<std::uint32_t, 3>));
+  for (const auto& mesh : scene.GetMeshes()) {
+    EXPECT_TRUE(mesh.objects.Mapped());
+    EXPECT_TRUE(mesh.bvh.GetNodes().Mapped());
+  }
+
+  // With levels of detail, which fit in the room the reader leaves for them.
+  const auto lods = rt::ReadScene("../../test/models/deer/CERF_Free.obj", {.build_lods = true});
+  ASSERT_FALSE(lods.GetMeshes()[0].lods.empty());
+  EXPECT_EQ(lods.GetObjects().MemoryUsage(), 0);
+  EXPECT_TRUE(lods.GetMeshes()[0].lods[0].objects.Mapped());
+}
+
+TEST(Lods, Raytracer) {
+  const auto full = rt::ReadScene("../../test/models/deer/CERF_Free.obj");
+  const auto scene = rt::ReadScene("../../test/models/deer/CERF_Free.obj", {.build_lods = true});
+  ASSERT_EQ(scene.GetMeshes().size(), 1);
+  const auto& mesh = scene.GetMeshes()[0];
+  EXPECT_TRUE(full.GetMeshes()[0].lods.empty());
+  ASSERT_FALSE(mesh.lods.empty());
+  std::size_t previous = mesh.objects.size();
+  double previous_error = 0;
+  for (const auto& lod : mesh.lods) {
+    EXPECT_LE(lod.objects.size() * 2, previous);
+    EXPECT_GE(lod.error, previous_error);
+    EXPECT_FALSE(lod.bvh.Empty());
+    for (std::uint32_t object : lod.objects) {
+      ASSERT_LT(object, scene.GetObjects().size());
+      EXPECT_EQ(scene.GetObjects().GetMaterial(object), scene.GetObjects().GetMaterial(mesh.objects[0]));
+    }
+    previous = lod.objects.size();
+    previous_error = lod.error;
+  }
+  // Full detail up close, the coarsest level far enough away, nothing to pick without levels.
+  auto near = scene.SelectLods({0, 100, 0}, 1e-3);
+  auto far = scene.SelectLods({0, 100, 1e9}, 1e-3);
+  ASSERT_EQ(near.size(), scene.GetInstances().size());
+  EXPECT_EQ(near[0], 0);
+  EXPECT_EQ(far[0], mesh.lods.size());
+  EXPECT_TRUE(scene.SelectLods({0, 100, 1e9}, 0).empty());
+  EXPECT_TRUE(full.SelectLods({0, 100, 1e9}, 1e-3).empty());
+}
+
+TEST(SceneMemory, Raytracer) {
+  const std::string filename = "../../test/models/deer/CERF_Free.obj";
+  const auto scene = rt::ReadScene(filename);
+  const auto& objects = scene.GetObjects();
+  auto memory = scene.GetMemory();
+  EXPECT_EQ(memory.vertices, objects.VertexCount() * sizeof(rt::geom::Vector) + objects.NormalCount() * 4);
+  EXPECT_EQ(memory.triangles, objects.size() * (2 * sizeof(std::array<std::uint32_t, 3>) + sizeof(rt::MaterialId)));
+  EXPECT_GE(memory.acceleration, scene.GetMeshes()[0].bvh.GetNodes().size() * sizeof(rt::accel::BvhNode));
+  EXPECT_GT(memory.materials, 0);
+  EXPECT_EQ(memory.mapped, 0);
+  EXPECT_EQ(memory.Owned(), memory.Total());
+  auto estimate = rt::EstimateSceneMemory(objects.VertexCount(), objects.NormalCount(), objects.size(), false);
+  EXPECT_NEAR(static_cast<double>(estimate.Total()), static_cast<double>(memory.Total()), 0.1 * memory.Total());
+
+  // A mapped scene only owns what is not in the file.
+  std::string geometry = (std::filesystem::temp_directory_path() / "rt_unit_reader_memory.rtg").string();
+  rt::WriteGeometryFile(scene, geometry);
+  auto mapped = rt::ReadScene(geometry, {.memory_budget = memory.Total() / 2}).GetMemory();
+  EXPECT_EQ(mapped.triangles, memory.triangles);
+  EXPECT_GE(mapped.mapped, mapped.vertices + mapped.triangles);
+  EXPECT_LT(mapped.Owned(), memory.Total() / 2);
+  std::filesystem::remove(geometry);
+
+  // Over the budget the load stops during parsing; between the estimates with and without levels of detail the
+  // scene comes without them.
+  try {
+    (void)rt::ReadScene(filename, {.memory_budget = 1024});
+    FAIL() << "the budget is not enforced";
+  } catch (const std::runtime_error& error) {
+    EXPECT_NE(std::string(error.what()).find("over the memory budget of 1.0 KiB"), std::string::npos);
+  }
+  auto with_lods = rt::EstimateSceneMemory(objects.VertexCount(), objects.NormalCount(), objects.size(), true);
+  std::size_t budget = (estimate.Total() + with_lods.Total()) / 2;
+  ASSERT_GT(budget, memory.Total());
+  const auto compact = rt::ReadScene(filename, {.build_lods = true, .memory_budget = budget});
+  EXPECT_TRUE(compact.GetMeshes()[0].lods.empty());
+  EXPECT_LE(compact.GetMemory().Owned(), budget);
+  const auto detailed = rt::ReadScene(filename, {.build_lods = true, .memory_budget = 2 * with_lods.Total()});
+  EXPECT_FALSE(detailed.GetMeshes()[0].lods.empty());
+
+  CameraOptions camera(640, 480);
+  EXPECT_EQ(rt::GetFramebufferBytes(camera),
+            640 * 480 * (sizeof(rt::geom::Vector) + 1) + 480 * (sizeof(void*) + 640 * 4));
+}
+
 }  // namespace
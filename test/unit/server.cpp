@@ -0,0 +1,150 @@
+#include <raytracer/raytracer.hpp>
+#include <raytracer/render_job.hpp>
+#include <server/render_server.hpp>
+#include <server/scene_cache.hpp>
+#include <util/thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(RenderJobFormat, Raytracer) {
+  rt::RenderJob job;
+  job.scene = "../../test/models/box/cube.obj";
+  job.output = "/tmp/out.png";
+  job.camera = CameraOptions(320, 200, 0.9, {0.1, 0.7, 1.75}, {0.0, 0.7, -1.0 / 3});
+  job.render = {3, RenderMode::kNormal, true};
+  job.render.min_path_weight = 0.004;
+  job.render.russian_roulette = true;
+  job.render.lod_pixel_error = 1.5;
+  job.time_limit = 0.25;
+  auto parsed = rt::ParseRenderJob(rt::FormatRenderJob(job));
+  EXPECT_EQ(parsed.scene, job.scene);
+  EXPECT_EQ(parsed.output, job.output);
+  EXPECT_EQ(parsed.camera.screen_width, 320);
+  EXPECT_EQ(parsed.camera.screen_height, 200);
+  EXPECT_EQ(parsed.camera.fov, 0.9);
+  EXPECT_EQ(parsed.camera.look_from, job.camera.look_from);
+  EXPECT_EQ(parsed.camera.look_to, job.camera.look_to);
+  EXPECT_EQ(parsed.render.depth, 3);
+  EXPECT_EQ(parsed.render.mode, RenderMode::kNormal);
+  EXPECT_TRUE(parsed.render.sort_by_material);
+  EXPECT_EQ(parsed.render.min_path_weight, 0.004);
+  EXPECT_TRUE(parsed.render.russian_roulette);
+  EXPECT_EQ(parsed.render.lod_pixel_error, 1.5);
+  EXPECT_EQ(parsed.time_limit, 0.25);
+
+  EXPECT_THROW(rt::ParseRenderJob("scene=a.obj"), std::runtime_error);
+  EXPECT_THROW(rt::ParseRenderJob("scene=a.obj output=b.png width=x"), std::runtime_error);
+  EXPECT_THROW(rt::ParseRenderJob("scene=a.obj output=b.png from=1,2"), std::runtime_error);
+  EXPECT_THROW(rt::ParseRenderJob("scene=a.obj output=b.png colour=red"), std::runtime_error);
+}
+
+TEST(ThreadPool, Raytracer) {
+  std::atomic<int> done = 0;
+  {
+    rt::util::ThreadPool pool(3);
+    EXPECT_EQ(pool.Size(), 3);
+    for (int i = 0; i < 100; ++i) {
+      pool.Submit([&done] {
+        ++done;
+      });
+    }
+    pool.Wait();
+    EXPECT_EQ(done, 100);
+    EXPECT_EQ(pool.QueueDepth(), 0);
+    EXPECT_EQ(pool.Running(), 0);
+    pool.Submit([&done] {
+      ++done;
+    });
+  }
+  EXPECT_EQ(done, 101);
+}
+
+TEST(SceneCache, Raytracer) {
+  rt::server::SceneCache cache(1);
+  auto box = cache.Get("../../test/models/box/cube.obj");
+  EXPECT_EQ(cache.Get("../../test/models/box/cube.obj"), box);
+  auto triangle = cache.Get("../../test/models/triangle/scene.obj");
+  EXPECT_NE(cache.Get("../../test/models/box/cube.obj"), box);
+  // the evicted scene lives on while it is held
+  EXPECT_EQ(box->GetObjects().size(), 10);
+  EXPECT_THROW(cache.Get("../../test/models/missing.obj"), std::runtime_error);
+  EXPECT_THROW(cache.Get("../../test/models/missing.obj"), std::runtime_error);
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 5);
+  EXPECT_EQ(stats.evictions, 3);
+  EXPECT_EQ(stats.size, 0);
+}
+
+TEST(RenderServer, Raytracer) {
+  auto dir = std::filesystem::temp_directory_path() / "rt_unit_server";
+  std::filesystem::create_directories(dir);
+  std::string socket_path = (dir / "socket").string();
+  rt::server::ServerOptions options;
+  options.socket_path = socket_path;
+  options.threads = 2;
+  rt::server::RenderServer server(options);
+  std::thread serving([&server] {
+    server.Serve();
+  });
+
+  rt::RenderJob job;
+  job.scene = "../../test/models/box/cube.obj";
+  job.camera = CameraOptions(160, 120, M_PI / 3, {0.0, 0.7, 1.75}, {0.0, 0.7, 0.0});
+  job.render = {4};
+  auto expected = rt::Render(job.scene, job.camera, job.render);
+  for (int i = 0; i < 2; ++i) {
+    job.output = (dir / ("frame" + std::to_string(i) + ".png")).string();
+    EXPECT_TRUE(rt::server::SendRequest(socket_path, "render " + rt::FormatRenderJob(job)).starts_with("ok "));
+    rt::image::Image written(job.output);
+    for (int y = 0; y < expected.Height(); ++y) {
+      for (int x = 0; x < expected.Width(); ++x) {
+        ASSERT_EQ(written.GetPixel(y, x), expected.GetPixel(y, x));
+      }
+    }
+  }
+  // A job with a time limit it easily keeps says which quality it reached.
+  job.time_limit = 60;
+  EXPECT_TRUE(rt::server::SendRequest(socket_path, "render " + rt::FormatRenderJob(job)).ends_with(" full"));
+  job.time_limit = 0;
+  job.scene = "../../test/models/missing.obj";
+  EXPECT_TRUE(rt::server::SendRequest(socket_path, "render " + rt::FormatRenderJob(job)).starts_with("error "));
+  EXPECT_EQ(rt::server::SendRequest(socket_path, "hello"), "error unknown request");
+
+  // A client that connects and says nothing holds up one thread, not the accept.
+  int silent = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  ASSERT_EQ(connect(silent, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+  auto asked = std::chrono::steady_clock::now();
+  EXPECT_EQ(rt::server::SendRequest(socket_path, "hello"), "error unknown request");
+  // well before the server gives up on the silent one
+  EXPECT_LT(std::chrono::steady_clock::now() - asked, std::chrono::seconds(2));
+  close(silent);
+
+  std::string stats = rt::server::SendRequest(socket_path, "stats");
+  // a job counts as running until its task returns, which may be just after its reply
+  EXPECT_NE(stats.find("completed=3 failed=1 queued=0 running="), std::string::npos);
+  EXPECT_NE(stats.find("cache_hits=2 cache_misses=2"), std::string::npos);
+
+  EXPECT_EQ(rt::server::SendRequest(socket_path, "stop"), "ok");
+  serving.join();
+  std::filesystem::remove_all(dir);
+}
+
+}  // namespace
@@ -0,0 +1,49 @@
+#include <util/arena.hpp>
+#include <util/mapped_vector.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(Arena, Raytracer) {
+  rt::util::Arena arena(64);
+  auto bytes = arena.AllocateArray<std::uint8_t>(3);
+  auto doubles = arena.AllocateArray<double>(4);
+  EXPECT_EQ(bytes.size(), 3);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(doubles.data()) % alignof(double), 0);
+  EXPECT_EQ(arena.GetStats().chunks, 1);
+  EXPECT_EQ(arena.GetStats().allocations, 2);
+
+  // Doesn't fit in what is left: a new chunk at least as large as the ones before.
+  (void)arena.AllocateArray<double>(8);
+  EXPECT_EQ(arena.GetStats().chunks, 2);
+  EXPECT_EQ(arena.GetStats().reserved_bytes, 128);
+
+  rt::util::Arena reserved(0);
+  reserved.Reserve(1000);
+  for (int i = 0; i < 10; ++i) {
+    (void)reserved.AllocateArray<double>(10);
+    (void)reserved.AllocateArray<char>(1);
+  }
+  auto stats = reserved.GetStats();
+  EXPECT_EQ(stats.chunks, 1);
+  EXPECT_EQ(stats.reserved_bytes, 1000);
+  EXPECT_LE(stats.used_bytes, stats.reserved_bytes);
+
+  // A vector grows in its arena storage, then moves out of it.
+  auto shared = std::make_shared<rt::util::Arena>(64);
+  auto vector = rt::util::AllocateVector<int>(shared, 2);
+  vector.push_back(1);
+  vector.push_back(2);
+  EXPECT_TRUE(vector.Mapped());
+  EXPECT_EQ(vector.capacity(), 0);
+  vector.push_back(3);
+  EXPECT_FALSE(vector.Mapped());
+  EXPECT_EQ(vector, rt::util::MappedVector<int>(std::vector<int>{1, 2, 3}));
+}
+
+}  // namespace
@@ -1,6 +1,7 @@
 #include <raytracer/image.hpp>
+#include <raytracer/image_diff.hpp>
 
-#include <cmath>
+#include <filesystem>
 #include <string>
 
 #include <gtest/gtest.h>
@@ -10,25 +11,26 @@
   return result;
 }
 
-[[nodiscard]] double PixelDistance(const rt::image::RGB& lhs, const rt::image::RGB& rhs) {
-  return sqrt(std::pow(lhs.r - rhs.r, 2.0) + std::pow(lhs.g - rhs.g, 2.0) + std::pow(lhs.b - rhs.b, 2.0));
-}
-
 void Compare(const rt::image::Image& actual, const rt::image::Image& expected) {
   static const double kEps = 2;
-  int matches = 0;
+  static int heatmaps = 0;
 
   EXPECT_EQ(actual.Width(), expected.Width());
   EXPECT_EQ(actual.Height(), expected.Height());
-  for (int y = 0; y < actual.Height(); ++y) {
-    for (int x = 0; x < actual.Width(); ++x) {
-      auto actual_data = actual.GetPixel(y, x);
-      auto expected_data = expected.GetPixel(y, x);
-      auto diff = PixelDistance(actual_data, expected_data);
-      matches += diff < kEps;
-    }
+  if (actual.Width() != expected.Width() || actual.Height() != expected.Height()) {
+    return;
   }
-
-  double similarity = static_cast<double>(matches) / (actual.Width() * actual.Height());
-  EXPECT_GE(similarity, 0.99);
+  auto diff = rt::image::CompareImages(actual, expected, {kEps, 0});
+  double similarity = 1 - diff.over_tolerance;
+  std::string details;
+  if (similarity < 0.99) {
+    // Leave a picture of where the images differ next to the failure.
+    const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+    auto filename = std::filesystem::temp_directory_path() /
+                    ("rt_diff_" + std::string(test->test_suite_name()) + "_" + std::to_string(heatmaps++) + ".png");
+    rt::image::MakeDiffHeatmap(actual, expected, kEps).Write(filename.string());
+    details = std::to_string(diff.pixels_over) + " pixels differ, max error " + std::to_string(diff.max_error) +
+              ", PSNR " + std::to_string(diff.psnr) + " dB; heatmap in " + filename.string();
+  }
+  EXPECT_GE(similarity, 0.99) << details;
 }
@@ -0,0 +1,59 @@
+#include <utils/scene.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+void ExpectSameVector(const rt::geom::Vector& lhs, const rt::geom::Vector& rhs) {
+  for (std::size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(lhs[i], rhs[i]);
+  }
+}
+
+void ExpectSameScene(const rt::Scene& lhs, const rt::Scene& rhs) {
+  const auto& objects = lhs.GetObjects();
+  ASSERT_EQ(objects.size(), rhs.GetObjects().size());
+  ASSERT_EQ(objects.VertexCount(), rhs.GetObjects().VertexCount());
+  ASSERT_EQ(objects.NormalCount(), rhs.GetObjects().NormalCount());
+  for (std::uint32_t i = 0; i < objects.VertexCount(); ++i) {
+    ExpectSameVector(objects.GetVertex(i), rhs.GetObjects().GetVertex(i));
+  }
+  for (std::uint32_t i = 0; i < objects.NormalCount(); ++i) {
+    ExpectSameVector(objects.GetNormal(i), rhs.GetObjects().GetNormal(i));
+  }
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    EXPECT_EQ(objects.GetVertexIndices(i), rhs.GetObjects().GetVertexIndices(i));
+    EXPECT_EQ(objects.GetNormalIndices(i), rhs.GetObjects().GetNormalIndices(i));
+    EXPECT_EQ(objects.GetMaterial(i), rhs.GetObjects().GetMaterial(i));
+  }
+
+  ASSERT_EQ(lhs.GetSphereObjects().size(), rhs.GetSphereObjects().size());
+  for (std::size_t i = 0; i < lhs.GetSphereObjects().size(); ++i) {
+    EXPECT_EQ(lhs.GetSphereObjects()[i].material, rhs.GetSphereObjects()[i].material);
+    ExpectSameVector(lhs.GetSphereObjects()[i].sphere.GetCenter(), rhs.GetSphereObjects()[i].sphere.GetCenter());
+    EXPECT_EQ(lhs.GetSphereObjects()[i].sphere.GetRadius(), rhs.GetSphereObjects()[i].sphere.GetRadius());
+  }
+  ASSERT_EQ(lhs.GetLights().size(), rhs.GetLights().size());
+  for (std::size_t i = 0; i < lhs.GetLights().size(); ++i) {
+    ExpectSameVector(lhs.GetLights()[i].position, rhs.GetLights()[i].position);
+    ExpectSameVector(lhs.GetLights()[i].intensity, rhs.GetLights()[i].intensity);
+  }
+  ASSERT_EQ(lhs.GetMaterials().size(), rhs.GetMaterials().size());
+  for (rt::MaterialId i = 0; i < lhs.GetMaterials().size(); ++i) {
+    EXPECT_EQ(lhs.GetMaterials()[i].name, rhs.GetMaterials()[i].name);
+  }
+
+  ASSERT_EQ(lhs.GetMeshes().size(), rhs.GetMeshes().size());
+  for (std::size_t i = 0; i < lhs.GetMeshes().size(); ++i) {
+    EXPECT_EQ(lhs.GetMeshes()[i].name, rhs.GetMeshes()[i].name);
+    EXPECT_EQ(lhs.GetMeshes()[i].objects, rhs.GetMeshes()[i].objects);
+  }
+  ASSERT_EQ(lhs.GetInstances().size(), rhs.GetInstances().size());
+  for (std::size_t i = 0; i < lhs.GetInstances().size(); ++i) {
+    EXPECT_EQ(lhs.GetInstances()[i].mesh, rhs.GetInstances()[i].mesh);
+    for (std::size_t row = 0; row < 4; ++row) {
+      EXPECT_EQ(lhs.GetInstances()[i].object_to_world[row], rhs.GetInstances()[i].object_to_world[row]);
+    }
+  }
+}
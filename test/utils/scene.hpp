@@ -0,0 +1,7 @@
+#pragma once
+#include <geometry/vector.hpp>
+#include <scene/scene.hpp>
+
+void ExpectSameVector(const rt::geom::Vector& lhs, const rt::geom::Vector& rhs);
+// Same geometry, materials, meshes and instances, element by element.
+void ExpectSameScene(const rt::Scene& lhs, const rt::Scene& rhs);